@@ -0,0 +1,171 @@
+//===- BlockCompressor.cpp -------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BlockCompressor.h"
+
+#include <cstring>
+
+namespace ohmu {
+
+
+static inline uint32_t read32(const uint8_t *P) {
+  uint32_t V;
+  memcpy(&V, P, sizeof(V));
+  return V;
+}
+
+
+// Write a length of 15 or more as a sequence of bytes.
+static inline uint8_t* writeLength(uint8_t *Op, size_t Len) {
+  while (Len >= 255) {
+    *Op++ = 255;
+    Len -= 255;
+  }
+  *Op++ = static_cast<uint8_t>(Len);
+  return Op;
+}
+
+
+// Emit a pair of literals and a match.  If MatchLen is 0, there is no match.
+static inline uint8_t* writeSequence(uint8_t *Op, const uint8_t *Lit,
+                                     size_t LitLen, size_t Offset,
+                                     size_t MatchLen) {
+  uint8_t *Token = Op++;
+  *Token = (LitLen >= 15 ? 15 : LitLen) << 4;
+  if (LitLen >= 15)
+    Op = writeLength(Op, LitLen - 15);
+  memcpy(Op, Lit, LitLen);
+  Op += LitLen;
+
+  if (MatchLen == 0)
+    return Op;
+
+  *Op++ = Offset & 0xFF;
+  *Op++ = Offset >> 8;
+  size_t Ml = MatchLen - 4;
+  *Token |= (Ml >= 15 ? 15 : Ml);
+  if (Ml >= 15)
+    Op = writeLength(Op, Ml - 15);
+  return Op;
+}
+
+
+size_t BlockCompressor::compress(const uint8_t *Src, size_t Size,
+                                 uint8_t *Dst) {
+  uint32_t Table[1 << HashBits];
+  memset(Table, 0, sizeof(Table));
+
+  const uint8_t *Ip     = Src;
+  const uint8_t *Anchor = Src;
+  const uint8_t *End    = Src + Size;
+  uint8_t *Op = Dst;
+
+  while (Size >= MinMatch && Ip <= End - MinMatch) {
+    uint32_t Seq = read32(Ip);
+    uint32_t H   = (Seq * 2654435761u) >> (32 - HashBits);
+    const uint8_t *Ref = Src + Table[H];
+    Table[H] = static_cast<uint32_t>(Ip - Src);
+
+    if (Ref >= Ip || Ip - Ref > MaxOffset || read32(Ref) != Seq) {
+      ++Ip;
+      continue;
+    }
+
+    const uint8_t *M = Ip + MinMatch;
+    const uint8_t *R = Ref + MinMatch;
+    while (M < End && *M == *R) {
+      ++M;
+      ++R;
+    }
+    Op = writeSequence(Op, Anchor, Ip - Anchor, Ip - Ref, M - Ip);
+    Ip = M;
+    Anchor = M;
+  }
+
+  if (Anchor < End || Op == Dst)
+    Op = writeSequence(Op, Anchor, End - Anchor, 0, 0);
+  return Op - Dst;
+}
+
+
+int64_t BlockCompressor::decompress(const uint8_t *Src, size_t Size,
+                                    uint8_t *Dst, size_t DstSize) {
+  const uint8_t *Ip  = Src;
+  const uint8_t *End = Src + Size;
+  uint8_t *Op    = Dst;
+  uint8_t *OpEnd = Dst + DstSize;
+
+  while (Ip < End) {
+    unsigned Token = *Ip++;
+
+    size_t LitLen = Token >> 4;
+    if (LitLen == 15) {
+      unsigned B;
+      do {
+        if (Ip >= End)
+          return -1;
+        B = *Ip++;
+        LitLen += B;
+      } while (B == 255);
+    }
+    if (LitLen > static_cast<size_t>(End - Ip) ||
+        LitLen > static_cast<size_t>(OpEnd - Op))
+      return -1;
+    memcpy(Op, Ip, LitLen);
+    Ip += LitLen;
+    Op += LitLen;
+
+    if (Ip == End)
+      break;   // The last sequence has no match.
+
+    if (End - Ip < 2)
+      return -1;
+    size_t Offset = Ip[0] | (Ip[1] << 8);
+    Ip += 2;
+    if (Offset == 0 || Offset > static_cast<size_t>(Op - Dst))
+      return -1;
+
+    size_t MatchLen = Token & 15;
+    if (MatchLen == 15) {
+      unsigned B;
+      do {
+        if (Ip >= End)
+          return -1;
+        B = *Ip++;
+        MatchLen += B;
+      } while (B == 255);
+    }
+    MatchLen += MinMatch;
+    if (MatchLen > static_cast<size_t>(OpEnd - Op))
+      return -1;
+
+    const uint8_t *R = Op - Offset;
+    if (Offset >= MatchLen) {
+      memcpy(Op, R, MatchLen);
+      Op += MatchLen;
+    }
+    else {
+      // Overlapping copy, which repeats the last Offset bytes.
+      for (size_t i = 0; i < MatchLen; ++i)
+        *Op++ = R[i];
+    }
+  }
+  return Op - Dst;
+}
+
+
+}  // end namespace ohmu
@@ -0,0 +1,65 @@
+//===- BlockCompressor.h ---------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// A fast LZ77 compressor for independent blocks of data, in the style of LZ4.
+//
+// A compressed block is a sequence of (literals, match) pairs.  Each pair
+// begins with a token byte, which holds the number of literals in the high
+// 4 bits, and the match length minus 4 in the low 4 bits.  A value of 15
+// means that more length bytes follow, each of which is added to the length,
+// until a byte which is not 255.  The token is followed by the literals,
+// a 2-byte little-endian match offset, and the rest of the match length.
+// The last pair in a block has literals only.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_BASE_BLOCKCOMPRESSOR_H
+#define OHMU_BASE_BLOCKCOMPRESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ohmu {
+
+
+class BlockCompressor {
+public:
+  /// Return the maximum size of Size bytes after compression.
+  static size_t maxCompressedSize(size_t Size) {
+    return Size + Size / 255 + 16;
+  }
+
+  /// Compress Size bytes from Src into Dst, and return the compressed size.
+  /// Dst must hold at least maxCompressedSize(Size) bytes.
+  static size_t compress(const uint8_t *Src, size_t Size, uint8_t *Dst);
+
+  /// Decompress Size bytes from Src into Dst, which holds DstSize bytes.
+  /// Return the decompressed size, or -1 if Src is malformed or Dst is too
+  /// small.
+  static int64_t decompress(const uint8_t *Src, size_t Size,
+                            uint8_t *Dst, size_t DstSize);
+
+private:
+  static const unsigned MinMatch  = 4;
+  static const unsigned MaxOffset = 0xFFFF;
+  static const unsigned HashBits  = 13;
+};
+
+
+}  // end namespace ohmu
+
+#endif  // OHMU_BASE_BLOCKCOMPRESSOR_H
@@ -21,7 +21,7 @@ namespace ohmu {
 
 MemRegion::MemRegion()
     : currentBlock_(0), currentBlockEnd_(0), currentPosition_(0),
-      largeBlocks_(0) {
+      largeBlocks_(0), cleanups_(0) {
   grabNewBlock();
 }
 
@@ -39,6 +39,8 @@ inline void freeList(char* p) {
 
 
 MemRegion::~MemRegion() {
+  for (Cleanup* C = cleanups_; C; C = C->Next)
+    C->Fn(C->Data);
   // std::cerr << "\nfree[" << std::hex << reinterpret_cast<size_t>(this) << "]";
   freeList(currentBlock_);
   // std::cerr << "\nfree[]";
@@ -46,6 +48,21 @@ MemRegion::~MemRegion() {
 }
 
 
+void MemRegion::reset() {
+  for (Cleanup* C = cleanups_; C; C = C->Next)
+    C->Fn(C->Data);
+  cleanups_ = nullptr;
+  freeList(largeBlocks_);
+  largeBlocks_ = nullptr;
+
+  // Keep the most recent block.
+  char** prev = reinterpret_cast<char**>(currentBlock_);
+  freeList(*prev);
+  *prev = nullptr;
+  currentPosition_ = currentBlock_ + headerSize;
+}
+
+
 void MemRegion::grabNewBlock() {
   // std::cerr << "\nallocBlock[" << std::hex << reinterpret_cast<size_t>(this) << "]";
 
@@ -73,6 +73,22 @@ public:
   // No-op.
   void deallocate(void* ptr) { }
 
+  // Free all data that was allocated in the region, running its cleanups,
+  // but keep one block for further allocations.
+  void reset();
+
+  // Register a function to be called with Data when the region is destroyed.
+  // Cleanups are run in reverse order of registration, before any memory in
+  // the region is freed.  Used to tie external resources, such as mapped
+  // files, to the lifetime of the region.
+  void addCleanup(void (*Fn)(void*), void* Data) {
+    Cleanup* C = allocateT<Cleanup>();
+    C->Fn   = Fn;
+    C->Data = Data;
+    C->Next = cleanups_;
+    cleanups_ = C;
+  }
+
   inline void* allocateSmall(size_t size) {
     if (currentPosition_ + size >= currentBlockEnd_)
       grabNewBlock();
@@ -92,6 +108,12 @@ public:
   void grabNewBlock();
 
 private:
+  struct Cleanup {
+    Cleanup* Next;
+    void   (*Fn)(void*);
+    void*    Data;
+  };
+
   static const unsigned defaultBlockSize  = 4096;  // 4kb blocks
   static const unsigned maxBumpAllocSize  = 512;   // 8 allocs per block
   static const unsigned headerSize        = sizeof(void*);
@@ -106,6 +128,8 @@ private:
   char* currentPosition_;
 
   char* largeBlocks_;       // linked list of large blocks
+
+  Cleanup* cleanups_;       // functions to call on destruction
 };
 
 
@@ -129,6 +153,10 @@ public:
     return allocator_->allocateT<T>(nelems);
   }
 
+  void addCleanup(void (*Fn)(void*), void* Data) {
+    allocator_->addCleanup(Fn, Data);
+  }
+
 private:
   MemRegion* allocator_;
 };
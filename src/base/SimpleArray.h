@@ -12,6 +12,9 @@
 
 #include "MemRegion.h"
 
+#include <cassert>
+#include <cstring>
+
 
 namespace ohmu {
 
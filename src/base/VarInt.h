@@ -0,0 +1,149 @@
+//===- VarInt.h ------------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Encoding and decoding of variable-length integers.  An integer is stored
+// in little-endian groups of 7 bits, one group per byte, and the high bit of
+// each byte is set if more bytes follow.
+//
+// Integers of up to three bytes are decoded with a branch per byte.  Longer
+// integers are decoded from a single 8-byte load when at least 8 bytes are
+// available: the end of the integer is found from the high bits, and the
+// 7-bit groups are gathered with shifts and masks, without a branch per
+// byte.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_BASE_VARINT_H
+#define OHMU_BASE_VARINT_H
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define OHMU_VARINT_NOINLINE __declspec(noinline)
+#define OHMU_VARINT_UNLIKELY(X) (X)
+#else
+#define OHMU_VARINT_NOINLINE __attribute__((noinline))
+#define OHMU_VARINT_UNLIKELY(X) __builtin_expect(!!(X), 0)
+#endif
+
+namespace ohmu {
+
+
+class VarInt {
+public:
+  /// Maximum size of an encoded 64-bit integer.
+  static const unsigned MaxSize = 10;
+
+  /// Encode V into P, and return the number of bytes written.
+  /// P must hold at least MaxSize bytes.
+  static unsigned encode(uint64_t V, uint8_t *P) {
+    unsigned N = 0;
+    while (V >= 0x80) {
+      // Write lower 7 bits.  The 8th bit is high if there's more to write.
+      P[N++] = static_cast<uint8_t>(V | 0x80);
+      V >>= 7;
+    }
+    P[N++] = static_cast<uint8_t>(V);
+    return N;
+  }
+
+  /// Decode an integer from P into V, reading no further than End.
+  /// Returns a pointer to the byte after the integer.
+  static const uint8_t* decode(const uint8_t *P, const uint8_t *End,
+                               uint64_t *V) {
+    if (OHMU_VARINT_UNLIKELY(End - P < 8))
+      return decodeSlow(P, End, V);
+
+    // Most integers are at most three bytes long, and predictable branches
+    // on the first few bytes are faster than computing the length.
+    uint64_t Byt = P[0];
+    uint64_t R = Byt & 0x7f;
+    if (Byt < 0x80) {
+      *V = R;
+      return P + 1;
+    }
+    Byt = P[1];
+    R |= (Byt & 0x7f) << 7;
+    if (Byt < 0x80) {
+      *V = R;
+      return P + 2;
+    }
+    Byt = P[2];
+    R |= (Byt & 0x7f) << 14;
+    if (Byt < 0x80) {
+      *V = R;
+      return P + 3;
+    }
+
+    uint64_t W = load64(P);
+    uint64_t Stop = ~W & 0x8080808080808080ull;
+    if (!Stop)
+      return decodeSlow(P, End, V);
+    // Number of bits in the encoded integer; a multiple of 8.
+    unsigned Bits = countTrailingZeros(Stop) + 1;
+    uint64_t X = W & 0x7f7f7f7f7f7f7f7full & (~0ull >> (64 - Bits));
+    X = ((X & 0x7f007f007f007f00ull) >> 1) | (X & 0x007f007f007f007full);
+    X = ((X & 0x3fff00003fff0000ull) >> 2) | (X & 0x00003fff00003fffull);
+    X = ((X & 0x0fffffff00000000ull) >> 4) | (X & 0x000000000fffffffull);
+    *V = X;
+    return P + (Bits >> 3);
+  }
+
+  /// Decode one byte at a time.  Used for integers which are longer than
+  /// 8 bytes, or which are close to End.  This is kept out of line, so that
+  /// it does not slow down the common cases of decode.
+  OHMU_VARINT_NOINLINE
+  static const uint8_t* decodeSlow(const uint8_t *P, const uint8_t *End,
+                                   uint64_t *V) {
+    uint64_t R = 0;
+    for (unsigned B = 0; B < 64 && P < End; B += 7) {
+      uint64_t Byt = *P++;
+      R |= (Byt & 0x7Fu) << B;
+      if ((Byt & 0x80) == 0)
+        break;
+    }
+    *V = R;
+    return P;
+  }
+
+private:
+  static uint64_t load64(const uint8_t *P) {
+    uint64_t W;
+    memcpy(&W, P, sizeof(W));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    W = __builtin_bswap64(W);
+#endif
+    return W;
+  }
+
+  static unsigned countTrailingZeros(uint64_t X) {
+#ifdef _MSC_VER
+    unsigned long I;
+    _BitScanForward64(&I, X);
+    return I;
+#else
+    return __builtin_ctzll(X);
+#endif
+  }
+};
+
+
+}  // end namespace ohmu
+
+#endif  // OHMU_BASE_VARINT_H
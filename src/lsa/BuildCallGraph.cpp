@@ -9,6 +9,7 @@
 
 #include "clang/Analysis/CFG.h"
 #include "clang/Analysis/Til/Bytecode.h"
+#include "clang/Analysis/Til/BytecodeContainer.h"
 #include "clang/Analysis/Til/ClangCFGWalker.h"
 #include "clang/Analysis/Til/ClangTranslator.h"
 #include "clang/AST/DeclCXX.h"
@@ -131,12 +132,7 @@ void ExtendCallGraph::GenerateOhmuIR(const std::string &FName,
   SxBuilder.setSSAMode(true);
   Walker.walk(SxBuilder);
 
-  ohmu::til::BytecodeStringWriter WriteStream;
-  ohmu::til::BytecodeWriter Writer(&WriteStream);
-
-  Writer.traverseAll(SxBuilder.topLevelSlot());
-  WriteStream.flush();
-  Builder.SetOhmuIR(FName, WriteStream.str());
+  Builder.AddOhmuIR(FName, SxBuilder.topLevelSlot());
 }
 
 } // end namespace
@@ -150,11 +146,32 @@ void DefaultCallGraphBuilder::AddCall(const std::string &From,
   FromNode->AddCall(To);
 }
 
+void CallGraphBuilder::AddOhmuIR(const std::string &Func,
+                                 ohmu::til::SExpr *IR) {
+  ohmu::til::BytecodeStringWriter WriteStream;
+  ohmu::til::BytecodeWriter Writer(&WriteStream);
+  Writer.setStringTable(true);
+  Writer.setSharedSubtrees(true);
+
+  Writer.write(IR);
+  SetOhmuIR(Func, WriteStream.str());
+}
+
 void DefaultCallGraphBuilder::SetOhmuIR(const std::string &Func,
                                         const std::string &IR) {
   GetNodeByName(Func)->SetIR(IR);
 }
 
+void DefaultCallGraphBuilder::AddOhmuIR(const std::string &Func,
+                                        ohmu::til::SExpr *IR) {
+  if (!IRContainer) {
+    CallGraphBuilder::AddOhmuIR(Func, IR);
+    return;
+  }
+  GetNodeByName(Func);
+  IRContainer->addDefinition(ohmu::StringRef(Func.data(), Func.size()), IR);
+}
+
 DefaultCallGraphBuilder::CallGraphNode *
 DefaultCallGraphBuilder::GetNodeByName(const std::string &Func) {
   auto It = Graph.find(Func);
@@ -175,6 +192,8 @@ void DefaultCallGraphBuilder::Print(std::ostream &Out) {
 void DefaultCallGraphBuilder::CallGraphNode::Print(std::ostream &Out) {
   for (std::string Called : OutgoingCalls)
     Out << "--> " << Called << "\n";
+  if (OhmuIR.empty())
+    return;   // The IR was written to a container.
 
   ohmu::MemRegion Region;
   ohmu::MemRegionRef Arena(&Region);
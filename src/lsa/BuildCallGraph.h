@@ -21,6 +21,12 @@
 #include <unordered_set>
 
 namespace ohmu {
+
+namespace til {
+class BytecodeContainerWriter;
+class SExpr;
+} // namespace til
+
 namespace lsa {
 
 /// Interface for actually constructing the call graph from the discovered calls
@@ -37,14 +43,27 @@ public:
   /// Request to store the generated ohmu IR representation of the function
   /// identified by Func.
   virtual void SetOhmuIR(const std::string &Func, const std::string &IR) = 0;
+
+  /// Request to store the ohmu IR of the function identified by Func, which
+  /// has just been translated.  IR is freed when this returns.  By default,
+  /// IR is serialized and passed to SetOhmuIR.
+  virtual void AddOhmuIR(const std::string &Func, til::SExpr *IR);
 };
 
 /// The standard implementation of GraphConstructor stores the call graph as a
 /// mapping from function identifier to CGNode.
 class DefaultCallGraphBuilder : public CallGraphBuilder {
 public:
+  DefaultCallGraphBuilder() : IRContainer(nullptr) {}
+
   void AddCall(const std::string &From, const std::string &To) override;
   void SetOhmuIR(const std::string &Func, const std::string &IR) override;
+  void AddOhmuIR(const std::string &Func, til::SExpr *IR) override;
+
+  /// Write the IR of each function to W as soon as it is translated, as a
+  /// definition named by the function, rather than keeping it in the graph.
+  /// The nodes of the graph then have no IR.  The caller must finish W.
+  void SetIRContainer(til::BytecodeContainerWriter *W) { IRContainer = W; }
 
   void Print(std::ostream &Out);
 
@@ -76,6 +95,8 @@ private:
 
   std::unordered_map<std::string, std::unique_ptr<CallGraphNode>>
       Graph; // Mapping function names to their nodes.
+
+  til::BytecodeContainerWriter *IRContainer;
 };
 
 /// Tool to be used for creating call graphs with Ohmu IR for each function.
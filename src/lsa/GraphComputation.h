@@ -15,6 +15,7 @@
 #define OHMU_LSA_GRAPHCOMPUTATION_H
 
 #include "StandaloneGraphComputation.h"
+#include "base/VarInt.h"
 
 /// To provide serialization in Google's Pregel framework.
 template <class T> class StringCoderCustom;
@@ -22,29 +23,17 @@ template <class T> class StringCoderCustom;
 namespace ohmu {
 namespace lsa {
 
-// Adapted from til/Bytecode.cpp:
+// Variable-length integers, in the same encoding as til/Bytecode.h.
 static void writeUInt64ToString(uint64_t V, string *result) {
-  if (V == 0) {
-    result->push_back('\0');
-    return;
-  }
-  while (V > 0) {
-    uint64_t V2 = V >> 7;
-    uint8_t Hibit = (V2 == 0) ? 0 : 0x80;
-    // Write lower 7 bits.  The 8th bit is high if there's more to write.
-    result->push_back(static_cast<char>((V & 0x7Fu) | Hibit));
-    V = V2;
-  }
+  uint8_t Buf[VarInt::MaxSize];
+  unsigned N = VarInt::encode(V, Buf);
+  result->append(reinterpret_cast<const char*>(Buf), N);
 }
 
 static uint64_t readUInt64FromString(const string &str, int &index) {
-  uint64_t V = 0;
-  for (unsigned B = 0; B < 64; B += 7) {
-    uint64_t Byt = str[index++];
-    V = V | ((Byt & 0x7Fu) << B);
-    if ((Byt & 0x80) == 0)
-      break;
-  }
+  const uint8_t *Data = reinterpret_cast<const uint8_t*>(str.data());
+  uint64_t V;
+  index = VarInt::decode(Data + index, Data + str.size(), &V) - Data;
   return V;
 }
 
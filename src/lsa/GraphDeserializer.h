@@ -3,6 +3,9 @@
 
 #include "lsa/StandaloneGraphComputation.h"
 #include "til/Bytecode.h"
+#include "til/BytecodeContainer.h"
+
+#include <memory>
 
 namespace ohmu {
 namespace lsa {
@@ -10,16 +13,32 @@ namespace lsa {
 template <class UserComputation>
 class GraphDeserializer {
 public:
+  /// Read the graph in FileName.  If the IR of the functions was written to
+  /// a container, then IRFileName is the name of the container.
   static void read(const std::string& FileName,
-                   StandaloneGraphBuilder<UserComputation> *Builder) {
+                   StandaloneGraphBuilder<UserComputation> *Builder,
+                   const std::string& IRFileName = "") {
     ohmu::MemRegion Arena;
     ohmu::til::BytecodeFileReader ReadStream(FileName,
         ohmu::MemRegionRef(&Arena));
 
+    std::unique_ptr<ohmu::til::BytecodeContainerReader> IRReader;
+    if (!IRFileName.empty()) {
+      IRReader.reset(new ohmu::til::BytecodeContainerReader(IRFileName,
+          ohmu::MemRegionRef(&Arena)));
+    }
+
     int32_t NFunc = ReadStream.readInt32();
     for (unsigned i = 0; i < NFunc; i++) {
       std::string Function = ReadStream.readString();
       std::string OhmuIR = ReadStream.readString();
+      int Def = IRReader ? IRReader->findDefinition(ohmu::StringRef(Function))
+                        : -1;
+      if (OhmuIR.empty() && Def >= 0) {
+        int64_t Size;
+        const uint8_t *D = IRReader->definitionData(Def, &Size);
+        OhmuIR.assign(reinterpret_cast<const char*>(D), Size);
+      }
       typename GraphTraits<UserComputation>::VertexValueType Value;
       Builder->addVertex(Function, OhmuIR, Value);
 
@@ -22,6 +22,13 @@ namespace parsing {
 
 
 bool BNFParser::initParserFromFile(Parser &parser, FILE* file, bool trace) {
+  FileStream fs(file);
+  return initParserFromStream(parser, fs, trace);
+}
+
+
+bool BNFParser::initParserFromStream(Parser &parser, CharStream &stream,
+                                     bool trace) {
   ohmu::parsing::DefaultLexer lexer;
   ohmu::parsing::BNFParser bnfParser(&lexer);
 
@@ -32,8 +39,7 @@ bool BNFParser::initParserFromFile(Parser &parser, FILE* file, bool trace) {
     return false;
   }
 
-  FileStream fs(file);
-  lexer.setStream(&fs);
+  lexer.setStream(&stream);
   auto *startRule = bnfParser.findDefinition("definitionList");
 
   bnfParser.setTarget(&parser);
@@ -96,7 +102,7 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       return nullptr;
     return prs[i].getToken();
   };
-  auto tokList = [=](unsigned i) -> std::vector< Token* >* {
+  auto tokList = [=](unsigned i) -> SimpleArray<Token*>* {
     if (!prs[i].isTokenList() || i >= arity)
       return nullptr;
     return prs[i].getTokenList();
@@ -111,7 +117,7 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       return nullptr;
     return prs[i].getNode<ast::ASTNode>(BPR_ASTNode);
   };
-  auto astList = [=](unsigned i) -> std::vector< ast::ASTNode* >* {
+  auto astList = [=](unsigned i) -> SimpleArray<ast::ASTNode*>* {
     if (!prs[i].isList(BPR_ASTNode) || i >= arity)
       return nullptr;
     return prs[i].getList<ast::ASTNode>(BPR_ASTNode);
@@ -124,13 +130,11 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
     case BNF_Token: {
       Token *t = tok(0);
       unsigned tid = lookupTokenID(t->cppString());
-      delete t;
       return ParseResult(BPR_ParseRule, new ParseToken(tid));
     }
     case BNF_Keyword: {
       Token *t = tok(0);
       auto r = new ParseKeyword(t->cppString());
-      delete t;
       return ParseResult(BPR_ParseRule, r);
     }
     case BNF_Sequence: {
@@ -142,7 +146,6 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       if (arity == 3) {
         Token *t = tok(0);
         auto r = new ParseSequence(t->cppString(), pr(1), pr(2));
-        delete t;
         return ParseResult(BPR_ParseRule, r);
       }
       return ParseResult();
@@ -156,22 +159,17 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 3);
       Token *t = tok(0);
       auto r = new ParseRecurseLeft(t->cppString(), pr(1), pr(2));
-      delete t;
       return ParseResult(BPR_ParseRule, r);
     }
     case BNF_Reference: {
       assert(arity == 2);
       Token *t = tok(0);
       auto r = new ParseReference(t->cppString());
-      delete t;
       // get argument list
       auto *v = tokList(1);
       if (v) {
-        for (Token *at : *v) {
+        for (Token *at : *v)
           r->addArgument(at->cppString());
-          delete at;
-        }
-        delete v;
       }
       return ParseResult(BPR_ParseRule, r);
     }
@@ -183,15 +181,11 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 3);
       Token *t = tok(0);
       auto r = new ParseNamedDefinition(t->cppString(), pr(2));
-      delete t;
       // get argument list
       auto *v = tokList(1);
       if (v) {
-        for (Token *at : *v) {
+        for (Token *at : *v)
           r->addArgument(at->cppString());
-          delete at;
-        }
-        delete v;
       }
 
       // Add definition to target parser now.  No need to return it.
@@ -210,14 +204,12 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 1);
       Token *t = tok(0);
       auto e = new ast::Variable(t->cppString());
-      delete t;
       return ParseResult(BPR_ASTNode, e);
     }
     case BNF_TokenStr: {
       assert(arity == 1);
       Token *t = tok(0);
       auto e = new ast::TokenStr(t->cppString());
-      delete t;
       return ParseResult(BPR_ASTNode, e);
     }
     case BNF_Construct: {
@@ -251,8 +243,6 @@ ParseResult BNFParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
             break;
         }
       }
-      delete t;
-      delete v;
       return ParseResult(BPR_ASTNode, c);
     }
     case BNF_EmptyList: {
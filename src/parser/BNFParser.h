@@ -68,6 +68,10 @@ public:
   // If trace is true, will print out debugging information.
   static bool initParserFromFile(Parser &parser, FILE* file, bool trace=false);
 
+  // Read grammar definition from stream, and use it to initialize parser.
+  static bool initParserFromStream(Parser &parser, CharStream &stream,
+                                   bool trace=false);
+
 public:
   BNFParser(Lexer *lexer) : Parser(lexer) {
     initMap();
@@ -0,0 +1,230 @@
+//===- CharScan.h ----------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// CharScan finds the length of a run of characters of the same class, such
+// as the characters of an identifier, or the body of a comment.  Runs are
+// scanned 32 bytes at a time with AVX2, or 16 bytes at a time with SSE2,
+// when the compiler targets them.  The last few bytes, and all bytes on
+// other targets, are scanned one at a time.  The scanners never read past
+// the end of the given characters.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_CHARSCAN_H
+#define OHMU_CHARSCAN_H
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OHMU_CHARSCAN_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OHMU_CHARSCAN_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace ohmu {
+
+namespace parsing {
+
+
+class CharScan {
+public:
+  // Each class defines test(c), which is true if c is in the class, and
+  // stops<V>(v), which returns a bit mask of the bytes in v that are not.
+
+  // Spaces and tabs.
+  struct Whitespace {
+    static bool test(char c) { return c == ' ' || c == '\t'; }
+
+    template <class V>
+    static uint32_t stops(typename V::Reg v) {
+      return ~V::mask(V::orr(V::eq(v, ' '), V::eq(v, '\t')));
+    }
+  };
+
+  // Decimal digits.
+  struct Digit {
+    static bool test(char c) { return c >= '0' && c <= '9'; }
+
+    template <class V>
+    static uint32_t stops(typename V::Reg v) {
+      return ~V::mask(V::range(v, '0', '9'));
+    }
+  };
+
+  // Letters, digits, and '_'.
+  struct Identifier {
+    static bool test(char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+             (c >= '0' && c <= '9') || c == '_';
+    }
+
+    template <class V>
+    static uint32_t stops(typename V::Reg v) {
+      // Setting bit 5 maps upper case letters to lower case.
+      auto letter = V::range(V::orr(v, V::set(0x20)), 'a', 'z');
+      auto id = V::orr(V::orr(letter, V::range(v, '0', '9')), V::eq(v, '_'));
+      return ~V::mask(id);
+    }
+  };
+
+  // The body of a line comment: anything except newlines and 0.
+  struct Comment {
+    static bool test(char c) { return c != '\n' && c != '\r' && c != 0; }
+
+    template <class V>
+    static uint32_t stops(typename V::Reg v) {
+      return V::mask(V::orr(V::orr(V::eq(v, '\n'), V::eq(v, '\r')),
+                            V::eq(v, 0)));
+    }
+  };
+
+  // The body of a string or character literal, which is delimited by
+  // Quote: anything except the quote, escapes, newlines, tabs, and 0.
+  template <char Quote>
+  struct Literal {
+    static bool test(char c) {
+      return c != Quote && c != '\\' && c != '\n' && c != '\r' &&
+             c != '\t' && c != 0;
+    }
+
+    template <class V>
+    static uint32_t stops(typename V::Reg v) {
+      auto s1 = V::orr(V::eq(v, Quote), V::eq(v, '\\'));
+      auto s2 = V::orr(V::eq(v, '\n'), V::eq(v, '\r'));
+      auto s3 = V::orr(V::eq(v, '\t'), V::eq(v, 0));
+      return V::mask(V::orr(V::orr(s1, s2), s3));
+    }
+  };
+
+  typedef Literal<'"'>  String;
+  typedef Literal<'\''> Character;
+
+  // Return the number of characters at the start of p[0..n) in class C.
+  template <class C>
+  static unsigned scan(const char* p, unsigned n) {
+    // Many runs are empty, such as the whitespace after the last of a
+    // sequence of tokens, and are found most quickly one character at
+    // a time.
+    if (n == 0 || !C::test(p[0]))
+      return 0;
+    unsigned i = 0;
+#if defined(OHMU_CHARSCAN_AVX2)
+    i = scanVector<AVX2, C>(p, n);
+    if (i + AVX2::Width <= n)
+      return i;
+#endif
+#if defined(OHMU_CHARSCAN_SSE2)
+    i += scanVector<SSE2, C>(p + i, n - i);
+    if (i + SSE2::Width <= n)
+      return i;
+#endif
+    return i + scanScalar<C>(p + i, n - i);
+  }
+
+  // As scan, but one character at a time.
+  template <class C>
+  static unsigned scanScalar(const char* p, unsigned n) {
+    unsigned i = 0;
+    while (i < n && C::test(p[i]))
+      ++i;
+    return i;
+  }
+
+private:
+  // Scan whole vectors of type V.  Returns the length of the run if it
+  // ends within a vector, and otherwise the number of bytes scanned, which
+  // leaves less than a vector.
+  template <class V, class C>
+  static unsigned scanVector(const char* p, unsigned n) {
+    unsigned i = 0;
+    for (; i + V::Width <= n; i += V::Width) {
+      uint32_t m = C::template stops<V>(V::load(p + i)) & V::Full;
+      if (m)
+        return i + countTrailingZeros(m);
+    }
+    return i;
+  }
+
+#if defined(OHMU_CHARSCAN_SSE2)
+  struct SSE2 {
+    typedef __m128i Reg;
+    static const unsigned Width = 16;
+    static const uint32_t Full  = 0xFFFF;
+
+    static Reg load(const char* p) {
+      return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+    static Reg set(char c)          { return _mm_set1_epi8(c); }
+    static Reg eq(Reg v, char c)    { return _mm_cmpeq_epi8(v, set(c)); }
+    static Reg orr(Reg a, Reg b)    { return _mm_or_si128(a, b); }
+    static uint32_t mask(Reg v)     { return _mm_movemask_epi8(v); }
+
+    // Bytes in [lo, hi].  Bytes below lo wrap around to large values.
+    static Reg range(Reg v, char lo, char hi) {
+      Reg d = _mm_sub_epi8(v, set(lo));
+      return _mm_cmpeq_epi8(_mm_min_epu8(d, set(hi - lo)), d);
+    }
+  };
+#endif
+
+#if defined(OHMU_CHARSCAN_AVX2)
+  struct AVX2 {
+    typedef __m256i Reg;
+    static const unsigned Width = 32;
+    static const uint32_t Full  = 0xFFFFFFFF;
+
+    static Reg load(const char* p) {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    static Reg set(char c)          { return _mm256_set1_epi8(c); }
+    static Reg eq(Reg v, char c)    { return _mm256_cmpeq_epi8(v, set(c)); }
+    static Reg orr(Reg a, Reg b)    { return _mm256_or_si256(a, b); }
+    static uint32_t mask(Reg v)     { return _mm256_movemask_epi8(v); }
+
+    static Reg range(Reg v, char lo, char hi) {
+      Reg d = _mm256_sub_epi8(v, set(lo));
+      return _mm256_cmpeq_epi8(_mm256_min_epu8(d, set(hi - lo)), d);
+    }
+  };
+#endif
+
+  static unsigned countTrailingZeros(uint32_t x) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return i;
+#else
+    return __builtin_ctz(x);
+#endif
+  }
+};
+
+
+}  // end namespace parsing
+
+}  // end namespace ohmu
+
+#endif  // OHMU_CHARSCAN_H
@@ -141,22 +141,14 @@ void DefaultLexer::readIdentifier(char startChar) {
   char c = startChar;
   putChar(c);
   skipChar();
-  c = lookChar();
-  while (isLetter(c) | isDigit(c)) {
-    putChar(c);
-    skipChar();
-    c = lookChar();
-  };
+  readRun<CharScan::Identifier>(true);
 }
 
 
 void DefaultLexer::readInteger(char startChar) {
-  char c = startChar;
-  do {
-    putChar(c);
-    skipChar();
-    c = lookChar();
-  } while (isDigit(c));
+  putChar(startChar);
+  skipChar();
+  readRun<CharScan::Digit>(true);
 }
 
 
@@ -184,11 +176,8 @@ void DefaultLexer::readLineComment() {
   skipChar();  // skip '/'
   skipChar();  // skip '/'
 
+  readRun<CharScan::Comment>(false);
   char c = lookChar();
-  while (c && !isNewline(c)) {
-    skipChar();
-    c = lookChar();
-  }
   if (isNewline(c)) readNewline(c);
 }
 
@@ -204,6 +193,7 @@ bool DefaultLexer::readEscapeCharacter(char c) {
     return false;
   }
   if (c == '\\') {
+    copyToken();   // The token no longer matches the source.
     skipChar();
     c = lookChar();
     switch (c) {
@@ -232,16 +222,18 @@ bool DefaultLexer::readEscapeCharacter(char c) {
 }
 
 
+// Reads the contents of a string, up to the trailing '"'.
 bool DefaultLexer::readString() {
   skipChar();  // skip leading '"'
-  char c = lookChar();
-  while (c != '\"') {
+  startToken();
+  while (true) {
+    readRun<CharScan::String>(true);
+    char c = lookChar();
+    if (c == '\"')
+      return true;
     if (!readEscapeCharacter(c))
       return false;
-    c = lookChar();
   }
-  skipChar();  // skip trailing '"'
-  return true;
 }
 
 
@@ -266,16 +258,18 @@ bool DefaultLexer::readFloatExp(char startChar) {
 
 
 
+// Reads the contents of a character, up to the trailing '''.
 bool DefaultLexer::readCharacter() {
   skipChar();  // skip leading '''
-  char c = lookChar();
-  while (c != '\'') {
+  startToken();
+  while (true) {
+    readRun<CharScan::Character>(true);
+    char c = lookChar();
+    if (c == '\'')
+      return true;
     if (!readEscapeCharacter(c))
       return false;
-    c = lookChar();
   }
-  skipChar();  // skip trailing '''
-  return true;
 }
 
 
@@ -284,8 +278,8 @@ Token DefaultLexer::readToken() {
 
   while (true) {
     // skip whitespace
-    while (isWhiteSpace(c)) {
-      skipChar();
+    if (isWhiteSpace(c)) {
+      readRun<CharScan::Whitespace>(false);
       c = lookChar();
     }
 
@@ -308,6 +302,7 @@ Token DefaultLexer::readToken() {
   }
 
   SourceLocation sloc = getCurrentLocation();
+  startToken();
 
   // punctuation
   if (c == '(') {
@@ -360,10 +355,10 @@ Token DefaultLexer::readToken() {
   // identifiers
   if (isLetter(c)) {
     readIdentifier(c);
-    StringRef str = copyStr(finishToken());
+    StringRef str = tokenStr();
 
     unsigned short keyid =
-      static_cast<unsigned short>( lookupKeyword(str.c_str()) );
+      static_cast<unsigned short>( lookupKeyword(str) );
     if (keyid) {
       return Token(keyid, str, sloc);
     }
@@ -373,10 +368,10 @@ Token DefaultLexer::readToken() {
   // generic operators
   if (isOperatorChar(c)) {
     readOperator(c);
-    StringRef str = copyStr(finishToken());
+    StringRef str = tokenStr();
 
     unsigned short keyid =
-      static_cast<unsigned short>( lookupKeyword(str.c_str()) );
+      static_cast<unsigned short>( lookupKeyword(str) );
     if (keyid) {
       return Token(keyid, str, sloc);
     }
@@ -391,7 +386,7 @@ Token DefaultLexer::readToken() {
       putChar('x');
       skipChar();
       readHexInteger();
-      StringRef str = copyStr(finishToken());
+      StringRef str = tokenStr();
       return Token(TK_LitInteger, str, sloc);
     }
 
@@ -404,17 +399,17 @@ Token DefaultLexer::readToken() {
         if (!readFloatExp(c2))
           signalLexicalError();
       }
-      StringRef str = copyStr(finishToken());
+      StringRef str = tokenStr();
       return Token(TK_LitFloat, str, sloc);
     }
     else if (c2 == 'e' || c2 == 'E') {
       if (!readFloatExp(c2))
         signalLexicalError();
-      StringRef str = copyStr(finishToken());
+      StringRef str = tokenStr();
       return Token(TK_LitFloat, str, sloc);
     }
     else {
-      StringRef str = copyStr(finishToken());
+      StringRef str = tokenStr();
       return Token(TK_LitInteger, str, sloc);
     }
   }
@@ -424,7 +419,8 @@ Token DefaultLexer::readToken() {
     if (!readCharacter())
       return Token(TK_Error);
 
-    StringRef str = copyStr(finishToken());
+    StringRef str = tokenStr();
+    skipChar();  // skip trailing '''
     return Token(TK_LitCharacter, str, sloc);
   }
 
@@ -433,7 +429,8 @@ Token DefaultLexer::readToken() {
     if (!readString())
       return Token(TK_Error);
 
-    StringRef str = copyStr(finishToken());
+    StringRef str = tokenStr();
+    skipChar();  // skip trailing '"'
     return Token(TK_LitString, str, sloc);
   }
 
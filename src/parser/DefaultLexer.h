@@ -95,6 +95,14 @@ public:
     return copyStringRef(mem, s);
   }
 
+  // Finish the current token.  Returns a slice of the source if the lexer
+  // reads it in place, and a copy otherwise.
+  StringRef tokenStr() {
+    if (isTokenInPlace())
+      return finishToken();
+    return copyStr(finishToken());
+  }
+
   virtual const char* getTokenIDString(unsigned tid);
   virtual unsigned    registerKeyword(const std::string& s);
 
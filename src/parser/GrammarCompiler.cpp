@@ -0,0 +1,75 @@
+//===- GrammarCompiler.cpp -------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reads a grammar for TILParser, and writes a parser for it in C++, as a
+// subclass of TILParser.  See ParserGenerator.
+//
+// Usage: grammar_compiler grammar_file class_name output_base
+//
+// Writes output_base.h and output_base.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#include "parser/BNFParser.h"
+#include "parser/DefaultLexer.h"
+#include "parser/ParserGenerator.h"
+#include "parser/TILParser.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+
+using namespace ohmu;
+using namespace ohmu::parsing;
+
+
+int main(int argc, const char** argv) {
+  if (argc != 4) {
+    std::cerr << "Usage: grammar_compiler grammar_file class_name "
+              << "output_base\n";
+    return 1;
+  }
+
+  FILE* grammarFile = fopen(argv[1], "r");
+  if (!grammarFile) {
+    std::cerr << "File " << argv[1] << " not found.\n";
+    return 1;
+  }
+  DefaultLexer lexer;
+  TILParser parser(&lexer);
+  bool success = BNFParser::initParserFromFile(parser, grammarFile, false);
+  fclose(grammarFile);
+  if (!success)
+    return 1;
+
+  std::string base = argv[3];
+  std::string headerName = base.substr(base.find_last_of("/\\") + 1) + ".h";
+  ParserGenerator generator(parser, argv[2], "TILParser",
+                            "parser/TILParser.h");
+
+  std::ofstream header(base + ".h");
+  generator.generateHeader(header);
+  std::ofstream source(base + ".cpp");
+  generator.generateSource(source, headerName);
+  if (!header || !source) {
+    std::cerr << "Could not write " << base << ".\n";
+    return 1;
+  }
+  return 0;
+}
@@ -16,11 +16,16 @@
 //===----------------------------------------------------------------------===//
 
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 
 #ifndef _MSC_VER
+#include <fcntl.h>
 #include <readline/readline.h>
 #include <readline/history.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "parser/Lexer.h"
@@ -47,6 +52,75 @@ unsigned StringStream::fillBuffer(char* buf, unsigned size)  {
 }
 
 
+#ifndef _MSC_VER
+namespace {
+
+struct FileMapping {
+  void*  addr;
+  size_t size;
+
+  static void release(void* p) {
+    auto* m = static_cast<FileMapping*>(p);
+    munmap(m->addr, m->size);
+  }
+};
+
+}  // end anonymous namespace
+#endif
+
+
+MappedFileStream::MappedFileStream(const char* fileName, MemRegionRef arena) {
+#ifndef _MSC_VER
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size <= 0xFFFFFFFE) {
+    open_ = true;
+    if (st.st_size > 0) {
+      void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        auto* m = arena.allocateT<FileMapping>();
+        m->addr = p;
+        m->size = st.st_size;
+        arena.addCleanup(&FileMapping::release, m);
+        data_ = static_cast<const char*>(p);
+        size_ = static_cast<unsigned>(st.st_size);
+      } else {
+        open_ = false;
+      }
+    }
+  }
+  close(fd);
+#else
+  // No mmap; read the whole file into the arena instead.
+  std::ifstream fs(fileName, std::ios::binary | std::ios::ate);
+  if (!fs)
+    return;
+  open_ = true;
+  size_t sz = static_cast<size_t>(fs.tellg());
+  if (sz > 0) {
+    char* buf = arena.allocateT<char>(sz);
+    fs.seekg(0);
+    fs.read(buf, sz);
+    data_ = buf;
+    size_ = static_cast<unsigned>(sz);
+  }
+#endif
+}
+
+
+unsigned MappedFileStream::fillBuffer(char* buf, unsigned size) {
+  unsigned n = size_ - pos_;
+  if (n > size)
+    n = size;
+  memcpy(buf, data_ + pos_, n);
+  pos_ += n;
+  return n;
+}
+
+
 #ifndef _MSC_VER
 bool InteractiveStream::readlineLibraryInitialized_ = false;
 
@@ -101,14 +175,30 @@ unsigned Lexer::lookupTokenID(const std::string& s) {
 
 
 unsigned Lexer::registerKeyword(const std::string& s) {
-  KeywordDict::iterator it = keyDict_.find(s);
-  if (it == keyDict_.end()) {
-    unsigned sz = keyList_.size();
-    keyList_.push_back(s);  // map from unsigned to string
-    keyDict_[s] = sz;       // map from string to unsigned
-    return sz + startKeywordTokenID_;
-  }
-  return it->second + startKeywordTokenID_;
+  unsigned tid = lookupKeyword(StringRef(s));
+  if (tid)
+    return tid;
+  unsigned sz = keyList_.size();
+  keyList_.push_back(s);  // map from unsigned to string
+  insertKeyword(sz);      // map from string to unsigned
+  return sz + startKeywordTokenID_;
+}
+
+
+void Lexer::insertKeyword(unsigned i) {
+  unsigned first = i;
+  if (4 * keyList_.size() > keyTable_.size()) {
+    // Grow the table, and reinsert every keyword.
+    keyTable_.assign(keyTable_.empty() ? 64 : 2 * keyTable_.size(), 0);
+    first = 0;
+  }
+  unsigned mask = keyTable_.size() - 1;
+  for (unsigned j = first; j <= i; ++j) {
+    unsigned h = hashKeyword(StringRef(keyList_[j])) & mask;
+    while (keyTable_[h] != 0)
+      h = (h + 1) & mask;
+    keyTable_[h] = j + 1;
+  }
 }
 
 
@@ -142,18 +232,25 @@ void Lexer::readTokens(unsigned numTokens) {
   for (; i < numTokens; ++i) {
     if (stream_eof_ || lexical_error)
       break;
-    lookAhead_.push_back(readToken());
+    pushLookAhead(readToken());
   }
 
   // push extra EOF tokens onto the end if necessary to enable
   // unlimited lookahead.
   for (; i < numTokens; ++i) {
-    lookAhead_.push_back(eofToken_);
+    pushLookAhead(eofToken_);
   }
 }
 
 
 void Lexer::fillBuffer(unsigned numChars) {
+  // The whole source is already in memory.  Characters past the end are
+  // read as 0 by lookChar.
+  if (source_) {
+    stream_eof_ = true;
+    return;
+  }
+
   unsigned bsize = bufferSize();
 
   if (bufferPos_ > 0) {
@@ -20,6 +20,7 @@
 // class CharStream:
 // class FileStream:         reads characters from a file.
 // class StringStream:       reads characters from a string.
+// class MappedFileStream:   maps a file into memory.
 // class InteractiveStream:  reads characters line by line from stdin.
 //
 // class Lexer: base class for custom lexers.
@@ -30,12 +31,14 @@
 #ifndef OHMU_LEXER_H
 #define OHMU_LEXER_H
 
+#include "base/MemRegion.h"
+#include "parser/CharScan.h"
 #include "parser/Token.h"
 
 #include <stdio.h>
 
+#include <cassert>
 #include <cstring>
-#include <deque>
 #include <map>
 #include <string>
 #include <vector>
@@ -75,6 +78,30 @@ private:
   const char* str_;
 };
 
+// Maps a file into memory.  The mapping is released when the arena is
+// destroyed, so slices of data() may be kept for the lifetime of the arena.
+// The file may be read as a stream, but it is faster to lex it in place.
+// See Lexer::setSource.
+class MappedFileStream : public CharStream {
+public:
+  MappedFileStream(const char* fileName, MemRegionRef arena);
+
+  virtual unsigned fillBuffer(char* buf, unsigned size);
+
+  // Return true if the file was opened successfully.
+  bool isOpen() const { return open_; }
+
+  const char* data() const { return data_; }
+  unsigned    size() const { return size_; }
+
+private:
+  const char* data_ = "";
+  unsigned    size_ = 0;
+  unsigned    pos_  = 0;
+  bool        open_ = false;
+};
+
+
 #ifndef _MSC_VER
 // Reads a stream of characters from standard input, using the readline library.
 class InteractiveStream : public CharStream {
@@ -101,12 +128,14 @@ class Lexer {
 public:
   Lexer()
     : lineNum_(1), linePos_(1),
-      buffer_(0), bufferLen_(0), bufferPos_(0),
+      buffer_(0), chars_(0), bufferLen_(0), bufferPos_(0),
       stream_eof_(true), lexical_error(false),
-      tokenBuffer_(0), tokenPos_(0),
+      tokenBuffer_(0), tokenPos_(0), tokenStart_(0),
+      source_(nullptr), copyToken_(true),
       charStream_(0), startKeywordTokenID_(TK_BasicTokenEnd),
       eofToken_(TK_EOF), emptyString_("") {
     buffer_      = new char[bufferCapacity_];
+    chars_       = buffer_;
     tokenBuffer_ = new char[tokenCapacity_];
   }
 
@@ -130,38 +159,64 @@ public:
 
   // Switch to a new character stream
   void setStream(CharStream *stream) {
+    reset();
     charStream_   = stream;
-    lineNum_      = 1;
-    linePos_      = 1;
-    bufferLen_    = 0;
-    bufferPos_    = 0;
-    stream_eof_   = false;
-    lexical_error = false;
-    tokenPos_     = 0;
+    source_       = nullptr;
+    chars_        = buffer_;
+  }
+
+  // Lex size characters of data in place, rather than reading them into a
+  // buffer.  Tokens which appear verbatim in data are slices of data,
+  // rather than copies, so data must outlive them.
+  void setSource(const char* data, unsigned size) {
+    reset();
+    charStream_   = nullptr;
+    source_       = data;
+    chars_        = data;
+    bufferLen_    = size;
+  }
+
+  // Return true if s is a slice of the source.
+  bool isInSource(StringRef s) const {
+    return source_ && s.data() >= source_ &&
+           s.data() + s.size() <= source_ + bufferLen_;
   }
 
-  // Get the i'th lookahead token.
+  // Return the offset in the source of the next character to be lexed,
+  // when lexing in place.  Tokens in the lookahead buffer have already
+  // been lexed, so this is the end of the last of them, if any.
+  unsigned sourceOffset() const { return bufferPos_; }
+
+  // Return the number of tokens in the lookahead buffer.
+  unsigned numLookAhead() const { return lookSize_; }
+
+  // Maximum number of lookahead tokens.
+  static const unsigned LookAheadCapacity = 8;
+
+  // Get the i'th lookahead token.  i must be less than LookAheadCapacity.
   const Token& look(unsigned i = 0) {
-    unsigned lsize = lookAhead_.size();
-    if (i >= lsize)
-      readTokens(i - lsize + 1);
-    return lookAhead_[i];
+    assert(i < LookAheadCapacity && "Lookahead too far.");
+    if (i >= lookSize_)
+      readTokens(i - lookSize_ + 1);
+    return lookAhead_[(lookStart_ + i) % LookAheadCapacity];
   }
 
   // Pull the next token off the token stream.
   void consume() {
-    lookAhead_.pop_front();
+    assert(lookSize_ > 0 && "No token to consume.");
+    lookStart_ = (lookStart_ + 1) % LookAheadCapacity;
+    --lookSize_;
   }
 
   // clear all unhandled input.
   void clearUnhandledInput() {
-    lookAhead_.clear();
+    lookSize_ = 0;
     bufferPos_ = bufferLen_;
   }
 
   // Return true if no more tokens are available.
   bool eof() const {
-    return (stream_eof_ || lexical_error) && (lookAhead_.size() == 0);
+    return (stream_eof_ || lexical_error) && (lookSize_ == 0);
   }
 
   // Must be called by derived classes to set the index of the last
@@ -178,11 +233,20 @@ public:
     return startKeywordTokenID_ + keyList_.size() - 1;
   }
 
-  // Returns the token id of the given keyword
-  unsigned lookupKeyword(const std::string& s) {
-    KeywordDict::iterator it = keyDict_.find(s);
-    if (it == keyDict_.end()) return 0;
-    else return it->second + startKeywordTokenID_;
+  // Returns the token id of the given keyword, or 0 if s is not a keyword.
+  unsigned lookupKeyword(StringRef s) {
+    if (keyTable_.empty())
+      return 0;
+    unsigned mask = keyTable_.size() - 1;
+    for (unsigned h = hashKeyword(s) & mask; ; h = (h + 1) & mask) {
+      unsigned k = keyTable_[h];
+      if (k == 0)
+        return 0;
+      const std::string& ks = keyList_[k - 1];
+      if (ks.length() == s.size() &&
+          memcmp(ks.data(), s.data(), s.size()) == 0)
+        return k - 1 + startKeywordTokenID_;
+    }
   }
 
   // Returns the keyword string for the given keyword token id.
@@ -217,9 +281,34 @@ protected:
     ++linePos_;
   }
 
+  // Marks the current character as the start of a token.  When lexing in
+  // place, the token is the slice of the source from here to the current
+  // character when it is finished, unless copyToken is called.
+  void startToken() {
+    tokenStart_ = bufferPos_;
+    copyToken_  = !source_;
+  }
+
+  // Copies the current token into the token buffer, because its characters
+  // differ from those in the source.  Later characters must be put with
+  // putChar.  Does nothing unless lexing in place.
+  void copyToken() {
+    if (copyToken_)
+      return;
+    copyToken_ = true;
+    for (unsigned i = tokenStart_; i < bufferPos_; ++i)
+      putChar(source_[i]);
+  }
+
+  // Return true if the current token will be a slice of the source.
+  bool isTokenInPlace() const { return !copyToken_; }
+
   // Puts the char into the current token buffer.
   // Returns true on success, or false if the token buffer is full.
+  // When lexing in place, the character is already in the source.
   bool putChar(char c) {
+    if (!copyToken_)
+      return true;
     if (tokenPos_ < tokenCapacity_-1) {
       tokenBuffer_[tokenPos_] = c;
       ++tokenPos_;
@@ -228,9 +317,47 @@ protected:
     return false;
   }
 
+  // Puts n chars into the current token buffer, as by putChar.
+  bool putChars(const char* s, unsigned n) {
+    if (!copyToken_)
+      return true;
+    bool fits = tokenPos_ + n < tokenCapacity_;
+    if (!fits)
+      n = tokenCapacity_ - 1 - tokenPos_;
+    memcpy(tokenBuffer_ + tokenPos_, s, n);
+    tokenPos_ += n;
+    return fits;
+  }
+
+  // Skips the run of characters in class C, which starts at the current
+  // character, and puts them into the token buffer if put is true.  C is
+  // one of the classes of CharScan, and must not contain newlines.
+  template <class C>
+  void readRun(bool put) {
+    while (true) {
+      lookChar();   // refill the buffer if it is empty
+      unsigned n = bufferSize();
+      if (n == 0)
+        return;
+      const char* p = chars_ + bufferPos_;
+      unsigned k = CharScan::scan<C>(p, n);
+      if (put)
+        putChars(p, k);
+      bufferPos_ += k;
+      linePos_   += k;
+      if (k < n)
+        return;
+    }
+  }
+
   // Complete token, and return a reference to the string data.
-  // This string must be copied before reading any further data.
+  // Unless the token is in place, this string must be copied before reading
+  // any further data.
   StringRef finishToken() {
+    if (!copyToken_) {
+      copyToken_ = true;
+      return StringRef(source_ + tokenStart_, bufferPos_ - tokenStart_);
+    }
     unsigned len = tokenPos_;
     tokenBuffer_[tokenPos_] = 0;   // null terminate
     tokenPos_ = 0;
@@ -276,21 +403,54 @@ protected:
   unsigned bufferSize()     const { return bufferLen_ - bufferPos_; }
 
   // Get character at position i from char buffer
-  char  getChar(unsigned i) const { return buffer_[bufferPos_ + i]; }
-  char& getChar(unsigned i)       { return buffer_[bufferPos_ + i]; }
+  char  getChar(unsigned i) const { return chars_[bufferPos_ + i]; }
 
   // Read at least numChars into the character buffer
   void fillBuffer(unsigned numChars);
 
+  // FNV-1a hash of a keyword.
+  static unsigned hashKeyword(StringRef s) {
+    unsigned h = 2166136261u;
+    for (unsigned i = 0, n = s.size(); i < n; ++i)
+      h = (h ^ static_cast<unsigned char>(s.data()[i])) * 16777619u;
+    return h;
+  }
+
+  // Add keyList_[i] to keyTable_, growing it if necessary.
+  void insertKeyword(unsigned i);
+
+  // Reset the lexer state for a new input.
+  void reset() {
+    lineNum_      = 1;
+    linePos_      = 1;
+    bufferLen_    = 0;
+    bufferPos_    = 0;
+    stream_eof_   = false;
+    lexical_error = false;
+    tokenPos_     = 0;
+    tokenStart_   = 0;
+    copyToken_    = true;
+    braces_.clear();
+    lookSize_     = 0;
+  }
+
   // Read numTokens into the lookahead buffer
   void readTokens(unsigned numTokens);
 
+  // Append tok to the lookahead buffer.
+  void pushLookAhead(const Token& tok) {
+    assert(lookSize_ < LookAheadCapacity && "Lookahead buffer is full.");
+    lookAhead_[(lookStart_ + lookSize_) % LookAheadCapacity] = tok;
+    ++lookSize_;
+  }
+
  private:
   unsigned  lineNum_;                    // current line number
   unsigned  linePos_;                    // current line position
   std::vector<unsigned short> braces_;   // stack for matching braces
 
   char*     buffer_;         // buffered input
+  const char* chars_;        // input; buffer_, or source_ when in place
   unsigned  bufferLen_;      // current buffer size (not capacity)
   unsigned  bufferPos_;      // current read position within buffer_
 
@@ -299,16 +459,26 @@ protected:
 
   char*     tokenBuffer_;    // stores characters for the current token
   unsigned  tokenPos_;       // write position within tokenBuffer_
+  unsigned  tokenStart_;     // start of the current token within source_
+
+  const char* source_;       // source which is lexed in place, if any
+  bool      copyToken_;      // true if the token is put in tokenBuffer_
 
   CharStream*       charStream_;    // incoming character stream
-  std::deque<Token> lookAhead_;     // queue of lexed tokens
+  Token    lookAhead_[LookAheadCapacity];  // ring buffer of lexed tokens
+  unsigned lookStart_ = 0;                 // index of the first token
+  unsigned lookSize_  = 0;                 // number of tokens
 
   typedef std::map<std::string, unsigned> KeywordDict;
   typedef std::vector<std::string>        KeywordList;
 
   unsigned    startKeywordTokenID_;
-  KeywordDict keyDict_;
   KeywordList keyList_;
+  // Open addressing hash table of keywords, with linear probing.  Each slot
+  // holds the index of a keyword in keyList_ plus one, or 0 if it is empty.
+  // The table is at most one quarter full, so misses are usually found in
+  // one probe.
+  std::vector<unsigned> keyTable_;
   KeywordDict tokenDict_;
   KeywordList tokenList_;
 
@@ -37,8 +37,25 @@ bool Parser::init() {
     success = success && r->init(*this);
   if (!success) {
     std::cerr << "\nFailed to initialize parser.\n";
+    return false;
   }
-  return success;
+
+  // Keywords have been registered, so all token ids are known.
+  if (lexer_->getLastTokenID() >= TokenSet::MaxTokens) {
+    validationError() << "Too many tokens.";
+    return false;
+  }
+
+  // Compute the initial token sets, which are used to choose between options.
+  // References to named definitions may be recursive, so iterate until the
+  // sets reach a fixed point.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (ParseRule *r : definitions_)
+      changed = r->computeFirst(*this) || changed;
+  }
+  return true;
 }
 
 // Public entry point to parsing.
@@ -47,12 +64,9 @@ ParseResult Parser::parse(ParseNamedDefinition* start) {
     parseError(SourceLocation()) << "Start rule must have no arguments";
     return ParseResult();
   }
-  parseError_ = false;
-  resultStack_.clear();
+  beginParse();
   parseRule(start);
-  if (!parseError_)
-    return resultStack_.getBack();
-  return ParseResult();
+  return endParse();
 }
 
 
@@ -92,13 +106,22 @@ std::ostream& Parser::parseError(const SourceLocation& sloc) {
 }
 
 
-bool ParseResult::append(ParseResult &&p) {
+void Parser::expectedTokenError(unsigned tid) {
+  parseError(look().location())
+    << "expecting token: "
+    << getTokenIDString(tid)
+    << " received token: "
+    << getTokenIDString(look().id());
+}
+
+
+bool ParseResult::append(ParseResult &&p, MemRegionRef arena) {
   ListType* vect;
   if (isEmpty()) {
     assert(result_ == nullptr);
     resultKind_ = p.resultKind_;
     isList_ = true;
-    vect = new ListType();
+    vect = new (arena) ListType();
     result_ = vect;
   }
   else {
@@ -108,6 +131,7 @@ bool ParseResult::append(ParseResult &&p) {
   if (p.isList_ || p.resultKind_ != resultKind_)
     return false;
 
+  vect->reserveCheck(1, arena);
   vect->push_back(p.result_);
   p.release();
   return true;
@@ -187,8 +211,11 @@ bool ParseNone::init(Parser& parser) {
 }
 
 
-bool ParseNone::accepts(const Token& tok) {
-  return true;
+// Matches the empty input, so any token may follow.
+bool ParseNone::computeFirst(Parser& parser) {
+  TokenSet all;
+  all.setAll();
+  return firstSet_.merge(all);
 }
 
 
@@ -221,8 +248,11 @@ bool ParseToken::init(Parser& parser) {
 }
 
 
-bool ParseToken::accepts(const Token& tok) {
-  return (tok.id() == tokenID_);
+bool ParseToken::computeFirst(Parser& parser) {
+  if (firstSet_.get(tokenID_))
+    return false;
+  firstSet_.set(tokenID_);
+  return true;
 }
 
 
@@ -242,11 +272,7 @@ ParseRule* ParseToken::parse(Parser& parser) {
       parser.consume();   // Pushes token onto the stack.
   }
   else {
-    parser.parseError(tok.location())
-      << "expecting token: "
-      << parser.getTokenIDString(tokenID_)
-      << " received token: "
-      << parser.getTokenIDString(parser.look().id());
+    parser.expectedTokenError(tokenID_);
   }
   return 0;
 }
@@ -327,8 +353,10 @@ bool ParseSequence::init(Parser& parser) {
 }
 
 
-bool ParseSequence::accepts(const Token& tok) {
-  return first_->accepts(tok);
+bool ParseSequence::computeFirst(Parser& parser) {
+  bool changed = first_->computeFirst(parser);
+  changed = second_->computeFirst(parser) || changed;
+  return firstSet_.merge(first_->firstSet()) || changed;
 }
 
 
@@ -389,8 +417,11 @@ bool ParseOption::init(Parser& parser) {
 }
 
 
-bool ParseOption::accepts(const Token& tok) {
-  return left_->accepts(tok) || right_->accepts(tok);
+bool ParseOption::computeFirst(Parser& parser) {
+  bool changed = left_->computeFirst(parser);
+  changed = right_->computeFirst(parser) || changed;
+  changed = firstSet_.merge(left_->firstSet()) || changed;
+  return firstSet_.merge(right_->firstSet()) || changed;
 }
 
 
@@ -477,8 +508,10 @@ bool ParseRecurseLeft::init(Parser& parser) {
 }
 
 
-bool ParseRecurseLeft::accepts(const Token& tok) {
-  return base_->accepts(tok);
+bool ParseRecurseLeft::computeFirst(Parser& parser) {
+  bool changed = base_->computeFirst(parser);
+  changed = rest_->computeFirst(parser) || changed;
+  return firstSet_.merge(base_->firstSet()) || changed;
 }
 
 
@@ -554,8 +587,9 @@ bool ParseNamedDefinition::init(Parser& parser) {
 }
 
 
-bool ParseNamedDefinition::accepts(const Token& tok) {
-  return rule_->accepts(tok);
+bool ParseNamedDefinition::computeFirst(Parser& parser) {
+  bool changed = rule_->computeFirst(parser);
+  return firstSet_.merge(rule_->firstSet()) || changed;
 }
 
 
@@ -634,8 +668,9 @@ bool ParseReference::init(Parser& parser) {
 }
 
 
-bool ParseReference::accepts(const Token& tok) {
-  return definition_->accepts(tok);
+// The definition computes its own set; references only copy it.
+bool ParseReference::computeFirst(Parser& parser) {
+  return firstSet_.merge(definition_->firstSet());
 }
 
 
@@ -698,69 +733,6 @@ private:
 };
 
 
-class ASTInterpretReducer {
-public:
-  typedef ParseResult ResultType;
-
-  struct ResultArray {
-    ResultArray(ASTInterpretReducer& r, unsigned n) { }
-
-    void add(ParseResult &&pr) { array[i++] = std::move(pr); }
-
-    unsigned i = 0;
-    ParseResult array[ast::Construct::Max_Arity];
-  };
-
-  ParseResult reduceNone() {
-    return ParseResult();
-  }
-
-  ParseResult reduceVariable(ast::Variable &node) {
-    unsigned idx = frameStart_ + node.index();
-    return parser_->resultStack_.getElem(idx);
-  }
-
-  ParseResult reduceTokenStr(ast::TokenStr &node) {
-    const char* s = node.string().c_str();
-    return ParseResult(new Token(TK_None, s, SourceLocation()));
-  }
-
-  ParseResult reduceConstruct(ast::Construct &node, ResultArray& results) {
-    return parser_->makeExpr(node.langOpcode(), node.arity(), results.array);
-  }
-
-  ParseResult reduceEmptyList(ast::EmptyList &node) {
-    return ParseResult();   // Use null as an empty list.
-  }
-
-  ParseResult reduceAppend(ast::Append &node,
-                           ParseResult &&l, ParseResult &&e) {
-    bool success = l.append(std::move(e));
-    if (!success) {
-      parser_->parseError(SourceLocation()) <<
-        "Lists must contain the same kind of node.";
-    }
-    return std::move(l);
-  }
-
-  ASTInterpretReducer() : parser_(nullptr), frameStart_(0) { }
-
-protected:
-  Parser*  parser_;
-  unsigned frameStart_;
-};
-
-
-class ASTInterpreter : public ast::Traversal<ASTInterpreter,
-                                             ASTInterpretReducer> {
-public:
-  ASTInterpreter(Parser *p, unsigned fs) {
-    parser_ = p;
-    frameStart_ = fs;
-  }
-};
-
-
 bool ParseAction::init(Parser& parser) {
   TraceIndenter indenter(parser, "action");
 
@@ -781,6 +753,8 @@ bool ParseAction::init(Parser& parser) {
   if (!success)
     return false;
 
+  compile();
+
   // Drop everything in the current lexical scope off of the abstract stack.
   parser.abstractStack_.rewind();
 
@@ -789,18 +763,101 @@ bool ParseAction::init(Parser& parser) {
   return true;
 }
 
-bool ParseAction::accepts(const Token& tok) {
-  return true;
+
+void ParseAction::compile() {
+  code_.clear();
+  strings_.clear();
+  compileNode(node_);
+}
+
+
+void ParseAction::compileNode(ast::ASTNode* n) {
+  Instr in = { Instr::AI_None, 0, 0, 0 };
+  if (!n) {
+    code_.push_back(in);
+    return;
+  }
+
+  // Arguments are compiled first, so their results are on top of the stack.
+  switch (n->opcode()) {
+    case ast::ASTNode::AST_None:
+    case ast::ASTNode::AST_EmptyList:
+      break;    // Use null as an empty list.
+    case ast::ASTNode::AST_Variable:
+      in.opcode = Instr::AI_Variable;
+      in.index  = cast<ast::Variable>(n)->index();
+      break;
+    case ast::ASTNode::AST_TokenStr:
+      in.opcode = Instr::AI_TokenStr;
+      in.index  = strings_.size();
+      strings_.push_back(cast<ast::TokenStr>(n)->string().c_str());
+      break;
+    case ast::ASTNode::AST_Construct: {
+      auto* c = cast<ast::Construct>(n);
+      for (unsigned i = 0, na = c->arity(); i < na; ++i)
+        compileNode(c->subExpr(i));
+      in.opcode = Instr::AI_Construct;
+      in.arity  = c->arity();
+      in.langOp = c->langOpcode();
+      break;
+    }
+    case ast::ASTNode::AST_Append: {
+      auto* a = cast<ast::Append>(n);
+      compileNode(a->list());
+      compileNode(a->item());
+      in.opcode = Instr::AI_Append;
+      break;
+    }
+  }
+  code_.push_back(in);
+}
+
+bool ParseAction::computeFirst(Parser& parser) {
+  TokenSet all;
+  all.setAll();
+  return firstSet_.merge(all);
 }
 
 
 ParseRule* ParseAction::parse(Parser& parser) {
-  unsigned frameStart = parser.resultStack_.size() - frameSize_;
+  ResultStack& stack = parser.resultStack_;
+  unsigned frameStart = stack.size() - frameSize_;
+
+  for (const Instr& in : code_) {
+    switch (in.opcode) {
+      case Instr::AI_None:
+        stack.push_back(ParseResult());
+        break;
+      case Instr::AI_Variable:
+        stack.moveAndPush(frameStart + in.index);
+        break;
+      case Instr::AI_TokenStr: {
+        Token tok(TK_None, strings_[in.index], SourceLocation());
+        stack.push_back(ParseResult(parser.newToken(tok)));
+        break;
+      }
+      case Instr::AI_Construct: {
+        // The arguments are passed to makeExpr in place.
+        ParseResult e =
+          parser.makeExpr(in.langOp, in.arity, stack.top(in.arity));
+        stack.pop(in.arity);
+        stack.push_back(std::move(e));
+        break;
+      }
+      case Instr::AI_Append: {
+        ParseResult* args = stack.top(2);
+        if (!args[0].append(std::move(args[1]), parser.resultArena_)) {
+          parser.parseError(SourceLocation()) <<
+            "Lists must contain the same kind of node.";
+        }
+        stack.pop(1);
+        break;
+      }
+    }
+  }
 
-  ASTInterpreter interpreter(&parser, frameStart);
-  parser.resultStack_.push_back(interpreter.traverse(node_));
   if (drop_ > 0)
-    parser.resultStack_.drop(drop_, 1);
+    stack.drop(drop_, 1);
   return nullptr;
 }
 
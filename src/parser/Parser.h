@@ -24,6 +24,7 @@
 #ifndef OHMU_PARSER_H
 #define OHMU_PARSER_H
 
+#include "base/SimpleArray.h"
 #include "parser/ASTNode.h"
 #include "parser/Lexer.h"
 
@@ -53,6 +54,8 @@ enum ParseRuleKind {
 
 class Parser;
 class ParseNamedDefinition;
+class ParserGenerator;
+class ParserSnapshot;
 
 
 // Base class for parse rules
@@ -65,8 +68,16 @@ public:
   // tail is true for combinators in a tail-call position.
   virtual bool init(Parser& parser) = 0;
 
+  // Compute the set of tokens which this rule accepts as its initial token,
+  // from the sets of its subrules.  Returns true if the set has changed.
+  // Called by Parser::init until no set changes.
+  virtual bool computeFirst(Parser& parser) = 0;
+
   // Return true if the rule accepts tok as the initial token.
-  virtual bool accepts(const Token& tok) = 0;
+  // Rules which can match the empty input accept every token.
+  bool accepts(const Token& tok) const { return firstSet_.get(tok.id()); }
+
+  const TokenSet& firstSet() const { return firstSet_; }
 
   // Parse input using the current rule.  Returns the the next rule
   // that should be used to parse input.
@@ -76,6 +87,11 @@ public:
 
   inline ParseRuleKind kind() const { return kind_; }
 
+protected:
+  TokenSet firstSet_;     // tokens accepted as the initial token
+
+  friend class ParserSnapshot;
+
 private:
   ParseRuleKind kind_;
 };
@@ -91,7 +107,7 @@ public:
   ~ParseNone() { }
 
   bool       init(Parser& parser) override;
-  bool       accepts(const Token& tok) override ;
+  bool       computeFirst(Parser& parser) override;
   ParseRule* parse(Parser& parser) override;
   void       prettyPrint(Parser& parser, std::ostream& out) override;
 };
@@ -109,7 +125,7 @@ public:
   ~ParseToken() { }
 
   bool       init(Parser& parser) override;
-  bool       accepts(const Token& tok) override;
+  bool       computeFirst(Parser& parser) override;
   ParseRule* parse(Parser& parser) override;
   void       prettyPrint(Parser& parser, std::ostream& out) override;
 
@@ -120,6 +136,9 @@ protected:
 
   unsigned tokenID_;
   bool skip_;
+
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 };
 
 
@@ -139,6 +158,8 @@ public:
 
 private:
   const std::string keywordStr_;
+
+  friend class ParserSnapshot;
 };
 
 
@@ -161,7 +182,7 @@ public:
   inline bool hasLetName() { return letName_.length() > 0; }
 
   bool       init(Parser& parser) override;
-  bool       accepts(const Token& tok) override;
+  bool       computeFirst(Parser& parser) override;
   ParseRule* parse(Parser& parser) override;
   void       prettyPrint(Parser& parser, std::ostream& out) override;
 
@@ -169,6 +190,9 @@ public:
   std::string letName_;
   ParseRule*  first_;
   ParseRule*  second_;
+
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 };
 
 
@@ -186,13 +210,16 @@ public:
   }
 
   bool       init(Parser& parser) override;
-  bool       accepts(const Token& tok) override;
+  bool       computeFirst(Parser& parser) override;
   ParseRule* parse(Parser& parser) override;
   void       prettyPrint(Parser& parser, std::ostream& out) override;
 
  private:
   ParseRule* left_;
   ParseRule* right_;
+
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 };
 
 
@@ -215,7 +242,7 @@ public:
   inline bool hasLetName() { return letName_.length() > 0; }
 
   virtual bool       init(Parser& parser);
-  virtual bool       accepts(const Token& tok);
+  virtual bool       computeFirst(Parser& parser);
   virtual ParseRule* parse(Parser& parser);
   virtual void       prettyPrint(Parser& parser, std::ostream& out);
 
@@ -223,6 +250,9 @@ private:
   std::string letName_;
   ParseRule*  base_;
   ParseRule*  rest_;
+
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 };
 
 
@@ -242,7 +272,7 @@ public:
   }
 
   bool       init(Parser& parser) override;
-  bool       accepts(const Token& tok) override;
+  bool       computeFirst(Parser& parser) override;
   ParseRule* parse(Parser& parser) override;
   void       prettyPrint(Parser& parser, std::ostream& out) override;
 
@@ -257,6 +287,9 @@ private:
   std::string              name_;
   std::vector<std::string> argNames_;
   ParseRule*               rule_;
+
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 };
 
 
@@ -278,7 +311,7 @@ public:
   { }
 
   bool       init(Parser& parser) override;
-  bool       accepts(const Token& tok) override;
+  bool       computeFirst(Parser& parser) override;
   ParseRule* parse(Parser& parser) override;
   void       prettyPrint(Parser& parser, std::ostream& out) override;
 
@@ -293,11 +326,15 @@ public:
   std::vector<unsigned>    arguments_;  // stack indices of arguments
   unsigned                 frameSize_;  // size of the stack frame
   unsigned                 drop_;       // num items to drop from the stack
+
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 };
 
 
 // Constructs an expression in the target language.
-// The ASTNode is interpreted to create the expression.
+// The ASTNode is compiled to a sequence of instructions, which are executed
+// to create the expression.
 // Variables in the ASTNode refer to named results on the parser stack.
 class ParseAction : public ParseRule {
 public:
@@ -311,14 +348,42 @@ public:
   }
 
   bool       init(Parser& parser) override;
-  bool       accepts(const Token& tok) override;
+  bool       computeFirst(Parser& parser) override;
   ParseRule* parse(Parser& parser) override;
   void       prettyPrint(Parser& parser, std::ostream& out) override;
 
 private:
-  ast::ASTNode* node_;    // ASTNode to interpret
+  // An instruction of the compiled action.  Instructions push their result
+  // onto the result stack, and pop their arguments off of it.
+  struct Instr {
+    enum Opcode : unsigned char {
+      AI_None,        // Push an empty result.
+      AI_Variable,    // Move the result at index in the frame to the top.
+      AI_TokenStr,    // Push a token for strings_[index].
+      AI_Construct,   // Replace the top arity results with an expression.
+      AI_Append       // Append the top result to the list below it.
+    };
+
+    Opcode         opcode;
+    unsigned char  arity;    // for Construct
+    unsigned short langOp;   // for Construct
+    unsigned       index;    // for Variable and TokenStr
+  };
+
+  // Compile node_ to code_.  The indices of variables and the opcodes of
+  // constructors in node_ must have been set.
+  void compile();
+  void compileNode(ast::ASTNode* n);
+
+  ast::ASTNode* node_;    // ASTNode to compile
   unsigned frameSize_;    // size of the stack frame
   unsigned drop_;         // num items to drop from the stack.
+
+  std::vector<Instr>       code_;     // compiled action
+  std::vector<const char*> strings_;  // strings of TokenStrs in node_
+
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 };
 
 
@@ -330,10 +395,13 @@ private:
 // ParseResults are move-only objects which hold unique pointers.
 // Teading the result will relinquish ownership of the pointer.
 // Failure to use a parse result is an error.
+//
+// Tokens and lists are allocated in the result arena of the parser, and are
+// freed when the next parse begins, so they must not be deleted.
 class ParseResult {
 public:
   typedef unsigned char      KindType;
-  typedef std::vector<void*> ListType;
+  typedef SimpleArray<void*> ListType;
 
   enum ResultKind {
     PRS_None = 0,
@@ -385,9 +453,9 @@ public:
   }
 
   // Return a list of tokens, and release ownership.
-  std::vector<Token*>* getTokenList() {
+  SimpleArray<Token*>* getTokenList() {
     assert(isTokenList());
-    return getAs< std::vector<Token*> >();
+    return getAs< SimpleArray<Token*> >();
   }
 
   // Return an AST node, and release ownership.
@@ -399,15 +467,15 @@ public:
 
   // Return the node list, and release ownership.
   template <class T>
-  std::vector<T*>* getList(KindType k) {
+  SimpleArray<T*>* getList(KindType k) {
     assert(isList(k));
-    return getAs< std::vector<T*> >();
+    return getAs< SimpleArray<T*> >();
   }
 
   // Append p to this list, and consume p.
-  // If this is an empty result, create a new list.
+  // If this is an empty result, create a new list in arena.
   // Returns false on failure, if kind of p does not match.
-  bool append(ParseResult&& p);
+  bool append(ParseResult&& p, MemRegionRef arena);
 
 private:
   ParseResult(const ParseResult& r) = delete;
@@ -441,16 +509,24 @@ public:
 
   unsigned size() const { return stack_.size(); }
 
+  // Return the n top-most items, which are contiguous.
+  ParseResult* top(unsigned n) {
+    assert(n <= stack_.size() && "Stack too small");
+    return stack_.data() + (stack_.size() - n);
+  }
+
+  // Pop the n top-most items off the stack.
+  void pop(unsigned n) {
+    assert(n <= stack_.size() && "Stack too small");
+    stack_.erase(stack_.end()-n, stack_.end());
+  }
+
   // move the argument at index i onto the top of the stack.
   void moveAndPush(unsigned i) {
     assert(i < stack_.size() && "Array index out of bounds.");
     stack_.emplace_back(std::move(stack_[i]));
   }
 
-  void push_back(const Token& tok) {
-    stack_.emplace_back(ParseResult(new Token(tok)));
-  }
-
   void push_back(ParseResult &&r) {
     stack_.emplace_back(std::move(r));
   }
@@ -657,9 +733,10 @@ protected:
   friend class ParseAction;
 
   friend class ASTIndexVisitor;
-  friend class ASTInterpretReducer;
   friend class TraceIndenter;
   friend class PrintIndenter;
+  friend class ParserGenerator;
+  friend class ParserSnapshot;
 
   // Initialize rule p.  This is used internally to make recursive calls.
   inline bool initRule(ParseRule* p);
@@ -679,10 +756,41 @@ protected:
 
   // consume next token from lexer, and push it onto the stack
   void consume() {
-    resultStack_.push_back(look());
+    resultStack_.push_back(ParseResult(newToken(look())));
     lexer_->consume();
   }
 
+  // Copy tok into the result arena.
+  Token* newToken(const Token& tok) {
+    return new (resultArena_) Token(tok);
+  }
+
+  // The arena for tokens and lists in ParseResults.
+  MemRegionRef resultArena() { return resultArena_; }
+
+  // Parsers which are generated by ParserGenerator call these directly,
+  // rather than interpreting the ParseRules.
+  void beginParse() {
+    parseError_ = false;
+    resultStack_.clear();
+    resultRegion_.reset();
+  }
+
+  ParseResult endParse() {
+    if (!parseError_)
+      return resultStack_.getBack();
+    return ParseResult();
+  }
+
+  ResultStack& resultStack() { return resultStack_; }
+
+  // Return true if s is a slice of the source which the lexer reads in
+  // place.  See Lexer::setSource.
+  bool isInSource(StringRef s) const { return lexer_->isInSource(s); }
+
+  // output an error for a token which does not match tid.
+  void expectedTokenError(unsigned tid);
+
   // output a parser validation error.
   std::ostream& validationError();
 
@@ -699,6 +807,8 @@ private:
   DefinitionDict  definitionDict_;
 
   ResultStack     resultStack_;
+  MemRegion       resultRegion_;
+  MemRegionRef    resultArena_ = MemRegionRef(&resultRegion_);
   AbstractStack   abstractStack_;
   bool            parseError_ = false;
 
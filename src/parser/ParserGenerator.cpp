@@ -0,0 +1,410 @@
+//===- ParserGenerator.cpp -------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "parser/ParserGenerator.h"
+
+#include <cctype>
+#include <cstdio>
+
+
+namespace ohmu {
+
+namespace parsing {
+
+
+void ParserGenerator::generateHeader(std::ostream& out) {
+  std::string guard = "OHMU_GENERATED_";
+  for (char c : className_)
+    guard += std::toupper(c);
+  guard += "_H";
+
+  out << "// Generated by grammar_compiler.  Do not edit.\n\n"
+      << "#ifndef " << guard << "\n"
+      << "#define " << guard << "\n\n"
+      << "#include \"" << baseHeader_ << "\"\n\n"
+      << "namespace ohmu {\n"
+      << "namespace parsing {\n\n\n"
+      << "class " << className_ << " : public " << baseClass_ << " {\n"
+      << "public:\n"
+      << "  " << className_ << "(Lexer* lexer) : " << baseClass_
+      << "(lexer) { }\n\n"
+      << "  // Register the keywords of the grammar with the lexer.\n"
+      << "  bool init();\n\n";
+
+  // Definitions with no arguments can be used as a starting point.
+  for (auto* d : parser_.definitions_) {
+    if (d->numArguments() == 0)
+      out << "  ParseResult parse_" << d->name() << "();\n";
+  }
+
+  out << "\nprivate:\n";
+  for (auto* d : parser_.definitions_)
+    out << "  void " << ruleName(d) << "();\n";
+  out << "};\n\n\n"
+      << "}  // end namespace parsing\n"
+      << "}  // end namespace ohmu\n\n"
+      << "#endif  // " << guard << "\n";
+}
+
+
+void ParserGenerator::generateSource(std::ostream& out,
+                                     const std::string& headerName) {
+  body_.str("");
+  tokenSets_.clear();
+  tempIndex_ = 0;
+
+  for (auto* d : parser_.definitions_) {
+    body_ << "void " << className_ << "::" << ruleName(d) << "() {\n";
+    genRule(d->rule_, 1);
+    body_ << "}\n\n\n";
+  }
+
+  out << "// Generated by grammar_compiler.  Do not edit.\n\n"
+      << "#include \"" << headerName << "\"\n\n"
+      << "#include <iostream>\n\n"
+      << "namespace ohmu {\n"
+      << "namespace parsing {\n\n\n";
+
+  // Membership tests for initial token sets.
+  for (unsigned i = 0, n = tokenSets_.size(); i < n; ++i) {
+    out << "static inline bool inTokenSet" << i << "(unsigned tid) {\n"
+        << "  switch (tid) {\n";
+    for (unsigned tid : tokenSets_[i])
+      out << "    case " << tid << ":\n";
+    out << "      return true;\n"
+        << "    default:\n"
+        << "      return false;\n"
+        << "  }\n"
+        << "}\n\n";
+  }
+  out << "\n";
+
+  // Keywords must have the ids which were used when generating the parser.
+  Lexer* lexer = parser_.lexer_;
+  out << "bool " << className_ << "::init() {\n"
+      << "  static const struct { const char* str; unsigned id; } "
+      << "keywords[] = {\n";
+  for (unsigned tid = lexer->getKeywordStartID(),
+       last = lexer->getLastTokenID(); tid <= last; ++tid) {
+    out << "    { ";
+    writeString(out, lexer->lookupKeywordStr(tid));
+    out << ", " << tid << " },\n";
+  }
+  out << "    { nullptr, 0 }\n"
+      << "  };\n"
+      << "  for (unsigned i = 0; keywords[i].str; ++i) {\n"
+      << "    if (registerKeyword(keywords[i].str) != keywords[i].id) {\n"
+      << "      std::cerr << \"Keyword \" << keywords[i].str\n"
+      << "                << \" has the wrong token id.\\n\";\n"
+      << "      return false;\n"
+      << "    }\n"
+      << "  }\n"
+      << "  return true;\n"
+      << "}\n\n\n";
+
+  for (auto* d : parser_.definitions_) {
+    if (d->numArguments() != 0)
+      continue;
+    out << "ParseResult " << className_ << "::parse_" << d->name()
+        << "() {\n"
+        << "  beginParse();\n"
+        << "  " << ruleName(d) << "();\n"
+        << "  return endParse();\n"
+        << "}\n\n\n";
+  }
+
+  out << body_.str()
+      << "}  // end namespace parsing\n"
+      << "}  // end namespace ohmu\n";
+}
+
+
+std::vector<unsigned> ParserGenerator::tokenIDs(const TokenSet& s) {
+  std::vector<unsigned> ids;
+  for (unsigned tid = 0, last = parser_.lexer_->getLastTokenID();
+       tid <= last; ++tid) {
+    if (s.get(tid))
+      ids.push_back(tid);
+  }
+  return ids;
+}
+
+
+bool ParserGenerator::acceptsAll(const TokenSet& s) {
+  return tokenIDs(s).size() == parser_.lexer_->getLastTokenID() + 1;
+}
+
+
+std::string ParserGenerator::tokenSetFunction(const TokenSet& s) {
+  std::vector<unsigned> ids = tokenIDs(s);
+  unsigned i = 0;
+  for (unsigned n = tokenSets_.size(); i < n; ++i) {
+    if (tokenSets_[i] == ids)
+      break;
+  }
+  if (i == tokenSets_.size())
+    tokenSets_.push_back(std::move(ids));
+  return "inTokenSet" + std::to_string(i);
+}
+
+
+void ParserGenerator::genRule(ParseRule* r, unsigned ind) {
+  switch (r->kind()) {
+    case PR_None:
+      line(ind) << "// none\n";
+      return;
+    case PR_Token:
+      genToken(cast<ParseToken>(r), ind);
+      return;
+    case PR_Keyword:
+      genToken(cast<ParseKeyword>(r), ind);
+      return;
+    case PR_Sequence:
+      genSequence(cast<ParseSequence>(r), ind);
+      return;
+    case PR_Option:
+      genOption(cast<ParseOption>(r), ind);
+      return;
+    case PR_RecurseLeft:
+      genRecurseLeft(cast<ParseRecurseLeft>(r), ind);
+      return;
+    case PR_Reference:
+      genReference(cast<ParseReference>(r), ind);
+      return;
+    case PR_Action:
+      genAction(cast<ParseAction>(r), ind);
+      return;
+    case PR_NamedDefinition:
+      line(ind) << ruleName(cast<ParseNamedDefinition>(r)) << "();\n";
+      return;
+  }
+}
+
+
+void ParserGenerator::genToken(ParseToken* r, unsigned ind) {
+  line(ind) << "if (look().id() != " << r->tokenID_ << ") {  // ";
+  writeString(body_, parser_.getTokenIDString(r->tokenID_));
+  body_ << "\n";
+  line(ind+1) << "expectedTokenError(" << r->tokenID_ << ");\n";
+  line(ind+1) << "return;\n";
+  line(ind) << "}\n";
+  line(ind) << (r->skip_ ? "skip();\n" : "consume();\n");
+}
+
+
+void ParserGenerator::genSequence(ParseSequence* r, unsigned ind) {
+  genRule(r->first_, ind);
+  line(ind) << "if (parseError())\n";
+  line(ind+1) << "return;\n";
+  genRule(r->second_, ind);
+}
+
+
+void ParserGenerator::genOption(ParseOption* r, unsigned ind) {
+  // Flatten a chain of options.  Each token id selects the first option
+  // which accepts it, as in ParseOption::parse.
+  std::vector<ParseRule*> alts;
+  ParseRule* rest = r;
+  while (ParseOption* opt = dyn_cast<ParseOption>(rest)) {
+    if (acceptsAll(opt->left_->firstSet()))
+      break;
+    alts.push_back(opt->left_);
+    rest = opt->right_;
+  }
+  if (ParseOption* opt = dyn_cast<ParseOption>(rest))
+    rest = opt->left_;
+
+  unsigned last = parser_.lexer_->getLastTokenID();
+  std::vector<bool> taken(last + 1, false);
+
+  line(ind) << "switch (look().id()) {\n";
+  for (ParseRule* alt : alts) {
+    bool any = false;
+    for (unsigned tid : tokenIDs(alt->firstSet())) {
+      if (taken[tid])
+        continue;
+      taken[tid] = true;
+      any = true;
+      line(ind+1) << "case " << tid << ":  // ";
+      writeString(body_, parser_.getTokenIDString(tid));
+      body_ << "\n";
+    }
+    if (!any)
+      continue;   // Unreachable.
+    line(ind+2) << "{\n";
+    genRule(alt, ind+3);
+    line(ind+3) << "break;\n";
+    line(ind+2) << "}\n";
+  }
+  line(ind+1) << "default:\n";
+  line(ind+2) << "{\n";
+  genRule(rest, ind+3);
+  line(ind+3) << "break;\n";
+  line(ind+2) << "}\n";
+  line(ind) << "}\n";
+}
+
+
+void ParserGenerator::genRecurseLeft(ParseRecurseLeft* r, unsigned ind) {
+  genRule(r->base_, ind);
+  if (!r->rest_)
+    return;
+  line(ind) << "while (" << tokenSetFunction(r->rest_->firstSet())
+            << "(look().id()) && !parseError()) {\n";
+  genRule(r->rest_, ind+1);
+  line(ind) << "}\n";
+}
+
+
+void ParserGenerator::genReference(ParseReference* r, unsigned ind) {
+  unsigned nargs = r->arguments_.size();
+  if (nargs > 0 || r->drop_ > 0) {
+    line(ind) << "{\n";
+    if (nargs > 0) {
+      line(ind+1) << "unsigned frameStart = resultStack().size() - "
+                  << r->frameSize_ << ";\n";
+      for (unsigned a : r->arguments_)
+        line(ind+1) << "resultStack().moveAndPush(frameStart + "
+                    << a << ");\n";
+    }
+    if (r->drop_ > 0)
+      line(ind+1) << "resultStack().drop(" << r->drop_ << ", "
+                  << nargs << ");\n";
+    line(ind) << "}\n";
+  }
+  line(ind) << ruleName(r->definition_) << "();\n";
+}
+
+
+// Return true if node refers to a result on the stack.
+static bool hasVariables(ast::ASTNode* node) {
+  if (!node)
+    return false;
+  switch (node->opcode()) {
+    case ast::ASTNode::AST_Variable:
+      return true;
+    case ast::ASTNode::AST_Construct: {
+      auto* c = cast<ast::Construct>(node);
+      for (unsigned i = 0, n = c->arity(); i < n; ++i) {
+        if (hasVariables(c->subExpr(i)))
+          return true;
+      }
+      return false;
+    }
+    case ast::ASTNode::AST_Append: {
+      auto* a = cast<ast::Append>(node);
+      return hasVariables(a->list()) || hasVariables(a->item());
+    }
+    default:
+      return false;
+  }
+}
+
+
+void ParserGenerator::genAction(ParseAction* r, unsigned ind) {
+  line(ind) << "{\n";
+  if (hasVariables(r->node_)) {
+    line(ind+1) << "unsigned frameStart = resultStack().size() - "
+                << r->frameSize_ << ";\n";
+  }
+  std::string res = genASTNode(r->node_, ind+1);
+  line(ind+1) << "resultStack().push_back(std::move(" << res << "));\n";
+  if (r->drop_ > 0)
+    line(ind+1) << "resultStack().drop(" << r->drop_ << ", 1);\n";
+  line(ind) << "}\n";
+}
+
+
+std::string ParserGenerator::genASTNode(ast::ASTNode* node, unsigned ind) {
+  std::string res = "r" + std::to_string(tempIndex_++);
+  if (!node) {
+    line(ind) << "ParseResult " << res << ";\n";
+    return res;
+  }
+
+  switch (node->opcode()) {
+    case ast::ASTNode::AST_None:
+    case ast::ASTNode::AST_EmptyList:
+      line(ind) << "ParseResult " << res << ";\n";
+      break;
+    case ast::ASTNode::AST_Variable: {
+      auto* v = cast<ast::Variable>(node);
+      line(ind) << "ParseResult " << res
+                << " = resultStack().getElem(frameStart + " << v->index()
+                << ");  // " << v->name() << "\n";
+      break;
+    }
+    case ast::ASTNode::AST_TokenStr: {
+      auto* t = cast<ast::TokenStr>(node);
+      line(ind) << "ParseResult " << res << "(newToken(Token(TK_None, ";
+      writeString(body_, t->string());
+      body_ << ", SourceLocation())));\n";
+      break;
+    }
+    case ast::ASTNode::AST_Construct: {
+      auto* c = cast<ast::Construct>(node);
+      std::vector<std::string> args;
+      for (unsigned i = 0, n = c->arity(); i < n; ++i)
+        args.push_back(genASTNode(c->subExpr(i), ind));
+      std::string arr = "a" + res.substr(1);
+      line(ind) << "ParseResult " << arr
+                << "[ast::Construct::Max_Arity];\n";
+      for (unsigned i = 0, n = args.size(); i < n; ++i)
+        line(ind) << arr << "[" << i << "] = std::move(" << args[i] << ");\n";
+      line(ind) << "ParseResult " << res << " = makeExpr("
+                << c->langOpcode() << ", " << args.size() << ", " << arr
+                << ");  // " << c->opcodeName() << "\n";
+      break;
+    }
+    case ast::ASTNode::AST_Append: {
+      auto* a = cast<ast::Append>(node);
+      std::string l = genASTNode(a->list(), ind);
+      std::string e = genASTNode(a->item(), ind);
+      line(ind) << "ParseResult " << res << " = std::move(" << l << ");\n";
+      line(ind) << "if (!" << res << ".append(std::move(" << e
+                << "), resultArena()))\n";
+      line(ind+1) << "parseError(SourceLocation()) <<\n";
+      line(ind+2) << "\"Lists must contain the same kind of node.\";\n";
+      break;
+    }
+  }
+  return res;
+}
+
+
+void ParserGenerator::writeString(std::ostream& out, const std::string& s) {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    }
+    else if (c < ' ' || c > '~') {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\%03o", static_cast<unsigned char>(c));
+      out << buf;
+    }
+    else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+
+}  // end namespace parsing
+
+}  // end namespace ohmu
@@ -0,0 +1,111 @@
+//===- ParserGenerator.h ---------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// ParserGenerator compiles the parse rules of an initialized Parser into C++.
+// The generated parser is a subclass of the parser, in which each named
+// definition is a member function.  Options become a switch on the token id,
+// using the initial token sets computed by Parser::init, references become
+// direct calls, and actions call makeExpr directly instead of interpreting
+// an ASTNode.  The generated parser builds the same results, on the same
+// ResultStack, as the interpreted one.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_PARSERGENERATOR_H
+#define OHMU_PARSERGENERATOR_H
+
+#include "parser/Parser.h"
+
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ohmu {
+
+namespace parsing {
+
+
+class ParserGenerator {
+public:
+  // Generate className, which derives from baseClass, declared in
+  // baseHeader.  The parser must have been initialized.
+  ParserGenerator(Parser& parser, std::string className,
+                  std::string baseClass, std::string baseHeader)
+    : parser_(parser), className_(std::move(className)),
+      baseClass_(std::move(baseClass)), baseHeader_(std::move(baseHeader))
+  { }
+
+  // Write the class declaration.
+  void generateHeader(std::ostream& out);
+
+  // Write the class definition.  headerName is the file which holds the
+  // output of generateHeader.
+  void generateSource(std::ostream& out, const std::string& headerName);
+
+private:
+  // Name of the member function for definition d.
+  std::string ruleName(ParseNamedDefinition* d) {
+    return "rule_" + d->name();
+  }
+
+  // Return the ids in s, up to the last id of the lexer.
+  std::vector<unsigned> tokenIDs(const TokenSet& s);
+
+  // Return true if s contains every token id.
+  bool acceptsAll(const TokenSet& s);
+
+  // Return the name of a function which tests for membership in s.
+  std::string tokenSetFunction(const TokenSet& s);
+
+  // Write statements which parse rule r.
+  void genRule(ParseRule* r, unsigned ind);
+  void genToken(ParseToken* r, unsigned ind);
+  void genSequence(ParseSequence* r, unsigned ind);
+  void genOption(ParseOption* r, unsigned ind);
+  void genRecurseLeft(ParseRecurseLeft* r, unsigned ind);
+  void genReference(ParseReference* r, unsigned ind);
+  void genAction(ParseAction* r, unsigned ind);
+
+  // Write statements which evaluate node into a new ParseResult, and
+  // return the name of the result.
+  std::string genASTNode(ast::ASTNode* node, unsigned ind);
+
+  // Write a C++ string literal.
+  static void writeString(std::ostream& out, const std::string& s);
+
+  std::ostream& line(unsigned ind) {
+    for (unsigned i = 0; i < ind; ++i) body_ << "  ";
+    return body_;
+  }
+
+  Parser&     parser_;
+  std::string className_;
+  std::string baseClass_;
+  std::string baseHeader_;
+
+  std::ostringstream body_;         // member function definitions
+  std::vector<std::vector<unsigned>> tokenSets_;  // see tokenSetFunction
+  unsigned tempIndex_ = 0;
+};
+
+
+}  // end namespace parsing
+
+}  // end namespace ohmu
+
+#endif  // OHMU_PARSERGENERATOR_H
@@ -0,0 +1,545 @@
+//===- ParserSnapshot.cpp --------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "parser/ParserSnapshot.h"
+#include "parser/BNFParser.h"
+
+#include "base/VarInt.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+#ifdef _MSC_VER
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+
+namespace ohmu {
+
+namespace parsing {
+
+
+// Marks a missing rule or ASTNode in place of its kind.
+static const unsigned NoKind = 0x7F;
+
+
+// Read all of fileName into buf, with a single read.
+static bool readWholeFile(const char* fileName, std::string& buf) {
+  FILE* f = fopen(fileName, "rb");
+  if (!f)
+    return false;
+  bool success = false;
+  if (fseek(f, 0, SEEK_END) == 0) {
+    long size = ftell(f);
+    if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+      buf.resize(size);
+      success = size == 0 || fread(&buf[0], 1, size, f) == size_t(size);
+    }
+  }
+  fclose(f);
+  return success;
+}
+
+
+// Return a name for a temporary copy of fileName, which is unique to this
+// process and call, so that concurrent writers do not share a file.
+static std::string tempFileName(const char* fileName) {
+  static std::atomic<unsigned> counter(0);
+#ifdef _MSC_VER
+  long pid = _getpid();
+#else
+  long pid = getpid();
+#endif
+  return std::string(fileName) + "." + std::to_string(pid) + "." +
+         std::to_string(counter++) + ".tmp";
+}
+
+
+// Replace fileName with data.  The data is written to a temporary file
+// first, so that a concurrent reader never sees a partial snapshot.
+static bool writeWholeFile(const char* fileName, const std::string& data) {
+  std::string tmpName = tempFileName(fileName);
+  FILE* f = fopen(tmpName.c_str(), "wb");
+  if (!f)
+    return false;
+  bool success = fwrite(data.data(), 1, data.size(), f) == data.size();
+  success = (fclose(f) == 0) && success;
+  if (success && std::rename(tmpName.c_str(), fileName) != 0) {
+    // Windows will not rename over an existing file.
+    std::remove(fileName);
+    success = std::rename(tmpName.c_str(), fileName) == 0;
+  }
+  if (!success)
+    std::remove(tmpName.c_str());
+  return success;
+}
+
+
+// 64-bit FNV-1a.
+uint64_t ParserSnapshot::hashGrammar(const char* data, size_t size) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= static_cast<uint8_t>(data[i]);
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+
+/*** Encoding ***/
+
+void ParserSnapshot::writeInt(uint64_t v) {
+  uint8_t buf[VarInt::MaxSize];
+  unsigned n = VarInt::encode(v, buf);
+  out_->append(reinterpret_cast<char*>(buf), n);
+}
+
+
+void ParserSnapshot::writeString(const std::string& s) {
+  writeInt(s.length());
+  out_->append(s);
+}
+
+
+// Trailing words which are zero are not written.
+void ParserSnapshot::writeTokenSet(const TokenSet& s) {
+  unsigned n = TokenSet::numWords();
+  while (n > 0 && s.word(n-1) == 0)
+    --n;
+  writeInt(n);
+  for (unsigned i = 0; i < n; ++i)
+    writeInt(s.word(i));
+}
+
+
+bool ParserSnapshot::writeRule(ParseRule* r) {
+  if (!r) {
+    writeInt(NoKind);
+    return true;
+  }
+  writeInt(r->kind());
+  writeTokenSet(r->firstSet_);
+
+  switch (r->kind()) {
+    case PR_None:
+      return true;
+    case PR_Token: {
+      auto* t = cast<ParseToken>(r);
+      writeInt(t->tokenID_);
+      writeInt(t->skip_);
+      return true;
+    }
+    case PR_Keyword: {
+      auto* k = cast<ParseKeyword>(r);
+      writeInt(k->tokenID_);
+      writeString(k->keywordStr_);
+      return true;
+    }
+    case PR_Sequence: {
+      auto* s = cast<ParseSequence>(r);
+      writeString(s->letName_);
+      return writeRule(s->first_) && writeRule(s->second_);
+    }
+    case PR_Option: {
+      auto* o = cast<ParseOption>(r);
+      return writeRule(o->left_) && writeRule(o->right_);
+    }
+    case PR_RecurseLeft: {
+      auto* rl = cast<ParseRecurseLeft>(r);
+      writeString(rl->letName_);
+      return writeRule(rl->base_) && writeRule(rl->rest_);
+    }
+    case PR_Reference: {
+      auto* ref = cast<ParseReference>(r);
+      unsigned idx = 0;
+      auto& defs = parser_.definitions_;
+      while (idx < defs.size() && defs[idx] != ref->definition_)
+        ++idx;
+      if (idx == defs.size())
+        return false;
+      writeInt(idx);
+      writeInt(ref->argNames_.size());
+      for (auto& s : ref->argNames_)
+        writeString(s);
+      writeInt(ref->arguments_.size());
+      for (unsigned a : ref->arguments_)
+        writeInt(a);
+      writeInt(ref->frameSize_);
+      writeInt(ref->drop_);
+      return true;
+    }
+    case PR_Action: {
+      auto* a = cast<ParseAction>(r);
+      writeInt(a->frameSize_);
+      writeInt(a->drop_);
+      return writeASTNode(a->node_);
+    }
+    case PR_NamedDefinition:
+      // Named definitions only occur at the top level.
+      return false;
+  }
+  return false;
+}
+
+
+bool ParserSnapshot::writeASTNode(ast::ASTNode* node) {
+  if (!node) {
+    writeInt(NoKind);
+    return true;
+  }
+  writeInt(node->opcode());
+
+  switch (node->opcode()) {
+    case ast::ASTNode::AST_None:
+      return true;
+    case ast::ASTNode::AST_Variable: {
+      auto* v = cast<ast::Variable>(node);
+      writeString(v->name());
+      writeInt(v->index());
+      return true;
+    }
+    case ast::ASTNode::AST_TokenStr:
+      writeString(cast<ast::TokenStr>(node)->string());
+      return true;
+    case ast::ASTNode::AST_Construct: {
+      auto* c = cast<ast::Construct>(node);
+      writeString(c->opcodeName());
+      writeInt(c->arity());
+      for (unsigned i = 0, n = c->arity(); i < n; ++i) {
+        if (!writeASTNode(c->subExpr(i)))
+          return false;
+      }
+      return true;
+    }
+    case ast::ASTNode::AST_EmptyList:
+      return true;
+    case ast::ASTNode::AST_Append: {
+      auto* a = cast<ast::Append>(node);
+      return writeASTNode(a->list()) && writeASTNode(a->item());
+    }
+  }
+  return false;
+}
+
+
+bool ParserSnapshot::write(Parser& parser, uint64_t grammarHash,
+                           std::string& out) {
+  ParserSnapshot snap(parser);
+  snap.out_ = &out;
+  Lexer* lexer = parser.lexer_;
+
+  snap.writeInt(Magic);
+  snap.writeInt(Version);
+  snap.writeInt(grammarHash);
+
+  unsigned startID = lexer->getKeywordStartID();
+  snap.writeInt(startID);
+  for (unsigned tid = 0; tid < startID; ++tid) {
+    const char* s = lexer->getTokenIDString(tid);
+    snap.writeString(s ? s : "");
+  }
+
+  unsigned endID = lexer->getLastTokenID() + 1;
+  snap.writeInt(endID - startID);
+  for (unsigned tid = startID; tid < endID; ++tid)
+    snap.writeString(lexer->lookupKeywordStr(tid));
+
+  // All names are written first, so that references can refer to
+  // definitions which occur later.
+  auto& defs = parser.definitions_;
+  snap.writeInt(defs.size());
+  for (auto* d : defs) {
+    snap.writeString(d->name_);
+    snap.writeInt(d->argNames_.size());
+    for (auto& s : d->argNames_)
+      snap.writeString(s);
+  }
+  for (auto* d : defs) {
+    snap.writeTokenSet(d->firstSet_);
+    if (!snap.writeRule(d->rule_))
+      return false;
+  }
+  return true;
+}
+
+
+/*** Decoding ***/
+
+uint64_t ParserSnapshot::readInt() {
+  if (pos_ >= end_) {
+    valid_ = false;
+    return 0;
+  }
+  uint64_t v;
+  pos_ = VarInt::decode(pos_, end_, &v);
+  return v;
+}
+
+
+std::string ParserSnapshot::readString() {
+  uint64_t len = readInt();
+  if (len > static_cast<uint64_t>(end_ - pos_)) {
+    valid_ = false;
+    return std::string();
+  }
+  std::string s(reinterpret_cast<const char*>(pos_), len);
+  pos_ += len;
+  return s;
+}
+
+
+void ParserSnapshot::readTokenSet(TokenSet& s) {
+  uint64_t n = readInt();
+  if (n > TokenSet::numWords()) {
+    valid_ = false;
+    return;
+  }
+  for (unsigned i = 0; i < n; ++i)
+    s.setWord(i, readInt());
+}
+
+
+ParseRule* ParserSnapshot::readRule() {
+  uint64_t kind = readInt();
+  if (!valid_ || kind == NoKind)
+    return nullptr;
+  TokenSet firstSet;
+  readTokenSet(firstSet);
+
+  ParseRule* r = nullptr;
+  switch (kind) {
+    case PR_None:
+      r = new ParseNone();
+      break;
+    case PR_Token: {
+      unsigned tid = readInt();
+      bool skip = readInt() != 0;
+      r = new ParseToken(tid, skip);
+      break;
+    }
+    case PR_Keyword: {
+      unsigned tid = readInt();
+      auto* k = new ParseKeyword(readString());
+      k->tokenID_ = tid;
+      r = k;
+      break;
+    }
+    case PR_Sequence: {
+      std::string letName = readString();
+      ParseRule* first  = readRule();
+      ParseRule* second = readRule();
+      r = new ParseSequence(std::move(letName), first, second);
+      break;
+    }
+    case PR_Option: {
+      ParseRule* left  = readRule();
+      ParseRule* right = readRule();
+      r = new ParseOption(left, right);
+      break;
+    }
+    case PR_RecurseLeft: {
+      std::string letName = readString();
+      ParseRule* base = readRule();
+      ParseRule* rest = readRule();
+      r = new ParseRecurseLeft(std::move(letName), base, rest);
+      break;
+    }
+    case PR_Reference: {
+      uint64_t idx = readInt();
+      if (idx >= definitions_.size()) {
+        valid_ = false;
+        return nullptr;
+      }
+      auto* ref = new ParseReference(definitions_[idx]);
+      for (uint64_t n = readInt(); n > 0 && valid_; --n)
+        ref->addArgument(readString());
+      for (uint64_t n = readInt(); n > 0 && valid_; --n)
+        ref->arguments_.push_back(readInt());
+      ref->frameSize_ = readInt();
+      ref->drop_ = readInt();
+      r = ref;
+      break;
+    }
+    case PR_Action: {
+      unsigned frameSize = readInt();
+      unsigned drop = readInt();
+      auto* a = new ParseAction(readASTNode());
+      a->frameSize_ = frameSize;
+      a->drop_ = drop;
+      a->compile();
+      r = a;
+      break;
+    }
+    default:
+      valid_ = false;
+      return nullptr;
+  }
+  r->firstSet_ = firstSet;
+  return r;
+}
+
+
+ast::ASTNode* ParserSnapshot::readASTNode() {
+  uint64_t op = readInt();
+  if (!valid_ || op == NoKind)
+    return nullptr;
+
+  switch (op) {
+    case ast::ASTNode::AST_Variable: {
+      auto* v = new ast::Variable(readString());
+      v->setIndex(readInt());
+      return v;
+    }
+    case ast::ASTNode::AST_TokenStr:
+      return new ast::TokenStr(readString());
+    case ast::ASTNode::AST_Construct: {
+      std::string name = readString();
+      uint64_t arity = readInt();
+      if (arity > ast::Construct::Max_Arity) {
+        valid_ = false;
+        return nullptr;
+      }
+      ast::ASTNode* e[ast::Construct::Max_Arity] = { };
+      for (unsigned i = 0; i < arity && valid_; ++i)
+        e[i] = readASTNode();
+
+      ast::Construct* c = nullptr;
+      switch (arity) {
+        case 0: c = new ast::ConstructN<0>(name); break;
+        case 1: c = new ast::ConstructN<1>(name, e[0]); break;
+        case 2: c = new ast::ConstructN<2>(name, e[0], e[1]); break;
+        case 3: c = new ast::ConstructN<3>(name, e[0], e[1], e[2]); break;
+        case 4:
+          c = new ast::ConstructN<4>(name, e[0], e[1], e[2], e[3]);
+          break;
+        case 5:
+          c = new ast::ConstructN<5>(name, e[0], e[1], e[2], e[3], e[4]);
+          break;
+      }
+      // Opcodes belong to the target parser rather than to the grammar, so
+      // they are looked up again.
+      unsigned lop = parser_.lookupOpcode(name);
+      if (lop == ast::Construct::InvalidOpcode)
+        valid_ = false;
+      c->setLangOpcode(static_cast<unsigned short>(lop));
+      return c;
+    }
+    case ast::ASTNode::AST_EmptyList:
+      return new ast::EmptyList();
+    case ast::ASTNode::AST_Append: {
+      ast::ASTNode* list = readASTNode();
+      ast::ASTNode* item = readASTNode();
+      return new ast::Append(list, item);
+    }
+  }
+  valid_ = false;
+  return nullptr;
+}
+
+
+bool ParserSnapshot::read(Parser& parser, uint64_t grammarHash,
+                          const char* data, size_t size) {
+  if (!parser.definitions_.empty())
+    return false;
+
+  ParserSnapshot snap(parser);
+  snap.pos_ = reinterpret_cast<const uint8_t*>(data);
+  snap.end_ = snap.pos_ + size;
+  Lexer* lexer = parser.lexer_;
+
+  if (snap.readInt() != Magic || snap.readInt() != Version ||
+      snap.readInt() != grammarHash)
+    return false;
+
+  // Token ids are stored directly, so the lexer must be the same.
+  unsigned startID = lexer->getKeywordStartID();
+  if (snap.readInt() != startID)
+    return false;
+  for (unsigned tid = 0; tid < startID; ++tid) {
+    const char* s = lexer->getTokenIDString(tid);
+    if (snap.readString() != (s ? s : "") || !snap.valid_)
+      return false;
+  }
+
+  std::vector<std::string> keywords;
+  uint64_t numKeywords = snap.readInt();
+  if (startID + numKeywords > TokenSet::MaxTokens)
+    return false;
+  for (unsigned i = 0; i < numKeywords && snap.valid_; ++i)
+    keywords.push_back(snap.readString());
+
+  // Each definition takes at least two bytes.
+  uint64_t numDefs = snap.readInt();
+  if (numDefs > size / 2)
+    return false;
+  auto& defs = snap.definitions_;
+  for (unsigned i = 0; i < numDefs && snap.valid_; ++i) {
+    auto* d = new ParseNamedDefinition(snap.readString());
+    for (uint64_t n = snap.readInt(); n > 0 && snap.valid_; --n)
+      d->addArgument(snap.readString());
+    defs.push_back(d);
+  }
+  for (unsigned i = 0; i < defs.size() && snap.valid_; ++i) {
+    snap.readTokenSet(defs[i]->firstSet_);
+    defs[i]->rule_ = snap.readRule();
+  }
+
+  bool success = snap.valid_ && snap.pos_ == snap.end_;
+  for (unsigned i = 0; i < keywords.size() && success; ++i)
+    success = parser.registerKeyword(keywords[i]) == startID + i;
+  if (!success) {
+    for (auto* d : defs)
+      delete d;
+    return false;
+  }
+  for (auto* d : defs)
+    parser.addDefinition(d);
+  return true;
+}
+
+
+bool ParserSnapshot::initParser(Parser& parser, const char* grammarFileName,
+                                const char* snapshotFileName) {
+  std::string grammar;
+  if (!readWholeFile(grammarFileName, grammar)) {
+    std::cerr << "File " << grammarFileName << " not found.\n";
+    return false;
+  }
+  uint64_t hash = hashGrammar(grammar.data(), grammar.size());
+
+  std::string snapshot;
+  if (readWholeFile(snapshotFileName, snapshot) &&
+      read(parser, hash, snapshot.data(), snapshot.size()))
+    return true;
+
+  // The snapshot is missing or out of date, so rebuild it.
+  StringStream stream(grammar.c_str());
+  if (!BNFParser::initParserFromStream(parser, stream))
+    return false;
+  snapshot.clear();
+  if (write(parser, hash, snapshot))
+    writeWholeFile(snapshotFileName, snapshot);
+  return true;
+}
+
+
+}  // end namespace parsing
+
+}  // end namespace ohmu
@@ -0,0 +1,108 @@
+//===- ParserSnapshot.h ----------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// ParserSnapshot saves an initialized Parser to a compact binary form, and
+// restores it without reading the grammar.  Restoring a snapshot skips the
+// BNF parser, and the validation, stack layout, and initial token set
+// computations of Parser::init, all of which are stored in the snapshot.
+//
+// The layout of a snapshot is:
+//
+//   header:       magic, version, hash of the grammar source
+//   tokens:       names of the lexer's built-in tokens
+//   keywords:     keywords, in the order of their token ids
+//   definitions:  names and arguments of the named definitions,
+//                 followed by the rules of each definition
+//
+// Integers are encoded as VarInts.  A snapshot is valid only for the grammar
+// with the same hash, and for a lexer with the same built-in tokens; any
+// other snapshot is rejected when it is read.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_PARSERSNAPSHOT_H
+#define OHMU_PARSERSNAPSHOT_H
+
+#include "parser/Parser.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ohmu {
+
+namespace parsing {
+
+
+class ParserSnapshot {
+public:
+  static const uint32_t Magic   = 0x5347484f;   // "OHGS"
+  static const uint32_t Version = 1;
+
+  // Return the hash of a grammar source, which identifies its snapshots.
+  static uint64_t hashGrammar(const char* data, size_t size);
+
+  // Append a snapshot of parser to out.  The parser must have been
+  // initialized.  Returns false if the parser cannot be saved.
+  static bool write(Parser& parser, uint64_t grammarHash, std::string& out);
+
+  // Restore parser from the snapshot in data, which must have been made
+  // from the grammar with the given hash.  The parser must have no
+  // definitions, and its lexer no keywords.  Returns false, and leaves the
+  // parser without definitions, if the snapshot is invalid.
+  static bool read(Parser& parser, uint64_t grammarHash,
+                   const char* data, size_t size);
+
+  // Initialize parser from a grammar file, using snapshotFileName as a
+  // cache.  If the snapshot is valid for the grammar, it is loaded;
+  // otherwise the grammar is parsed, and a new snapshot is written.
+  static bool initParser(Parser& parser, const char* grammarFileName,
+                         const char* snapshotFileName);
+
+private:
+  ParserSnapshot(Parser& parser) : parser_(parser) { }
+
+  // Encoding.
+  void writeInt(uint64_t v);
+  void writeString(const std::string& s);
+  void writeTokenSet(const TokenSet& s);
+  bool writeRule(ParseRule* r);
+  bool writeASTNode(ast::ASTNode* node);
+
+  // Decoding.  Each of these sets valid_ to false on malformed input.
+  uint64_t readInt();
+  std::string readString();
+  void readTokenSet(TokenSet& s);
+  ParseRule* readRule();
+  ast::ASTNode* readASTNode();
+
+  Parser& parser_;
+
+  std::string* out_ = nullptr;
+
+  const uint8_t* pos_ = nullptr;
+  const uint8_t* end_ = nullptr;
+  bool           valid_ = true;
+  std::vector<ParseNamedDefinition*> definitions_;
+};
+
+
+}  // end namespace parsing
+
+}  // end namespace ohmu
+
+#endif  // OHMU_PARSERSNAPSHOT_H
@@ -109,6 +109,8 @@ TIL_CastOpcode TILParser::lookupCastOpcode(StringRef s) {
 
 
 inline StringRef TILParser::copyStr(StringRef s) {
+  if (keepSourceStrings_ && isInSource(s))
+    return s;
   // Put all strings in the string arena, which must survive
   // for the duration of the compile.
   char* temp = reinterpret_cast<char*>(stringArena_.allocate(s.size()+1));
@@ -123,22 +125,26 @@ bool TILParser::toBool(StringRef s) {
 }
 
 char TILParser::toChar(StringRef s) {
-  return s.c_str()[0];
+  return s.size() > 0 ? s.data()[0] : 0;
 }
 
+// Token strings may be slices of the source, which are not null-terminated,
+// so numbers are converted from a copy.
 int TILParser::toInteger(StringRef s) {
+  std::string str = s.str();
   char* end = nullptr;
-  long long val = strtol(s.c_str(), &end, 0);
+  long long val = strtol(str.c_str(), &end, 0);
   // FIXME: some proper error handling here?
-  assert(end == s.c_str() + s.size() && "Could not parse string.");
+  assert(end == str.c_str() + str.size() && "Could not parse string.");
   return static_cast<int>(val);
 }
 
 double TILParser::toDouble(StringRef s) {
+  std::string str = s.str();
   char* end = nullptr;
-  double val = strtod(s.c_str(), &end);
+  double val = strtod(str.c_str(), &end);
   // FIXME: some proper error handling here?
-  assert(end == s.c_str() + s.size() && "Could not parse string.");
+  assert(end == str.c_str() + str.size() && "Could not parse string.");
   return val;
 }
 
@@ -154,7 +160,7 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
     return prs[i].getToken();
   };
   /*
-  auto tokList = [=](unsigned i) -> std::vector< Token* >* {
+  auto tokList = [=](unsigned i) -> SimpleArray<Token*>* {
     if (!prs[i].isTokenList() || i >= arity)
       return nullptr;
     return prs[i].getTokenList();
@@ -165,7 +171,7 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       return nullptr;
     return prs[i].getNode<SExpr>(TILP_SExpr);
   };
-  auto sexprList = [=](unsigned i) -> std::vector<SExpr*>* {
+  auto sexprList = [=](unsigned i) -> SimpleArray<SExpr*>* {
     if (!prs[i].isList(TILP_SExpr) || i >= arity)
       return nullptr;
     return prs[i].getList<SExpr>(TILP_SExpr);
@@ -180,35 +186,30 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 1);
       Token *t = tok(0);
       auto* e = new (arena_) LiteralT<bool>(toBool(t->string()));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_LitChar: {
       assert(arity == 1);
       Token *t = tok(0);
       auto* e = new (arena_) LiteralT<uint8_t>(toChar(t->string()));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_LitInteger: {
       assert(arity == 1);
       Token *t = tok(0);
       auto* e = new (arena_) LiteralT<int>(toInteger(t->string()));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_LitFloat: {
       assert(arity == 1);
       Token *t = tok(0);
       auto* e = new (arena_) LiteralT<double>(toDouble(t->string()));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_LitString: {
       assert(arity == 1);
       Token* t = tok(0);
       auto* e = new (arena_) LiteralT<StringRef>(toString(t->string()));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
 
@@ -216,7 +217,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 1);
       Token* t = tok(0);
       auto* e = new (arena_) Identifier(copyStr(t->string()));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_Function: {
@@ -225,7 +225,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       auto* v = new (arena_) VarDecl(VarDecl::VK_Fun,
                                      copyStr(t->string()), sexpr(1));
       auto* e = new (arena_) Function(v, sexpr(2));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_SFunction: {
@@ -234,7 +233,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       auto* v = new (arena_) VarDecl(VarDecl::VK_SFun,
                                      copyStr(t->string()), nullptr);
       auto* e = new (arena_) Function(v, sexpr(1));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_Code: {
@@ -250,7 +248,7 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
     case TCOP_Record: {
       assert(arity == 1 || arity == 2);
       SExpr *p;
-      std::vector<SExpr*>* es;
+      SimpleArray<SExpr*>* es;
       if (arity == 1) {
         p  = nullptr;
         es = sexprList(0);
@@ -265,7 +263,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
         if (s)
           r->slots().emplace_back(arena_, s);
       }
-      delete es;
       return ParseResult(TILP_SExpr, r);
     }
     case TCOP_Slot: {
@@ -273,7 +270,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       Token* t = tok(0);
       SExpr* d = sexpr(1);
       auto* s = new (arena_) Slot(copyStr(t->string()), d);
-      delete t;
       return ParseResult(TILP_SExpr, s);
     }
     case TCOP_Array: {
@@ -299,7 +295,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 2);
       Token* t = tok(1);
       auto* e = new (arena_) Project(sexpr(0), copyStr(t->string()));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_Call: {
@@ -338,7 +333,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 2);
       Token* t = tok(0);
       TIL_UnaryOpcode uop = lookupUnaryOpcode(t->string());
-      delete t;
       auto* e = new (arena_) UnaryOp(uop, sexpr(1));
       return ParseResult(TILP_SExpr, e);
     }
@@ -346,7 +340,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 3);
       Token* t = tok(0);
       TIL_BinaryOpcode bop = lookupBinaryOpcode(t->string());
-      delete t;
       auto* e = new (arena_) BinaryOp(bop, sexpr(1), sexpr(2));
       return ParseResult(TILP_SExpr, e);
     }
@@ -354,7 +347,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       assert(arity == 2);
       Token* t = tok(0);
       TIL_CastOpcode cop = lookupCastOpcode(t->string());
-      delete t;
       auto* e = new (arena_) Cast(cop, sexpr(1));
       return ParseResult(TILP_SExpr, e);
     }
@@ -365,7 +357,6 @@ ParseResult TILParser::makeExpr(unsigned op, unsigned arity, ParseResult *prs) {
       auto* v = new (arena_) VarDecl(VarDecl::VK_Let,
                                      copyStr(t->string()), sexpr(1));
       auto* e = new (arena_) Let(v, sexpr(2));
-      delete t;
       return ParseResult(TILP_SExpr, e);
     }
     case TCOP_If: {
@@ -94,6 +94,11 @@ public:
     stringArena_ = strArena;
   }
 
+  // If b is true, strings which are slices of a source that the lexer reads
+  // in place are used directly, rather than copied into the string arena.
+  // The source must then live as long as the string arena.
+  void setKeepSourceStrings(bool b) { keepSourceStrings_ = b; }
+
   const char* getOpcodeName(TIL_ConstructOp op);
 
   void initMap();
@@ -116,6 +121,7 @@ public:
 private:
    MemRegionRef arena_;
    MemRegionRef stringArena_;
+   bool         keepSourceStrings_ = false;
 
    std::unordered_map<std::string, unsigned> opcodeMap_;
    std::unordered_map<std::string, unsigned> unaryOpcodeMap_;
@@ -97,18 +97,44 @@ private:
 
 class TokenSet {
 public:
-  bool get(int i) const {
-    unsigned idx = i/sizeof(unsigned);
-    unsigned rem = i - idx*sizeof(unsigned);
-    return (bits_[idx] >> rem) & 0x01;
+  // Maximum number of token ids in a set.
+  static const unsigned MaxTokens = 512;
+
+  TokenSet() { makeZero(*this); }
+
+  bool get(unsigned i) const {
+    if (i >= MaxTokens)
+      return false;
+    return (bits_[i / WordBits] >> (i % WordBits)) & 0x01;
+  }
+
+  void set(unsigned i) {
+    assert(i < MaxTokens && "Token id out of range.");
+    bits_[i / WordBits] |= 1u << (i % WordBits);
   }
 
-  void set(int i) {
-    unsigned idx = i/sizeof(unsigned);
-    unsigned rem = i - idx*sizeof(unsigned);
-    bits_[idx] |= 0x01 << rem;
+  // Add every token id to the set.
+  void setAll() {
+    for (unsigned i = 0; i < maxSize; ++i) bits_[i] = ~0u;
   }
 
+  // Add the ids in tset to this set.  Returns true if this set changed.
+  bool merge(const TokenSet& tset) {
+    unsigned changed = 0;
+    for (unsigned i = 0; i < maxSize; ++i) {
+      unsigned b = bits_[i] | tset.bits_[i];
+      changed |= b ^ bits_[i];
+      bits_[i] = b;
+    }
+    return changed != 0;
+  }
+
+  // The set is stored as an array of words, which may be saved and
+  // restored with these.
+  static unsigned numWords() { return maxSize; }
+  unsigned word(unsigned i) const { return bits_[i]; }
+  void setWord(unsigned i, unsigned w) { bits_[i] = w; }
+
   static void makeZero(TokenSet& tset) {
     for (unsigned i = 0; i < maxSize; ++i) tset.bits_[i] = 0;
   }
@@ -121,9 +147,10 @@ public:
   }
 
 private:
-  static const unsigned maxSize = 16;
+  static const unsigned WordBits = sizeof(unsigned) * 8;
+  static const unsigned maxSize  = MaxTokens / WordBits;
 
-  unsigned bits_[maxSize];   // 16*32 token types should be enough...
+  unsigned bits_[maxSize];
 };
 
 
@@ -27,6 +27,7 @@
 
 #include "parser/DefaultLexer.h"
 #include "parser/BNFParser.h"
+#include "parser/ParserSnapshot.h"
 #include "parser/TILParser.h"
 #include "til/Global.h"
 #include "til/TIL.h"
@@ -35,7 +36,14 @@
 #include "til/TILTraverse.h"
 
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace ohmu {
 
@@ -48,16 +56,85 @@ public:
   bool initParser(FILE* grammarFile);
   bool initParser(const char* grammarFileName);
 
+  // Initialize the parser from a snapshot of the grammar, which is rebuilt
+  // when the grammar changes.  See ParserSnapshot.
+  bool initParser(const char* grammarFileName, const char* snapshotFileName);
+
   bool parseDefinitions(Global *global, CharStream &stream);
   bool parseDefinitions(Global *global, FILE *file);
   bool parseDefinitions(Global *global, const char* fname);
 
+  // Parse fileNames on up to numThreads threads, or one per core if
+  // numThreads is 0, and add their definitions to global in the order of
+  // the files.  Each thread has its own lexer, parser, and arenas, and
+  // shares the grammar of this driver, which must have been initialized.
+  bool parseFiles(Global *global, const std::vector<std::string> &fileNames,
+                  unsigned numThreads = 0);
+
+  // Parse the definitions in data, and append them to defs.  Definitions
+  // whose text is unchanged since the last call are reused, rather than
+  // parsed again.  Only definitions which are new, or have changed, are
+  // lexed and parsed.  Each definition is allocated in an arena owned by
+  // the driver, and must not be modified.  Only the definitions from the
+  // last call are valid.
+  //
+  // Memory: the driver keeps a copy of the source text, along with the
+  // parsed definitions.  Definitions which are parsed together share an
+  // arena, in groups of up to spansPerRegion, and a group is freed once
+  // none of its definitions are reused.  The overhead is thus one arena
+  // block (4K) per group, but a group may keep up to spansPerRegion-1 stale
+  // definitions alive.
+  bool parseIncremental(const char *data, unsigned size,
+                        std::vector<SExpr*> &defs);
+
+  // As parseIncremental, but add the definitions to global.
+  bool parseIncremental(Global *global, const char *data, unsigned size);
+
+  // Return the number of definitions which the last call to
+  // parseIncremental reused, and parsed.
+  unsigned numReusedDefinitions() const { return numReused; }
+  unsigned numParsedDefinitions() const { return numParsed; }
+
   Driver() : tilParser(&lexer), startRule(nullptr) { }
 
 private:
+  // The text of a top-level definition, and the result of parsing it.
+  // Each span starts where the previous one ends, so it includes the
+  // whitespace and comments before the definition.  The text and the
+  // definition are allocated in region, which is shared with the other
+  // spans in the same group, and freed along with the last of them.
+  struct DefinitionSpan {
+    unsigned  offset;
+    StringRef text;
+    SExpr*    def;
+    std::shared_ptr<MemRegion> region;
+  };
+
+  // The maximum number of definitions which share a region.
+  static const unsigned spansPerRegion = 64;
+
+  bool findStartRule();
+  bool parseDefinitions(Global *global);
+
+  // Parse with parser, and append the definitions to defs.
+  bool parseDefinitions(TILParser &parser, std::vector<SExpr*> &defs);
+
+  // Parse the file fname with lex and parser, and append the definitions to
+  // defs.  The file is mapped into stringArena, and names may point into it.
+  bool parseFile(DefaultLexer &lex, TILParser &parser, const char *fname,
+                 MemRegionRef stringArena, MemRegionRef parseArena,
+                 std::vector<SExpr*> &defs);
+
   DefaultLexer lexer;
   TILParser    tilParser;
   ParseNamedDefinition* startRule;
+  ParseNamedDefinition* slotRule = nullptr;
+
+  // State for parseIncremental.
+  std::vector<DefinitionSpan> spans;
+  unsigned     sourceSize = 0;
+  unsigned     numReused = 0;
+  unsigned     numParsed = 0;
 };
 
 
@@ -66,14 +143,7 @@ bool Driver::initParser(FILE* grammarFile) {
   bool success = BNFParser::initParserFromFile(tilParser, grammarFile, false);
   if (!success)
     return false;
-
-  // Find the starting point.
-  startRule = tilParser.findDefinition("definitions");
-  if (!startRule) {
-    std::cout << "Grammar does not contain rule named 'definitions'.\n";
-    return false;
-  }
-  return true;
+  return findStartRule();
 }
 
 
@@ -90,24 +160,61 @@ bool Driver::initParser(const char* grammarFileName) {
 }
 
 
+bool Driver::initParser(const char* grammarFileName,
+                        const char* snapshotFileName) {
+  bool success = ParserSnapshot::initParser(tilParser, grammarFileName,
+                                            snapshotFileName);
+  if (!success)
+    return false;
+  return findStartRule();
+}
+
+
+bool Driver::findStartRule() {
+  // Find the starting point.
+  startRule = tilParser.findDefinition("definitions");
+  if (!startRule) {
+    std::cout << "Grammar does not contain rule named 'definitions'.\n";
+    return false;
+  }
+  // Individual definitions are parsed incrementally.
+  slotRule = tilParser.findDefinition("slot");
+  return true;
+}
+
+
 
 
 bool Driver::parseDefinitions(Global *global, CharStream &stream) {
-  tilParser.setArenas(global->StringArena, global->ParseArena);
   lexer.setStream(&stream);
-  // tilParser.setTrace(true);
-  ParseResult result = tilParser.parse(startRule);
-  if (tilParser.parseError())
+  return parseDefinitions(global);
+}
+
+
+bool Driver::parseDefinitions(Global *global) {
+  tilParser.setArenas(global->StringArena, global->ParseArena);
+  std::vector<SExpr*> defs;
+  if (!parseDefinitions(tilParser, defs))
     return false;
 
   // Add parsed definitions to global namespace.
+  global->addDefinitions(defs);
+  return true;
+}
+
+
+bool Driver::parseDefinitions(TILParser &parser, std::vector<SExpr*> &defs) {
+  // parser.setTrace(true);
+  ParseResult result = parser.parse(startRule);
+  if (parser.parseError())
+    return false;
+
   auto* v = result.getList<SExpr>(TILParser::TILP_SExpr);
   if (!v) {
     std::cout << "No definitions found.\n";
     return false;
   }
-  global->addDefinitions(*v);
-  delete v;
+  defs.insert(defs.end(), v->begin(), v->end());
   return true;
 }
 
@@ -119,14 +226,175 @@ bool Driver::parseDefinitions(Global *global, FILE *file) {
 
 
 bool Driver::parseDefinitions(Global *global, const char* fname) {
-  FILE* file = fopen(fname, "r");
-  if (!file) {
+  std::vector<SExpr*> defs;
+  if (!parseFile(lexer, tilParser, fname, global->StringArena,
+                 global->ParseArena, defs))
+    return false;
+  global->addDefinitions(defs);
+  return true;
+}
+
+
+bool Driver::parseFile(DefaultLexer &lex, TILParser &parser,
+                       const char *fname, MemRegionRef stringArena,
+                       MemRegionRef parseArena, std::vector<SExpr*> &defs) {
+  // The file stays mapped for the lifetime of stringArena, so names in the
+  // parsed definitions can point directly into it.
+  MappedFileStream file(fname, stringArena);
+  if (!file.isOpen()) {
     std::cout << "File " << fname << " not found.\n";
     return false;
   }
-  bool success = parseDefinitions(global, file);
-  fclose(file);
-  return success;
+  lex.setSource(file.data(), file.size());
+  parser.setArenas(stringArena, parseArena);
+  parser.setKeepSourceStrings(true);
+  return parseDefinitions(parser, defs);
+}
+
+
+inline void deleteParseRegion(void *R) {
+  delete static_cast<MemRegion*>(R);
+}
+
+
+bool Driver::parseFiles(Global *global,
+                        const std::vector<std::string> &fileNames,
+                        unsigned numThreads) {
+  unsigned N = fileNames.size();
+  unsigned numWorkers = numThreads;
+  if (numWorkers == 0)
+    numWorkers = std::thread::hardware_concurrency();
+  numWorkers = std::min(std::max(numWorkers, 1u), N);
+
+  // Files are assigned to threads dynamically, but the definitions of each
+  // file are kept separately, and merged in the order of the files.
+  std::vector<std::vector<SExpr*>> fileDefs(N);
+  std::vector<char> fileOk(N, false);
+  std::atomic<unsigned> next(0);
+
+  auto work = [&](MemRegion *stringRegion, MemRegion *parseRegion) {
+    // The parse rules are only read during parsing, so they are shared.
+    // The keywords of the lexer must have the same token ids as those of
+    // the grammar.
+    DefaultLexer lex;
+    for (unsigned tid = lexer.getKeywordStartID(),
+         last = lexer.getLastTokenID(); tid <= last; ++tid)
+      lex.registerKeyword(lexer.lookupKeywordStr(tid));
+    TILParser parser(&lex);
+    for (unsigned i = next++; i < N; i = next++)
+      fileOk[i] = parseFile(lex, parser, fileNames[i].c_str(),
+                            MemRegionRef(stringRegion),
+                            MemRegionRef(parseRegion), fileDefs[i]);
+  };
+
+  // The regions of each thread live as long as global.
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < numWorkers; ++t) {
+    MemRegion *stringRegion = new MemRegion();
+    MemRegion *parseRegion  = new MemRegion();
+    global->StringArena.addCleanup(&deleteParseRegion, stringRegion);
+    global->ParseArena.addCleanup(&deleteParseRegion, parseRegion);
+    if (t + 1 < numWorkers)
+      workers.emplace_back(work, stringRegion, parseRegion);
+    else
+      work(stringRegion, parseRegion);
+  }
+  for (auto &w : workers)
+    w.join();
+
+  std::vector<SExpr*> defs;
+  for (unsigned i = 0; i < N; ++i) {
+    if (!fileOk[i])
+      return false;
+    defs.insert(defs.end(), fileDefs[i].begin(), fileDefs[i].end());
+  }
+  global->addDefinitions(defs);
+  return true;
+}
+
+
+bool Driver::parseIncremental(const char *data, unsigned size,
+                              std::vector<SExpr*> &defs) {
+  if (!slotRule) {
+    std::cout << "Grammar does not contain rule named 'slot'.\n";
+    return false;
+  }
+
+  // The source may change, so names are copied out of it.
+  tilParser.setKeepSourceStrings(false);
+
+  // The old spans are matched in order.  An edit leaves the spans before
+  // it at the same offset, and those after it at the same distance from
+  // the end of the source, so after parsing a changed definition, the old
+  // spans which it overlaps are skipped.  New definitions are parsed into
+  // group, which is replaced once it holds spansPerRegion of them.
+  std::vector<DefinitionSpan> newSpans;
+  std::shared_ptr<MemRegion> group;
+  unsigned groupSize = 0;
+  int delta = static_cast<int>(size) - static_cast<int>(sourceSize);
+  unsigned pos = 0;
+  unsigned i = 0;
+  numReused = 0;
+  numParsed = 0;
+  while (true) {
+    if (i < spans.size() && spans[i].text.size() <= size - pos &&
+        memcmp(data + pos, spans[i].text.data(), spans[i].text.size()) == 0) {
+      newSpans.push_back(spans[i]);
+      newSpans.back().offset = pos;
+      pos += newSpans.back().text.size();
+      ++i;
+      ++numReused;
+      continue;
+    }
+
+    // Parse the next definition, if any.
+    lexer.setSource(data + pos, size - pos);
+    if (lexer.look().id() == TK_EOF)
+      break;
+    if (!group || groupSize == spansPerRegion) {
+      group = std::make_shared<MemRegion>();
+      groupSize = 0;
+    }
+    tilParser.setArenas(group.get(), group.get());
+    ParseResult result = tilParser.parse(slotRule);
+    if (tilParser.parseError() || lexer.numLookAhead() > 0 ||
+        !result.isSingle(TILParser::TILP_SExpr)) {
+      // The old spans are left intact, so the next call can still reuse them.
+      return false;
+    }
+    unsigned length = lexer.sourceOffset();
+    char *text = group->allocateT<char>(length);
+    memcpy(text, data + pos, length);
+    DefinitionSpan sp = { pos, StringRef(text, length),
+                          result.getNode<SExpr>(TILParser::TILP_SExpr),
+                          group };
+    newSpans.push_back(sp);
+    pos += length;
+    ++groupSize;
+    ++numParsed;
+
+    // Skip the old spans which this definition replaces.
+    while (i < spans.size() &&
+           static_cast<int>(spans[i].offset) + delta < static_cast<int>(pos))
+      ++i;
+  }
+
+  // Groups with no reused spans are freed with newSpans.
+  spans.swap(newSpans);
+  sourceSize = size;
+  for (auto &sp : spans)
+    defs.push_back(sp.def);
+  return true;
+}
+
+
+bool Driver::parseIncremental(Global *global, const char *data,
+                              unsigned size) {
+  std::vector<SExpr*> defs;
+  if (!parseIncremental(data, size, defs))
+    return false;
+  global->addDefinitions(defs);
+  return true;
 }
 
 }  // end namespace ohmu
@@ -99,8 +99,6 @@ int main(int argc, const char** argv) {
     //backend_llvm::generate_LLVM_IR(cfg);
   }
 
-  delete v;
-
   std::cout << "\n";
   return 0;
 }
@@ -0,0 +1,133 @@
+//===- bench_varint.cpp ----------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Compares the speed of decoding variable-length integers one byte at a time
+// with VarInt::decode, over several distributions of values.
+//
+// Usage: bench_varint [num_values]
+//
+//===----------------------------------------------------------------------===//
+
+#include "base/VarInt.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace ohmu;
+
+
+// The original decoder from til/Bytecode.cpp, which branches on every byte.
+inline const uint8_t* decodeByteLoop(const uint8_t *P, const uint8_t *End,
+                              uint64_t *V) {
+  uint64_t R = 0;
+  for (unsigned B = 0; B < 64; B += 7) {
+    uint64_t Byt = *P++;
+    R = R | ((Byt & 0x7Fu) << B);
+    if ((Byt & 0x80) == 0)
+      break;
+  }
+  *V = R;
+  return P;
+}
+
+
+struct ByteLoop {
+  static const uint8_t* decode(const uint8_t *P, const uint8_t *End,
+                               uint64_t *V) {
+    return decodeByteLoop(P, End, V);
+  }
+};
+
+
+// Decode every value in Buf with D::decode, and return the time taken in
+// nanoseconds per value.  Sum is used to check the result.  The decoder is
+// inlined into the loop, as it is in ByteStreamReaderBase.
+template <class D>
+double timeDecode(const std::vector<uint8_t> &Buf, size_t N, uint64_t *Sum) {
+  const int NumRuns = 5;
+  double Best = 0;
+  for (int i = 0; i < NumRuns; ++i) {
+    auto Start = std::chrono::steady_clock::now();
+    const uint8_t *P   = Buf.data();
+    const uint8_t *End = Buf.data() + Buf.size();
+    uint64_t S = 0;
+    for (size_t j = 0; j < N; ++j) {
+      uint64_t V;
+      P = D::decode(P, End, &V);
+      S += V;
+    }
+    auto Stop = std::chrono::steady_clock::now();
+    *Sum = S;
+    double T = std::chrono::duration<double, std::nano>(Stop - Start).count();
+    if (i == 0 || T < Best)
+      Best = T;
+  }
+  return Best / N;
+}
+
+
+void runBenchmark(const char *Name, size_t N,
+                  std::function<uint64_t()> NextValue) {
+  std::vector<uint8_t> Buf;
+  uint8_t Tmp[VarInt::MaxSize];
+  for (size_t i = 0; i < N; ++i) {
+    unsigned L = VarInt::encode(NextValue(), Tmp);
+    Buf.insert(Buf.end(), Tmp, Tmp + L);
+  }
+
+  uint64_t Sum1, Sum2;
+  double T1 = timeDecode<ByteLoop>(Buf, N, &Sum1);
+  double T2 = timeDecode<VarInt>(Buf, N, &Sum2);
+  std::cout << Name << ": " << double(Buf.size()) / N << " bytes/value, "
+            << "byte loop " << T1 << " ns, VarInt " << T2 << " ns"
+            << (Sum1 == Sum2 ? "" : "  MISMATCH") << "\n";
+}
+
+
+int main(int argc, const char** argv) {
+  size_t N = 10000000;
+  if (argc > 1)
+    N = std::atoi(argv[1]);
+
+  uint64_t Seed = 42;
+  auto rand64 = [&]() {
+    Seed = Seed * 6364136223846793005ull + 1442695040888963407ull;
+    return Seed >> 11;
+  };
+
+  // Operand references are mostly small indices of recent instructions.
+  runBenchmark("small ids", N, [&]() { return rand64() % 100; });
+  // Instruction IDs in a large function.
+  runBenchmark("instr ids", N, [&]() { return rand64() % 20000; });
+  // Mostly small, with a long tail of larger values.
+  runBenchmark("skewed", N, [&]() {
+    uint64_t R = rand64();
+    return (R % 100 < 90) ? R % 128 : (R % 100 < 99) ? R % 65536 : R;
+  });
+  // Lengths which vary unpredictably, as when operands of different kinds
+  // are interleaved.
+  runBenchmark("mixed", N, [&]() {
+    uint64_t R = rand64();
+    return R >> (R % 49);
+  });
+  // Stream offsets and sizes.
+  runBenchmark("offsets", N, [&]() { return rand64() % (1ull << 40); });
+  return 0;
+}
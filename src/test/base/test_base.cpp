@@ -22,7 +22,11 @@
 #include "base/LLVMDependencies.h"
 #include "base/MemRegion.h"
 #include "base/ArrayTree.h"
+#include "base/BlockCompressor.h"
+#include "base/VarInt.h"
 
+#include <cstring>
+#include <string>
 #include <vector>
 
 using namespace ohmu;
@@ -116,8 +120,114 @@ void testTreeArray() {
 
 
 
+// Compress and decompress Src, and check that the round trip succeeds.
+// Returns the compressed size.
+size_t roundTrip(const std::vector<uint8_t> &Src) {
+  std::vector<uint8_t> Comp(BlockCompressor::maxCompressedSize(Src.size()));
+  size_t CSize = BlockCompressor::compress(Src.data(), Src.size(),
+                                           Comp.data());
+  if (CSize > Comp.size())
+    error("Error: BlockCompressor overflowed its output.\n");
+
+  std::vector<uint8_t> Dst(Src.size());
+  int64_t DSize = BlockCompressor::decompress(Comp.data(), CSize,
+                                              Dst.data(), Dst.size());
+  if (DSize != static_cast<int64_t>(Src.size()) || Dst != Src)
+    error("Error: BlockCompressor round trip failed.\n");
+
+  // Truncated data must not decompress to the original.
+  if (Src.size() > 0) {
+    DSize = BlockCompressor::decompress(Comp.data(), CSize - 1,
+                                        Dst.data(), Dst.size());
+    if (DSize == static_cast<int64_t>(Src.size()))
+      error("Error: BlockCompressor accepted truncated data.\n");
+  }
+  return CSize;
+}
+
+
+void testBlockCompressor() {
+  std::vector<uint8_t> Data;
+  roundTrip(Data);
+
+  Data.push_back(42);
+  roundTrip(Data);
+
+  // Long runs, which produce overlapping matches.
+  Data.assign(100000, 'a');
+  if (roundTrip(Data) > 1000)
+    error("Error: BlockCompressor did not compress a run.\n");
+
+  // Redundant text.
+  Data.clear();
+  for (unsigned i = 0; i < 5000; ++i) {
+    std::string S = "call function_" + std::to_string(i % 97) + "(x);\n";
+    Data.insert(Data.end(), S.begin(), S.end());
+  }
+  if (roundTrip(Data) > Data.size() / 4)
+    error("Error: BlockCompressor did not compress text.\n");
+
+  // Random data, which cannot be compressed.
+  uint32_t Seed = 12345;
+  Data.resize(70000);
+  for (auto &B : Data) {
+    Seed = Seed * 1103515245 + 12345;
+    B = Seed >> 24;
+  }
+  roundTrip(Data);
+
+  // Matches which are further apart than the maximum offset.
+  std::vector<uint8_t> Far(Data.begin(), Data.begin() + 1000);
+  Data.insert(Data.end(), Far.begin(), Far.end());
+  roundTrip(Data);
+}
+
+
+
+// Encode V, and check that it decodes correctly with and without padding.
+void checkVarInt(uint64_t V) {
+  uint8_t Buf[VarInt::MaxSize + 8];
+  memset(Buf, 0xFF, sizeof(Buf));
+  unsigned N = VarInt::encode(V, Buf);
+
+  uint64_t V1, V2, V3;
+  const uint8_t *E1 = VarInt::decode(Buf, Buf + sizeof(Buf), &V1);
+  const uint8_t *E2 = VarInt::decode(Buf, Buf + N, &V2);
+  const uint8_t *E3 = VarInt::decodeSlow(Buf, Buf + N, &V3);
+  if (V1 != V || V2 != V || V3 != V ||
+      E1 != Buf + N || E2 != Buf + N || E3 != Buf + N)
+    error("Error: VarInt round trip failed.\n");
+}
+
+
+void testVarInt() {
+  for (unsigned B = 0; B < 64; ++B) {
+    uint64_t V = 1ull << B;
+    checkVarInt(V - 1);
+    checkVarInt(V);
+    checkVarInt(V + 1);
+  }
+  checkVarInt(~0ull);
+
+  uint64_t Seed = 12345;
+  for (unsigned i = 0; i < 10000; ++i) {
+    Seed = Seed * 6364136223846793005ull + 1442695040888963407ull;
+    checkVarInt(Seed >> (Seed & 63));
+  }
+
+  // Truncated integers stop at the end of the buffer.
+  uint8_t Buf[4] = { 0x80, 0x80, 0x80, 0x80 };
+  uint64_t V;
+  if (VarInt::decode(Buf, Buf + 4, &V) != Buf + 4)
+    error("Error: VarInt read past the end of the buffer.\n");
+}
+
+
+
 int main(int argc, char** argv) {
   testTreeArray();
+  testBlockCompressor();
+  testVarInt();
   return 0;
 }
 
@@ -4,17 +4,24 @@
 //===----------------------------------------------------------------------===//
 
 #include <iostream>
+#include <memory>
 
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/Support/CommandLine.h"
 #include "lsa/BuildCallGraph.h"
 #include "lsa/GraphSerializer.h"
+#include "til/BytecodeContainer.h"
 
 static llvm::cl::opt<std::string>
     OutputFile("o", llvm::cl::desc("Specify output file"),
                llvm::cl::value_desc("file"), llvm::cl::Optional);
 
+static llvm::cl::opt<std::string>
+    IRFile("ir", llvm::cl::desc("Write the IR of each function to a "
+                                "container as soon as it is translated"),
+           llvm::cl::value_desc("file"), llvm::cl::Optional);
+
 int main(int argc, const char *argv[]) {
 
   clang::tooling::CommonOptionsParser OptParser(argc, argv,
@@ -24,12 +31,22 @@ int main(int argc, const char *argv[]) {
   ohmu::lsa::CallGraphBuilderTool BuilderTool;
   BuilderTool.RegisterMatchers(CallGraphBuilder, &Finder);
 
+  std::unique_ptr<ohmu::til::BytecodeFileWriter> IRStream;
+  std::unique_ptr<ohmu::til::BytecodeContainerWriter> IRContainer;
+  if (IRFile.getNumOccurrences() > 0) {
+    IRStream.reset(new ohmu::til::BytecodeFileWriter(IRFile.getValue()));
+    IRContainer.reset(new ohmu::til::BytecodeContainerWriter(IRStream.get()));
+    CallGraphBuilder.SetIRContainer(IRContainer.get());
+  }
+
   clang::tooling::ClangTool Tool(OptParser.getCompilations(),
                                  OptParser.getSourcePathList());
 
   int Res = Tool.run(clang::tooling::newFrontendActionFactory(&Finder).get());
   if (Res != 0)
     return Res;
+  if (IRContainer)
+    IRContainer->finish();
 
   if (OutputFile.getNumOccurrences() > 0) {
     ohmu::lsa::GraphSerializer::write(OutputFile.getValue(), &CallGraphBuilder);
@@ -0,0 +1,333 @@
+//===- bench_lexer.cpp -----------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures the throughput of DefaultLexer, in MB/s, on a large synthetic
+// ohmu source, both through a CharStream and in place.  Also measures each
+// class of CharScan against the scalar scan on long runs, and checks that
+// the two scans agree on random text at every offset and length.  Finally,
+// measures the cost of looking up the identifiers and operators of the
+// source in the keyword table of the lexer, and in a std::map.
+//
+// Usage: bench_lexer [megabytes]
+//
+//===----------------------------------------------------------------------===//
+
+#include "parser/CharScan.h"
+#include "parser/DefaultLexer.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+
+using namespace ohmu;
+using namespace ohmu::parsing;
+
+
+static const char* keywords[] = {
+  "let", "fun", "if", "then", "else", "return", "struct", "true", "false",
+  "=", "+", "*", "->", "=>", "==", "<", "&&", "||"
+};
+
+
+// Generate about size bytes of ohmu-like source, with a mix of comments,
+// identifiers, keywords, operators, numbers, strings, and characters.
+std::string makeSource(size_t size) {
+  static const char* words[] = {
+    "x", "y", "index", "count", "value", "result", "loopVar", "a_long_name",
+    "Tree", "node_12", "elements", "sum"
+  };
+  const unsigned numWords = sizeof(words) / sizeof(words[0]);
+  const unsigned numKeywords = sizeof(keywords) / sizeof(keywords[0]);
+
+  std::mt19937 rng(42);
+  std::string s;
+  while (s.size() < size) {
+    unsigned r = rng() % 16;
+    if (r == 0) {
+      s += "// Comment describing the next few definitions in some detail.\n";
+      continue;
+    }
+    s += "  ";
+    s += keywords[rng() % numKeywords];
+    s += " ";
+    s += words[rng() % numWords];
+    s += " = ";
+    s += words[rng() % numWords];
+    s += (r < 8) ? " + " : " * ";
+    s += std::to_string(rng() % 100000);
+    if (r % 4 == 0)
+      s += " + 3.14159e+10";
+    if (r % 5 == 0)
+      s += "; print(\"a string of moderate length, with an escape\\n\")";
+    if (r % 7 == 0)
+      s += "; 'c'";
+    s += ";\n";
+  }
+  return s;
+}
+
+
+// Lex source, and return the best time in seconds, or a negative number on
+// failure.  The number of tokens is stored in numTokens.
+double timeLexer(const std::string& source, bool inPlace,
+                 unsigned& numTokens) {
+  const int numRuns = 5;
+  double best = 0;
+  for (int i = 0; i < numRuns; ++i) {
+    DefaultLexer lexer;
+    for (auto* k : keywords)
+      lexer.registerKeyword(k);
+    StringStream stream(source.c_str());
+    if (inPlace)
+      lexer.setSource(source.data(), source.size());
+    else
+      lexer.setStream(&stream);
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned n = 0;
+    while (lexer.look().id() != TK_EOF) {
+      if (lexer.look().id() == TK_Error)
+        return -1;
+      lexer.consume();
+      ++n;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    numTokens = n;
+    double t = std::chrono::duration<double>(end - start).count();
+    if (i == 0 || t < best)
+      best = t;
+  }
+  return best;
+}
+
+
+// Return the best time in seconds to look up each of words with lookup,
+// which returns a token id.  The sum of the ids is stored in sum.
+template <class LookupFn>
+double timeLookup(const std::vector<StringRef>& words, LookupFn lookup,
+                  unsigned& sum) {
+  const int numRuns = 5;
+  double best = 0;
+  for (int i = 0; i < numRuns; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    unsigned s = 0;
+    for (StringRef w : words)
+      s += lookup(w);
+    auto end = std::chrono::steady_clock::now();
+    sum = s;
+    double t = std::chrono::duration<double>(end - start).count();
+    if (i == 0 || t < best)
+      best = t;
+  }
+  return best;
+}
+
+
+// Compare lookups in the keyword table of the lexer with lookups in a
+// std::map from std::string, for every identifier and operator in source.
+bool reportKeywords(const std::string& source) {
+  DefaultLexer lexer;
+  std::map<std::string, unsigned> dict;
+  for (auto* k : keywords)
+    dict[k] = lexer.registerKeyword(k);
+
+  std::vector<StringRef> words;
+  lexer.setSource(source.data(), source.size());
+  while (lexer.look().id() != TK_EOF) {
+    unsigned id = lexer.look().id();
+    if (id == TK_Identifier || id == TK_Operator ||
+        id >= lexer.getKeywordStartID())
+      words.push_back(lexer.look().string());
+    lexer.consume();
+  }
+
+  unsigned sum1 = 0, sum2 = 0;
+  double t1 = timeLookup(words, [&](StringRef w) {
+    return lexer.lookupKeyword(w);
+  }, sum1);
+  double t2 = timeLookup(words, [&](StringRef w) -> unsigned {
+    auto it = dict.find(w.str());
+    return it == dict.end() ? 0 : it->second;
+  }, sum2);
+  if (sum1 != sum2) {
+    std::cerr << "Keyword lookups do not match.\n";
+    return false;
+  }
+
+  double ns = 1e9 / words.size();
+  std::cout << "Keyword lookup (" << words.size() << " words):\n";
+  std::cout << "  table:    " << t1 * ns << " ns/word\n";
+  std::cout << "  std::map: " << t2 * ns << " ns/word\n";
+  return true;
+}
+
+
+// Keeps the scans in timeScan from being optimized away.
+static volatile unsigned scanSink;
+
+
+// Return the best time in seconds to scan the runs of class C in text,
+// with CharScan::scan, or with CharScan::scanScalar if scalar is true.
+template <class C>
+double timeScan(const std::string& text, bool scalar) {
+  const int numRuns = 5;
+  double best = 0;
+  unsigned total = 0;
+  for (int i = 0; i < numRuns; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    const char* p = text.data();
+    unsigned n = text.size();
+    while (n > 0) {
+      unsigned k = scalar ? CharScan::scanScalar<C>(p, n)
+                          : CharScan::scan<C>(p, n);
+      total += k;
+      // Skip the character which ends the run.
+      ++k;
+      if (k > n)
+        k = n;
+      p += k;
+      n -= k;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double t = std::chrono::duration<double>(end - start).count();
+    if (i == 0 || t < best)
+      best = t;
+  }
+  scanSink = total;
+  return best;
+}
+
+
+// Return text of the given size, made of runs of chars of the given
+// average length, separated by stop.
+std::string makeRuns(size_t size, const char* chars, char stop,
+                     unsigned runLength) {
+  std::mt19937 rng(7);
+  std::string s;
+  unsigned numChars = std::char_traits<char>::length(chars);
+  while (s.size() < size) {
+    unsigned len = rng() % (2 * runLength);
+    for (unsigned i = 0; i < len; ++i)
+      s += chars[rng() % numChars];
+    s += stop;
+  }
+  return s;
+}
+
+
+// Check that scan and scanScalar agree on every suffix of every prefix of
+// random text drawn from chars.
+template <class C>
+bool checkScan(const char* name, const char* chars) {
+  std::mt19937 rng(1);
+  unsigned numChars = std::char_traits<char>::length(chars);
+  for (unsigned trial = 0; trial < 200; ++trial) {
+    // Mostly characters in the class, so that runs are long.
+    std::string s;
+    for (unsigned i = 0; i < 100; ++i) {
+      if (rng() % 24 == 0)
+        s += static_cast<char>(rng() % 256);
+      else
+        s += chars[rng() % numChars];
+    }
+    for (unsigned i = 0; i <= s.size(); ++i) {
+      for (unsigned n = 0; i + n <= s.size(); ++n) {
+        // Copy the text, so that reading past the end is caught by ASAN.
+        std::string t = s.substr(i, n);
+        if (CharScan::scan<C>(t.data(), n) !=
+            CharScan::scanScalar<C>(t.data(), n)) {
+          std::cerr << "CharScan::" << name << " differs on \"" << t
+                    << "\"\n";
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+
+static const char* identChars =
+  "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+static const char* textChars =
+  "abcdefghijklmnopqrstuvwxyz ,.;:!?()+-*/=<>[]{}#@0123456789";
+
+
+template <class C>
+void reportScan(const char* name, const char* chars, char stop) {
+  const size_t size = 16 << 20;
+  std::cout << name << ":\n";
+  for (unsigned len : { 4, 16, 64 }) {
+    std::string text = makeRuns(size, chars, stop, len);
+    double tv = timeScan<C>(text, false);
+    double ts = timeScan<C>(text, true);
+    double mb = text.size() / (1024.0 * 1024.0);
+    std::cout << "  runs of " << len << ":\tvector " << mb / tv
+              << " MB/s,\tscalar " << mb / ts << " MB/s\n";
+  }
+}
+
+
+int main(int argc, const char** argv) {
+  unsigned megabytes = 16;
+  if (argc > 1)
+    megabytes = std::atoi(argv[1]);
+
+  bool ok = checkScan<CharScan::Whitespace>("Whitespace", " \t") &&
+            checkScan<CharScan::Digit>("Digit", "0123456789") &&
+            checkScan<CharScan::Identifier>("Identifier", identChars) &&
+            checkScan<CharScan::Comment>("Comment", textChars) &&
+            checkScan<CharScan::String>("String", textChars) &&
+            checkScan<CharScan::Character>("Character", textChars);
+  if (!ok)
+    return -1;
+
+  std::string source = makeSource(size_t(megabytes) << 20);
+  double mb = source.size() / (1024.0 * 1024.0);
+
+  unsigned n1 = 0, n2 = 0;
+  double t1 = timeLexer(source, false, n1);
+  double t2 = timeLexer(source, true, n2);
+  if (t1 < 0 || t2 < 0) {
+    std::cerr << "Lexical error.\n";
+    return -1;
+  }
+  if (n1 != n2) {
+    std::cerr << "Lexers do not produce the same tokens.\n";
+    return -1;
+  }
+
+  std::cout << "Lexed " << mb << " MB, " << n1 << " tokens.\n";
+  std::cout << "Stream:   " << mb / t1 << " MB/s\n";
+  std::cout << "In place: " << mb / t2 << " MB/s\n";
+
+  reportScan<CharScan::Whitespace>("Whitespace", " \t", 'x');
+  reportScan<CharScan::Identifier>("Identifier", identChars, ' ');
+  reportScan<CharScan::Digit>("Digit", "0123456789", ';');
+  reportScan<CharScan::Comment>("Comment", textChars, '\n');
+  reportScan<CharScan::String>("String", textChars, '"');
+
+  if (!reportKeywords(source))
+    return -1;
+  return 0;
+}
@@ -0,0 +1,312 @@
+//===- bench_parser.cpp ----------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures the throughput of the ohmu parser, both interpreted from the
+// grammar, and generated by grammar_compiler.  The source files are
+// concatenated, the result is repeated num_copies times, and the best time
+// to parse it is reported.  The two parsers must produce the same result.
+// Also measures the time to construct the interpreted parser, from the
+// grammar and from a ParserSnapshot, and the generated parser when the
+// lexer reads the source in place rather than through a CharStream.
+// Finally, measures the latency of reparsing the source with
+// Driver::parseIncremental after small edits in the middle of it.
+// With no files, the test programs in src/ohmu are used.  Must be run from
+// the root of the source tree.
+//
+// Usage: bench_parser [num_copies] [file...]
+//
+//===----------------------------------------------------------------------===//
+
+#include "parser/BNFParser.h"
+#include "parser/DefaultLexer.h"
+#include "parser/OhmuParser.h"
+#include "parser/ParserSnapshot.h"
+#include "parser/TILParser.h"
+#include "til/TILCompare.h"
+#include "test/Driver.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace ohmu;
+using namespace ohmu::parsing;
+using namespace ohmu::til;
+
+
+// The test programs which parse with the current grammar.  Parsing stops
+// silently after a block comment, so test_dependent_functions is omitted.
+static const char* defaultFiles[] = {
+  "src/ohmu/test_gvn.ohmu",
+  "src/ohmu/test_inline.ohmu",
+  "src/ohmu/test_loop.ohmu",
+  "src/ohmu/test_specialize.ohmu",
+  "src/ohmu/test_ssa.ohmu"
+};
+
+
+// Parse source with parseFn, which uses parser and lexer, and return the
+// best time in seconds, or a negative number on failure.  The definitions
+// from the last run are stored in defs.  If inPlace is true, the lexer
+// reads source in place, and names are not copied out of it.
+template<class ParseFn>
+double timeParse(TILParser& parser, Lexer& lexer, const std::string& source,
+                 MemRegionRef arena, std::vector<SExpr*>& defs,
+                 ParseFn parseFn, bool inPlace = false) {
+  const int numRuns = 5;
+  double best = 0;
+  for (int i = 0; i < numRuns; ++i) {
+    StringStream stream(source.c_str());
+    parser.setArenas(arena, arena);
+    parser.setKeepSourceStrings(inPlace);
+    if (inPlace)
+      lexer.setSource(source.data(), source.size());
+    else
+      lexer.setStream(&stream);
+    auto start = std::chrono::steady_clock::now();
+    ParseResult result = parseFn();
+    auto end = std::chrono::steady_clock::now();
+    if (parser.parseError())
+      return -1;
+
+    auto* v = result.getList<SExpr>(TILParser::TILP_SExpr);
+    defs.assign(v->begin(), v->end());
+    double t = std::chrono::duration<double>(end - start).count();
+    if (i == 0 || t < best)
+      best = t;
+  }
+  return best;
+}
+
+
+// Return the best time in seconds for driver to reparse edited after
+// parsing source, or a negative number on failure.  The definitions from
+// the last run are stored in defs.
+double timeReparse(Driver& driver, const std::string& source,
+                   const std::string& edited, std::vector<SExpr*>& defs) {
+  const int numRuns = 5;
+  double best = 0;
+  for (int i = 0; i < numRuns; ++i) {
+    std::vector<SExpr*> unused;
+    if (!driver.parseIncremental(source.data(), source.size(), unused))
+      return -1;
+    defs.clear();
+    auto start = std::chrono::steady_clock::now();
+    bool success =
+      driver.parseIncremental(edited.data(), edited.size(), defs);
+    auto end = std::chrono::steady_clock::now();
+    if (!success)
+      return -1;
+    double t = std::chrono::duration<double>(end - start).count();
+    if (i == 0 || t < best)
+      best = t;
+  }
+  return best;
+}
+
+
+// Reparse source with driver after an edit, and report the time.  The
+// result must match a parse of the edited source from scratch.
+bool reportReparse(Driver& driver, TILParser& parser, Lexer& lexer,
+                   ParseNamedDefinition* start, const char* name,
+                   const std::string& source, const std::string& edited) {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  std::vector<SExpr*> expected, defs;
+  double t0 = timeParse(parser, lexer, edited, arena, expected,
+                        [&]() { return parser.parse(start); });
+  double t = timeReparse(driver, source, edited, defs);
+  if (t0 < 0 || t < 0) {
+    std::cerr << "Parse failed.\n";
+    return false;
+  }
+  bool same = defs.size() == expected.size();
+  for (unsigned i = 0; same && i < defs.size(); ++i)
+    same = EqualsComparator::compareExprs(defs[i], expected[i]);
+  if (!same) {
+    std::cerr << "Incremental parse does not match a full parse.\n";
+    return false;
+  }
+  std::cout << "Reparse after " << name << ": " << t * 1000 << " ms ("
+            << driver.numParsedDefinitions() << " parsed, "
+            << driver.numReusedDefinitions() << " reused), full parse: "
+            << t0 * 1000 << " ms\n";
+  return true;
+}
+
+
+// Return the best time in seconds to construct a parser with initFn.
+template<class InitFn>
+double timeInit(InitFn initFn) {
+  const int numRuns = 20;
+  double best = 0;
+  for (int i = 0; i < numRuns; ++i) {
+    DefaultLexer lexer;
+    TILParser parser(&lexer);
+    auto start = std::chrono::steady_clock::now();
+    bool success = initFn(parser);
+    auto end = std::chrono::steady_clock::now();
+    if (!success)
+      return -1;
+    double t = std::chrono::duration<double>(end - start).count();
+    if (i == 0 || t < best)
+      best = t;
+  }
+  return best;
+}
+
+
+int main(int argc, const char** argv) {
+  unsigned numCopies = 1000;
+  if (argc > 1)
+    numCopies = std::atoi(argv[1]);
+
+  std::vector<std::string> files;
+  for (int i = 2; i < argc; ++i)
+    files.push_back(argv[i]);
+  if (files.empty())
+    files.assign(std::begin(defaultFiles), std::end(defaultFiles));
+
+  std::string corpus;
+  for (auto &f : files) {
+    std::ifstream in(f);
+    if (!in) {
+      std::cerr << "File " << f << " not found.\n";
+      return -1;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    corpus += ss.str();
+    corpus += "\n";
+  }
+  std::string source;
+  for (unsigned i = 0; i < numCopies; ++i)
+    source += corpus;
+
+  // The interpreted parser, and the parser generated from the same grammar.
+  DefaultLexer lexer;
+  TILParser interpreted(&lexer);
+  FILE* grammarFile = fopen("src/grammar/ohmu.grammar", "r");
+  if (!grammarFile ||
+      !BNFParser::initParserFromFile(interpreted, grammarFile, false))
+    return -1;
+  fclose(grammarFile);
+  ParseNamedDefinition* start = interpreted.findDefinition("definitions");
+
+  DefaultLexer genLexer;
+  OhmuParser generated(&genLexer);
+  if (!generated.init())
+    return -1;
+
+  // The interpreted parser, restored from a snapshot.
+  std::ifstream grammarIn("src/grammar/ohmu.grammar", std::ios::binary);
+  std::stringstream grammarSS;
+  grammarSS << grammarIn.rdbuf();
+  std::string grammar = grammarSS.str();
+  uint64_t hash = ParserSnapshot::hashGrammar(grammar.data(), grammar.size());
+  std::string snapshot;
+  DefaultLexer snapLexer;
+  TILParser restored(&snapLexer);
+  if (!ParserSnapshot::write(interpreted, hash, snapshot) ||
+      !ParserSnapshot::read(restored, hash, snapshot.data(), snapshot.size()))
+    return -1;
+  ParseNamedDefinition* restoredStart = restored.findDefinition("definitions");
+
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  std::vector<SExpr*> defs1, defs2, defs3, defs4;
+  double t1 = timeParse(interpreted, lexer, source, arena, defs1,
+                        [&]() { return interpreted.parse(start); });
+  double t2 = timeParse(generated, genLexer, source, arena, defs2,
+                        [&]() { return generated.parse_definitions(); });
+  double t3 = timeParse(restored, snapLexer, source, arena, defs3,
+                        [&]() { return restored.parse(restoredStart); });
+  double t4 = timeParse(generated, genLexer, source, arena, defs4,
+                        [&]() { return generated.parse_definitions(); },
+                        true);
+  if (t1 < 0 || t2 < 0 || t3 < 0 || t4 < 0) {
+    std::cerr << "Parse failed.\n";
+    return -1;
+  }
+
+  // All parsers must produce the same definitions.
+  bool same = defs1.size() == defs2.size() && defs1.size() == defs3.size() &&
+              defs1.size() == defs4.size();
+  for (unsigned i = 0; same && i < defs1.size(); ++i)
+    same = EqualsComparator::compareExprs(defs1[i], defs2[i]) &&
+           EqualsComparator::compareExprs(defs1[i], defs3[i]) &&
+           EqualsComparator::compareExprs(defs1[i], defs4[i]);
+  if (!same) {
+    std::cerr << "Parsers do not match the interpreted parser.\n";
+    return -1;
+  }
+
+  double i1 = timeInit([&](TILParser& p) {
+    StringStream stream(grammar.c_str());
+    return BNFParser::initParserFromStream(p, stream);
+  });
+  double i2 = timeInit([&](TILParser& p) {
+    return ParserSnapshot::read(p, hash, snapshot.data(), snapshot.size());
+  });
+  if (i1 < 0 || i2 < 0) {
+    std::cerr << "Parser construction failed.\n";
+    return -1;
+  }
+
+  double mbytes = source.size() / (1024.0 * 1024.0);
+  std::cout << "Parsed " << files.size() << " files x " << numCopies
+            << " copies, " << mbytes << " MB, " << defs1.size()
+            << " definitions.\n";
+  std::cout << "Interpreted parser: " << t1 * 1000 << " ms, "
+            << mbytes / t1 << " MB/s\n";
+  std::cout << "Generated parser: " << t2 * 1000 << " ms, "
+            << mbytes / t2 << " MB/s\n";
+  std::cout << "Restored parser: " << t3 * 1000 << " ms, "
+            << mbytes / t3 << " MB/s\n";
+  std::cout << "Generated parser, in place: " << t4 * 1000 << " ms, "
+            << mbytes / t4 << " MB/s\n";
+  std::cout << "Construct parser from grammar: " << i1 * 1000 << " ms\n";
+  std::cout << "Construct parser from snapshot (" << snapshot.size()
+            << " bytes): " << i2 * 1000 << " ms\n";
+
+  // Edits in the middle of the source.  Copies of the corpus begin with a
+  // definition, so one can be inserted between them.
+  Driver driver;
+  if (!driver.initParser("src/grammar/ohmu.grammar"))
+    return -1;
+  size_t mid = corpus.size() * (numCopies / 2);
+  size_t line = source.find('\n', mid + corpus.size() / 2) + 1;
+  size_t digit = source.find_first_of("0123456789", line);
+  std::string charEdit = source;
+  charEdit[digit] = charEdit[digit] == '9' ? '8' : '9';
+  std::string lineEdit = source;
+  lineEdit.insert(line, "  // An edited line.\n");
+  std::string defEdit = source;
+  defEdit.insert(mid, "edited(a: Int): Int -> a + 1;\n");
+  bool ok =
+    reportReparse(driver, interpreted, lexer, start, "one character",
+                  source, charEdit) &&
+    reportReparse(driver, interpreted, lexer, start, "one line",
+                  source, lineEdit) &&
+    reportReparse(driver, interpreted, lexer, start, "new definition",
+                  source, defEdit);
+  return ok ? 0 : -1;
+}
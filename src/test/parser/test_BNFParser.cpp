@@ -16,10 +16,12 @@
 //===----------------------------------------------------------------------===//
 
 #include <iostream>
+#include <sstream>
 #include <stdio.h>
 
 #include "parser/DefaultLexer.h"
 #include "parser/BNFParser.h"
+#include "parser/ParserSnapshot.h"
 #include "parser/TILParser.h"
 
 using namespace ohmu::parsing;
@@ -61,9 +63,59 @@ int makeTILParser(const char* fname) {
 }
 
 
+// Save the ohmu parser to a snapshot, and check that the restored parser
+// has the same syntax, and that invalid snapshots are rejected.
+int testSnapshot() {
+  const char* fname = "src/grammar/ohmu.grammar";
+
+  ohmu::parsing::DefaultLexer lexer;
+  ohmu::parsing::TILParser myParser(&lexer);
+
+  FILE* file = fopen(fname, "r");
+  if (!file) {
+    std::cout << "File '" << fname << "' not found.\n";
+    return -1;
+  }
+  bool success = BNFParser::initParserFromFile(myParser, file, false);
+  fclose(file);
+  if (!success)
+    return -1;
+
+  std::string snapshot;
+  if (!ParserSnapshot::write(myParser, 1, snapshot)) {
+    std::cout << "Cannot write snapshot.\n";
+    return -1;
+  }
+
+  ohmu::parsing::DefaultLexer lexer2;
+  ohmu::parsing::TILParser restored(&lexer2);
+  if (ParserSnapshot::read(restored, 2, snapshot.data(), snapshot.size()) ||
+      ParserSnapshot::read(restored, 1, snapshot.data(),
+                           snapshot.size() - 1)) {
+    std::cout << "Invalid snapshot was accepted.\n";
+    return -1;
+  }
+  if (restored.findDefinition("definitions") ||
+      !ParserSnapshot::read(restored, 1, snapshot.data(), snapshot.size())) {
+    std::cout << "Cannot read snapshot.\n";
+    return -1;
+  }
+
+  std::ostringstream syntax1, syntax2;
+  myParser.printSyntax(syntax1);
+  restored.printSyntax(syntax2);
+  if (syntax1.str() != syntax2.str() ||
+      lexer.getLastTokenID() != lexer2.getLastTokenID()) {
+    std::cout << "Restored parser does not match.\n";
+    return -1;
+  }
+  return 0;
+}
+
+
 int main(int argc, const char** argv) {
   if (argc <= 1)
-    return bootstrapBNF();
+    return bootstrapBNF() || testSnapshot();
   else
     return makeTILParser(argv[1]);
 }
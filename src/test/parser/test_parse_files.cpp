@@ -0,0 +1,93 @@
+//===- test_parse_files.cpp ------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "base/LLVMDependencies.h"
+
+#include "test/Driver.h"
+
+#include "til/Global.h"
+#include "til/TILCompare.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace ohmu;
+using namespace til;
+
+
+#define CHECK(B)                            \
+  {                                         \
+    bool b_check = B;                       \
+    assert((b_check) && (#B " failed."));   \
+    if (!(b_check))                         \
+      exit(-1);                             \
+  }
+
+
+const char *fileNames[] = {
+  "src/ohmu/test_loop.ohmu",
+  "src/ohmu/test_ssa.ohmu",
+  "src/ohmu/test_gvn.ohmu",
+  "src/ohmu/test_inline.ohmu"
+};
+
+
+std::string printGlobal(Global &G) {
+  std::stringstream SS;
+  G.print(SS);
+  return SS.str();
+}
+
+
+// Parsing several files with parseFiles must give the same definitions, in
+// the same order, as parsing their concatenation, however many threads are
+// used.
+void testParseFiles() {
+  Driver driver;
+  CHECK(driver.initParser("src/grammar/ohmu.grammar"));
+
+  std::vector<std::string> files(std::begin(fileNames), std::end(fileNames));
+  std::string source;
+  for (auto &F : files) {
+    std::ifstream In(F);
+    CHECK(In.good());
+    std::stringstream SS;
+    SS << In.rdbuf();
+    source += SS.str();
+  }
+
+  Global Expected;
+  StringStream S(source.c_str());
+  CHECK(driver.parseDefinitions(&Expected, S));
+  std::string ExpectedText = printGlobal(Expected);
+  CHECK(ExpectedText.size() > 0);
+
+  for (unsigned NumThreads = 1; NumThreads <= files.size(); ++NumThreads) {
+    Global G;
+    CHECK(driver.parseFiles(&G, files, NumThreads));
+    CHECK(EqualsComparator::compareExprs(Expected.global(), G.global()));
+    CHECK(printGlobal(G) == ExpectedText);
+  }
+}
+
+
+int main(int argc, const char** argv) {
+  testParseFiles();
+  std::cout << "Parse files tests passed.\n";
+}
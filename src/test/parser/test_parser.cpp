@@ -17,8 +17,12 @@
 
 #include "test/Driver.h"
 #include "til/Bytecode.h"
+#include "til/GVNPass.h"
+#include "til/Inliner.h"
 #include "til/VisitCFG.h"
 
+#include <chrono>
+
 
 using namespace ohmu;
 using namespace ohmu::parsing;
@@ -30,6 +34,47 @@ void printSExpr(SExpr* e) {
 }
 
 
+// Serialize e, and print the size and decode time of the bytecode, with
+// absolute and relative instruction references.
+void printBytecodeStats(SExpr* e) {
+  static const char* modes[] = {
+    "Absolute instruction refs", "Relative instruction refs",
+    "Relative refs and shared tables"
+  };
+  for (int mode = 0; mode < 3; ++mode) {
+    BytecodeStringWriter writeStream;
+    {
+      BytecodeWriter writer(&writeStream);
+      writer.setRelativeInstrRefs(mode > 0);
+      writer.setStringTable(mode > 1);
+      writer.setSharedSubtrees(mode > 1);
+      writer.write(e);
+    }
+    std::string buffer = writeStream.str();
+
+    const int numRuns = 20;
+    double best = 0;
+    bool ok = true;
+    for (int i = 0; i < numRuns; ++i) {
+      MemRegion    region;
+      MemRegionRef arena(&region);
+      CFGBuilder   builder(arena);
+      auto start = std::chrono::steady_clock::now();
+      InMemoryReader readStream(buffer.data(), buffer.size(), arena);
+      BytecodeReader reader(builder, &readStream);
+      ok = reader.read() && reader.success();
+      auto end = std::chrono::steady_clock::now();
+      double t = std::chrono::duration<double, std::micro>(end - start).count();
+      if (i == 0 || t < best)
+        best = t;
+    }
+    std::cout << modes[mode] << ": " << buffer.size()
+              << " bytes, decoded in " << best << " us"
+              << (ok ? "" : " (failed)") << "\n";
+  }
+}
+
+
 int main(int argc, const char** argv) {
   if (argc == 1) {
     std::cerr << "No file to parse.\n";
@@ -50,21 +95,71 @@ int main(int argc, const char** argv) {
     success = driver.parseDefinitions(&global, IS);
   }
   else {
-    success = driver.parseDefinitions(&global, argv[1]);
+    // Several files are parsed concurrently.
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+      if (strncmp("--", argv[i], 2) != 0)
+        files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+      std::cerr << "No file to parse.\n";
+      return -1;
+    }
+    if (files.size() == 1)
+      success = driver.parseDefinitions(&global, files[0].c_str());
+    else
+      success = driver.parseFiles(&global, files);
   }
   if (!success)
     return -1;
 
+  bool specialize = false;
+  bool inlineCalls = false;
+  bool numberValues = false;
+  bool bytecodeStats = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp("--specialize", argv[i]) == 0)
+      specialize = true;
+    else if (strcmp("--inline", argv[i]) == 0)
+      inlineCalls = true;
+    else if (strcmp("--gvn", argv[i]) == 0)
+      numberValues = true;
+    else if (strcmp("--bytecode", argv[i]) == 0)
+      bytecodeStats = true;
+  }
+
   // Convert high-level AST to low-level IR.
-  global.lower();
-  std::cout << "\n------ Ohmu IR ------\n";
-  global.print(std::cout);
+  global.lower(specialize);
+
+  Inliner inliner(global.DefArena);
+  if (inlineCalls)
+    inliner.inlineCalls(global.global());
 
   // Find all of the CFGs.
   VisitCFG visitCFG;
   visitCFG.traverseAll(global.global());
 
+  GVNPass gvn(global.DefArena);
+  if (numberValues) {
+    for (auto *Cfg : visitCFG.cfgs())
+      gvn.traverseAll(Cfg);
+  }
+
+  std::cout << "\n------ Ohmu IR ------\n";
+  global.print(std::cout);
+
+  if (inlineCalls) {
+    std::cout << "\n";
+    inliner.printStatistics(std::cout);
+  }
+  if (numberValues) {
+    std::cout << "\nGVN removed " << gvn.numInstrsRemoved()
+              << " instructions.\n";
+  }
+
   std::cout << "\n\nNumber of CFGs: " << visitCFG.cfgs().size() << "\n\n";
+
+  if (bytecodeStats)
+    printBytecodeStats(global.global());
   return 0;
 }
-
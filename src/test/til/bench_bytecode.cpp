@@ -0,0 +1,331 @@
+//===- bench_bytecode.cpp --------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures the throughput of writing and reading bytecode from a file,
+// synchronously or on a background thread, with and without compression or
+// shared tables, the time to load a container on several threads, and the
+// effect of relative instruction references.
+//
+// Usage: bench_bytecode [num_slots] [file]
+//
+//===----------------------------------------------------------------------===//
+
+#include "til/Bytecode.h"
+#include "til/BytecodeContainer.h"
+#include "til/CFGBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ohmu;
+using namespace til;
+
+
+// Copy S into the arena.
+StringRef makeName(MemRegionRef A, const std::string &S) {
+  char *Buf = A.allocateT<char>(S.size() + 1);
+  memcpy(Buf, S.c_str(), S.size() + 1);
+  return StringRef(Buf, S.size());
+}
+
+
+// Build a record with N slots, each of which holds a function whose body is
+// a chain of arithmetic over its parameter, mixed with string literals.
+SExpr* makeLargeModule(CFGBuilder &Bld, unsigned N) {
+  auto *SelfVd = Bld.newVarDecl(VarDecl::VK_SFun, "self", nullptr);
+  Bld.enterScope(SelfVd);
+  auto *Self  = Bld.newVariable(SelfVd);
+  auto *IntTy = Bld.newScalarType(BaseType::getBaseType<int>());
+
+  auto *Rec = Bld.newRecord(N);
+  for (unsigned i = 0; i < N; ++i) {
+    std::string Nm = "function_" + std::to_string(i);
+    auto *Vd = Bld.newVarDecl(VarDecl::VK_Fun, "x", IntTy);
+    Bld.enterScope(Vd);
+    SExpr *E = Bld.newVariable(Vd);
+    for (int j = 0; j < 16; ++j) {
+      E = Bld.newBinaryOp(j % 2 ? BOP_Add : BOP_Mul, E,
+                          Bld.newLiteralT<int>(i * 16 + j));
+    }
+    auto *Msg = Bld.newLiteralT<StringRef>(makeName(Bld.arena(),
+                                           "message for " + Nm));
+    auto *Prj = Bld.newProject(Bld.newApply(Self, nullptr, Apply::FAK_SApply),
+                               makeName(Bld.arena(), Nm));
+    auto *Cond = Bld.newBinaryOp(BOP_Eq, E, Bld.newLiteralT<int>(0));
+    auto *Body = Bld.newIfThenElse(Cond, Msg, Bld.newCall(Prj));
+    Bld.exitScope();
+    auto *F = Bld.newFunction(Vd, Bld.newCode(IntTy, Body));
+    Rec->addSlot(Bld.arena(), Bld.newSlot(makeName(Bld.arena(), Nm), F));
+  }
+  Bld.exitScope();
+  return Bld.newFunction(SelfVd, Rec);
+}
+
+
+// Build a record with N slots, each of which holds a function whose body is
+// an SCFG with a single block of M instructions.  Each instruction refers to
+// one of the few instructions before it.
+SExpr* makeCFGModule(CFGBuilder &Bld, unsigned N, unsigned M) {
+  auto *SelfVd = Bld.newVarDecl(VarDecl::VK_SFun, "self", nullptr);
+  Bld.enterScope(SelfVd);
+  auto *IntTy = Bld.newScalarType(BaseType::getBaseType<int>());
+
+  auto *Rec = Bld.newRecord(N);
+  for (unsigned i = 0; i < N; ++i) {
+    auto *Vd = Bld.newVarDecl(VarDecl::VK_Fun, "x", IntTy);
+    Bld.enterScope(Vd);
+    Bld.beginCFG(nullptr);
+    auto *Cfg = Bld.currentCFG();
+    Bld.beginBlock(Cfg->entry());
+
+    std::vector<SExpr*> Vals;
+    Vals.push_back(Bld.newBinaryOp(BOP_Add, Bld.newVariable(Vd),
+                                   Bld.newLiteralT<int>(i)));
+    for (unsigned j = 1; j < M; ++j) {
+      SExpr *A = Vals[j - 1];
+      SExpr *B = Vals[j - 1 - (j * 7) % std::min(j, 4u)];
+      Vals.push_back(Bld.newBinaryOp(j % 2 ? BOP_Add : BOP_Mul, A, B));
+    }
+    Bld.newGoto(Cfg->exit(), Vals.back());
+    Bld.endCFG();
+
+    Bld.exitScope();
+    auto *F = Bld.newFunction(Vd, Bld.newCode(IntTy, Cfg));
+    std::string Nm = "cfg_" + std::to_string(i);
+    Rec->addSlot(Bld.arena(), Bld.newSlot(makeName(Bld.arena(), Nm), F));
+  }
+  Bld.exitScope();
+  return Bld.newFunction(SelfVd, Rec);
+}
+
+
+// Read FileName with a stream of type ReaderT, and return the time taken
+// in seconds, or a negative number on failure.
+template<class ReaderT>
+double timeRead(const char *FileName) {
+  MemRegion    Region;
+  MemRegionRef Arena(&Region);
+  CFGBuilder   Builder(Arena);
+
+  auto Start = std::chrono::steady_clock::now();
+  ReaderT ReadStream(FileName, Arena);
+  BytecodeReader Reader(Builder, &ReadStream);
+  SExpr *E = Reader.read();
+  auto End = std::chrono::steady_clock::now();
+
+  if (!E || !Reader.success())
+    return -1;
+  return std::chrono::duration<double>(End - Start).count();
+}
+
+
+template<class ReaderT>
+void runBenchmark(const char *Name, const char *FileName, double MBytes) {
+  const int NumRuns = 5;
+  double Best = 0;
+  for (int i = 0; i < NumRuns; ++i) {
+    double T = timeRead<ReaderT>(FileName);
+    if (T < 0) {
+      std::cout << Name << ": read failed.\n";
+      return;
+    }
+    if (i == 0 || T < Best)
+      Best = T;
+  }
+  std::cout << Name << ": " << Best * 1000 << " ms, "
+            << MBytes / Best << " MB/s\n";
+}
+
+
+// Read the module in container FileName on NumThreads threads, and return
+// the time taken in seconds, or a negative number on failure.
+double timeContainerRead(const char *FileName, unsigned NumThreads) {
+  MemRegion    Region;
+  MemRegionRef Arena(&Region);
+  CFGBuilder   Builder(Arena);
+
+  auto Start = std::chrono::steady_clock::now();
+  BytecodeContainerReader Reader(FileName, Arena);
+  Reader.setNumThreads(NumThreads);
+  SExpr *E = Reader.readModule(Builder);
+  auto End = std::chrono::steady_clock::now();
+
+  if (!E)
+    return -1;
+  return std::chrono::duration<double>(End - Start).count();
+}
+
+
+void runContainerBenchmark(const char *FileName, unsigned NumThreads) {
+  const int NumRuns = 5;
+  double Best = 0;
+  for (int i = 0; i < NumRuns; ++i) {
+    double T = timeContainerRead(FileName, NumThreads);
+    if (T < 0) {
+      std::cout << "BytecodeContainerReader: read failed.\n";
+      return;
+    }
+    if (i == 0 || T < Best)
+      Best = T;
+  }
+  std::cout << "BytecodeContainerReader (" << NumThreads << " threads): "
+            << Best * 1000 << " ms\n";
+}
+
+
+// Encode Mod and write it to FileName with a stream of type WriterT, and
+// return the time taken in seconds, including the time to close the file.
+template<class WriterT>
+double timeWrite(SExpr *Mod, const char *FileName) {
+  auto Start = std::chrono::steady_clock::now();
+  {
+    WriterT WriteStream(FileName);
+    BytecodeWriter Writer(&WriteStream);
+    Writer.write(Mod);
+  }
+  auto End = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(End - Start).count();
+}
+
+
+template<class WriterT>
+void runWriteBenchmark(const char *Name, SExpr *Mod, const char *FileName,
+                       double MBytes) {
+  const int NumRuns = 5;
+  double Best = 0;
+  for (int i = 0; i < NumRuns; ++i) {
+    double T = timeWrite<WriterT>(Mod, FileName);
+    if (i == 0 || T < Best)
+      Best = T;
+  }
+  std::cout << Name << " (write): " << Best * 1000 << " ms, "
+            << MBytes / Best << " MB/s\n";
+}
+
+
+// Write Mod to FileName, and return the size of the file in MB.
+double writeFile(SExpr *Mod, const std::string &FileName, bool Compress,
+                 bool Relative = false, bool Tables = false) {
+  {
+    BytecodeFileWriter WriteStream(FileName);
+    WriteStream.setCompressed(Compress);
+    BytecodeWriter Writer(&WriteStream);
+    Writer.setRelativeInstrRefs(Relative);
+    Writer.setStringTable(Tables);
+    Writer.setSharedSubtrees(Tables);
+    Writer.write(Mod);
+  }
+  MemRegion Region;
+  MmapBytecodeReader ReadStream(FileName, MemRegionRef(&Region));
+  return ReadStream.fileSize() / (1024.0 * 1024.0);
+}
+
+
+int main(int argc, const char** argv) {
+  unsigned N = 100000;
+  std::string FileName = "bench_bytecode.tmp";
+  if (argc > 1)
+    N = std::atoi(argv[1]);
+  if (argc > 2)
+    FileName = argv[2];
+  std::string LzFileName = FileName + ".lz";
+  std::string ContainerFileName = FileName + ".ohbc";
+  std::string TableFileName = FileName + ".tbl";
+
+  double MBytes, LzMBytes, TblMBytes;
+  {
+    MemRegion    Region;
+    MemRegionRef Arena(&Region);
+    CFGBuilder   Builder(Arena);
+    SExpr *Mod = makeLargeModule(Builder, N);
+    MBytes   = writeFile(Mod, FileName, false);
+    LzMBytes = writeFile(Mod, LzFileName, true);
+    TblMBytes = writeFile(Mod, TableFileName, false, false, true);
+
+    BytecodeFileWriter WriteStream(ContainerFileName);
+    BytecodeContainerWriter Writer(&WriteStream);
+    Writer.writeModule(Mod);
+    Writer.finish();
+
+    // Encoding overlaps with I/O on the background thread.
+    runWriteBenchmark<BytecodeFileWriter>("BytecodeFileWriter", Mod,
+                                          FileName.c_str(), MBytes);
+    runWriteBenchmark<AsyncBytecodeFileWriter>("AsyncBytecodeFileWriter",
+                                               Mod, FileName.c_str(), MBytes);
+  }
+  std::cout << "Wrote " << N << " slots, " << MBytes << " MB; compressed "
+            << LzMBytes << " MB; with shared tables " << TblMBytes
+            << " MB.\n";
+
+  runBenchmark<BytecodeFileReader>("BytecodeFileReader", FileName.c_str(),
+                                   MBytes);
+  runBenchmark<MmapBytecodeReader>("MmapBytecodeReader", FileName.c_str(),
+                                   MBytes);
+  runBenchmark<AsyncBytecodeFileReader>("AsyncBytecodeFileReader",
+                                        FileName.c_str(), MBytes);
+
+  // Throughput is measured in uncompressed bytes.
+  runBenchmark<BytecodeFileReader>("BytecodeFileReader (compressed)",
+                                   LzFileName.c_str(), MBytes);
+  runBenchmark<MmapBytecodeReader>("MmapBytecodeReader (compressed)",
+                                   LzFileName.c_str(), MBytes);
+  runBenchmark<AsyncBytecodeFileReader>("AsyncBytecodeFileReader "
+                                        "(compressed)",
+                                        LzFileName.c_str(), MBytes);
+
+  // Names and types which are repeated are written once.
+  runBenchmark<MmapBytecodeReader>("MmapBytecodeReader (shared tables)",
+                                   TableFileName.c_str(), TblMBytes);
+
+  // Definitions in a container can be decoded in parallel.
+  unsigned NumThreads = std::thread::hardware_concurrency();
+  for (unsigned T = 1; T < NumThreads; T *= 2)
+    runContainerBenchmark(ContainerFileName.c_str(), T);
+  runContainerBenchmark(ContainerFileName.c_str(), NumThreads);
+
+  // Absolute and relative instruction references.
+  double AbsMBytes, RelMBytes;
+  unsigned NumCFGs = std::max(N / 100, 1u);
+  {
+    MemRegion    Region;
+    MemRegionRef Arena(&Region);
+    CFGBuilder   Builder(Arena);
+    SExpr *Mod = makeCFGModule(Builder, NumCFGs, 1000);
+    AbsMBytes = writeFile(Mod, FileName, false, false);
+    RelMBytes = writeFile(Mod, LzFileName, false, true);
+  }
+  std::cout << "Wrote " << NumCFGs << " CFGs, " << AbsMBytes
+            << " MB with absolute instruction refs, " << RelMBytes
+            << " MB with relative instruction refs.\n";
+  runBenchmark<MmapBytecodeReader>("Absolute instruction refs",
+                                   FileName.c_str(), AbsMBytes);
+  runBenchmark<MmapBytecodeReader>("Relative instruction refs",
+                                   LzFileName.c_str(), RelMBytes);
+
+  std::remove(FileName.c_str());
+  std::remove(LzFileName.c_str());
+  std::remove(ContainerFileName.c_str());
+  std::remove(TableFileName.c_str());
+  return 0;
+}
@@ -21,6 +21,7 @@
 
 #include "til/CFGBuilder.h"
 #include "til/CopyReducer.h"
+#include "til/HashReducer.h"
 #include "til/TILPrettyPrint.h"
 #include "til/TILCompare.h"
 
@@ -270,6 +271,17 @@ SExpr *simpleParse(Global &G, const char *inp) {
   return G.global();
 }
 
+// A future which evaluates to a given expression.
+class ConstFuture : public Future {
+public:
+  ConstFuture(SExpr *E) : Res(E) { }
+
+  SExpr* evaluate() override { return Res; }
+
+private:
+  SExpr *Res;
+};
+
 static int tests = 0;
 static int successTests = 0;
 static int failedTests = 0;
@@ -285,6 +297,10 @@ void testEquals(const SExpr *E1, const SExpr *E2, bool exp) {
     TILDebugPrinter::print(E2, std::cout);
     std::cout << std::endl;
     failedTests++;
+  } else if (HashReducer().equals(E1, E2) != exp) {
+    std::cout << "Test failed, hashes are inconsistent with comparison."
+              << std::endl;
+    failedTests++;
   } else {
     successTests++;
   }
@@ -303,6 +319,59 @@ void testEquals(const char *I1, const char *I2, bool exp) {
   testEquals(E1, E2, exp);
 }
 
+// Return the definition of the global slot named Name in E, or null.
+SExpr *findGlobalDef(SExpr *E, StringRef Name) {
+  auto *F = dyn_cast_or_null<Function>(E);
+  auto *R = F ? dyn_cast<Record>(F->body()) : nullptr;
+  Slot *S = R ? R->findSlot(Name) : nullptr;
+  return S ? S->definition() : nullptr;
+}
+
+// Check that MatchComparator compares E1 and E2 as exp.
+void testMatches(const SExpr *E1, const SExpr *E2, bool exp) {
+  tests++;
+  if (MatchComparator::compareExprs(E1, E2) != exp) {
+    std::cout << "Test failed, expected match " << exp << "." << std::endl;
+    failedTests++;
+  } else {
+    successTests++;
+  }
+}
+
+// Hash an expression which contains an unforced future, then force the
+// future; the cached hashes must not be stale.
+void testForcedFuture(CFGBuilder &bld) {
+  auto *Fut = new (bld.arena()) ConstFuture(bld.newLiteralT<int>(1));
+  SExpr *E1 = bld.newBinaryOp(BOP_Add, Fut, bld.newLiteralT<int>(2));
+  SExpr *E2 = simpleComparison(bld, BOP_Add, 1, 2);
+
+  tests++;
+  HashReducer Hr;
+  bool Before = Hr.equals(E1, E2);
+  Fut->force();
+  if (Before || !Hr.equals(E1, E2) ||
+      !EqualsComparator::compareExprs(E1, E2)) {
+    std::cout << "Test failed, hash of forced future." << std::endl;
+    failedTests++;
+  } else {
+    successTests++;
+  }
+}
+
+// Compare the global definitions named Name in I1 and I2.
+void testGlobalEquals(const char *I1, const char *I2, StringRef Name,
+                      bool exp) {
+  Global G1;
+  SExpr *E1 = findGlobalDef(simpleParse(G1, I1), Name);
+  Global G2;
+  SExpr *E2 = findGlobalDef(simpleParse(G2, I2), Name);
+
+  if (!E1 || !E2)
+    return;
+
+  testEquals(E1, E2, exp);
+}
+
 void testCompare() {
   MemRegion    region;
   MemRegionRef arena(&region);
@@ -328,6 +397,25 @@ void testCompare() {
   testEquals(simpleSum(builder), simpleSumLet(builder), true);
   testEquals(envOutsideLet(builder), envInsideLet(builder), true);
 
+  // Shared constants.  Naming a let-bound constant in f must not annotate
+  // the same constant in g.
+  testGlobalEquals("f(a:Int):Int->{let x=1; let y=2+3; let z=5; a+x+y+z+1;};"
+                   "g(a:Int):Int->{a+5+1;};",
+                   "g(a:Int):Int->{a+5+1;};", "g", true);
+
+  // Apply without an argument.  It is a pattern which matches any argument,
+  // but it is only equal to another Apply without an argument.
+  SExpr *App0 = builder.newApply(builder.newLiteralT<int>(1), nullptr);
+  SExpr *App1 = builder.newApply(builder.newLiteralT<int>(1),
+                                 builder.newLiteralT<int>(2));
+  testMatches(App0, App1, true);
+  testMatches(App1, App0, false);
+  testEquals(App0, App1, false);
+  testEquals(App1, App0, false);
+
+  // Futures.
+  testForcedFuture(builder);
+
   // Annotations.
 
   testEquals(testNoAnn(builder), testNoAnn(builder), true);
@@ -344,6 +432,18 @@ void testCompare() {
   // Testing larger AST.
   testEquals(makeModule(builder), makeModule(builder), true);
 
+  // Hash-consing.
+  tests++;
+  ExprTable Table;
+  SExpr *Sum = Table.insert(simpleSum(builder));
+  if (Table.insert(simpleSumLet(builder)) != Sum ||
+      Table.insert(testNoAnn(builder)) == Sum || Table.size() != 2) {
+    std::cout << "Test failed, expression table." << std::endl;
+    failedTests++;
+  } else {
+    successTests++;
+  }
+
   std::cout << "Ran " << tests << " tests. ";
   std::cout << failedTests << " failed, ";
   std::cout << (tests - successTests - failedTests) << " aborted." << std::endl;
@@ -18,12 +18,19 @@
 
 
 #include "til/Bytecode.h"
+#include "til/BytecodeContainer.h"
 #include "til/CFGBuilder.h"
+#include "til/TILCompare.h"
 #include "til/TILPrettyPrint.h"
 
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <memory>
 #include <iostream>
+#include <sstream>
+#include <vector>
 
 using namespace ohmu;
 using namespace til;
@@ -396,8 +403,736 @@ void testSerialization() {
 
 
 
+void testMmapReader() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  const char* FileName = "test_serialization_mmap.tmp";
+  SExpr *e = makeModule(builder);
+  {
+    BytecodeFileWriter writeStream(FileName);
+    BytecodeWriter writer(&writeStream);
+    writer.write(e);
+  }
+
+  BytecodeFileReader fileStream(FileName, arena);
+  BytecodeReader fileReader(builder, &fileStream);
+  SExpr *e1 = fileReader.read();
+  CHECK(e1 && fileReader.success());
+
+  SExpr *e2 = nullptr;
+  {
+    // The mapping must outlive the reader.
+    MmapBytecodeReader mmapStream(FileName, arena);
+    CHECK(mmapStream.isOpen());
+    BytecodeReader mmapReader(builder, &mmapStream);
+    e2 = mmapReader.read();
+    CHECK(e2 && mmapReader.success() && !mmapStream.error());
+  }
+  std::remove(FileName);
+
+  CHECK(EqualsComparator::compareExprs(e1, e2));
+}
+
+
+
+void testContainer() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  SExpr *e = makeModule(builder);
+  std::string buffer;
+  {
+    BytecodeStringWriter writeStream;
+    BytecodeContainerWriter writer(&writeStream);
+    writer.writeModule(e);
+    writer.finish();
+    buffer = writeStream.str();
+  }
+
+  const uint8_t *data = reinterpret_cast<const uint8_t*>(buffer.data());
+  BytecodeContainerReader reader(data, buffer.size(), arena);
+  CHECK(reader.valid());
+  CHECK(reader.isModule());
+  CHECK(reader.numDefinitions() == 2);
+  CHECK(reader.findDefinition("sum2") == 1);
+  CHECK(reader.findDefinition("sum3") == -1);
+
+  // Decode a single definition.
+  auto *slt = dyn_cast_or_null<Slot>(reader.readDefinition(1, builder));
+  CHECK(slt && slt->slotName() == "sum2");
+
+  // Decode a single CFG.
+  auto *rec  = cast<Record>(cast<Function>(e)->body());
+  auto *fun  = cast<Function>(rec->slots()[0]->definition());
+  auto *code = cast<Code>(fun->body());
+  CHECK(reader.numCFGs(0) == 1);
+  CHECK(reader.numCFGs(1) == 0);
+  SCFG *cfg = reader.readCFG(0, 0, builder);
+  CHECK(cfg && cfg->numBlocks() == cast<SCFG>(code->body())->numBlocks());
+
+  // Decode everything.
+  SExpr *e2 = reader.readModule(builder);
+  CHECK(e2 && EqualsComparator::compareExprs(e, e2));
+
+  // Truncated containers are rejected.
+  BytecodeContainerReader reader2(data, buffer.size() - 1, arena);
+  CHECK(!reader2.valid());
+
+  // So are definition counts which do not fit in the index.  The count is
+  // the last byte of the index in an empty container.
+  {
+    BytecodeStringWriter writeStream;
+    BytecodeContainerWriter writer(&writeStream);
+    writer.finish();
+    buffer = writeStream.str();
+  }
+  size_t pos = buffer.size() - BytecodeContainerReader::TrailerSize - 1;
+  CHECK(buffer[pos] == 0);
+  buffer.replace(pos, 1, "\xff\xff\xff\xff\x0f");
+  data = reinterpret_cast<const uint8_t*>(buffer.data());
+  BytecodeContainerReader reader3(data, buffer.size(), arena);
+  CHECK(!reader3.valid());
+}
+
+
+
+SExpr* makeTypedModule(CFGBuilder& bld, unsigned n);
+
+
+// Writes a lazy body header with a given size and number of definitions,
+// followed by Sz bytes of body.
+class LazyHeaderWriter : public BytecodeWriter {
+public:
+  LazyHeaderWriter(ByteStreamWriterBase *W) : BytecodeWriter(W) { }
+
+  void writeHeader(uint64_t Sz, unsigned NumDefs) {
+    writePseudoOpcode(PSOP_LazyBody);
+    getWriter()->writeUInt64(Sz);
+    getWriter()->writeUInt32(NumDefs);
+    getWriter()->endAtom();
+    for (uint64_t i = 0; i < Sz; ++i)
+      getWriter()->writeUInt8(0);
+    getWriter()->endAtom();
+  }
+};
+
+
+// Write e, which forces any futures in it.
+std::string writeExpr(SExpr *e, bool lazy) {
+  BytecodeStringWriter writeStream;
+  BytecodeWriter writer(&writeStream);
+  writer.setLazyBodies(lazy);
+  writer.write(e);
+  return writeStream.str();
+}
+
+
+void testLazyBodies() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  SExpr *e = makeModule(builder);
+  std::string buffer = writeExpr(e, true);
+
+  // Eager readers read lazy bodies inline.
+  {
+    InMemoryReader readStream(buffer.data(), buffer.size(), arena);
+    BytecodeReader reader(builder, &readStream);
+    SExpr *e2 = reader.read();
+    CHECK(e2 && EqualsComparator::compareExprs(e, e2));
+  }
+
+  // Lazy readers, with and without a copy of the data.
+  for (int shared = 0; shared < 2; ++shared) {
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(buffer.data());
+    InMemoryReader copyStream(buffer.data(), buffer.size(), arena);
+    ByteArrayReader sharedStream(data, buffer.size(), arena);
+    ByteStreamReaderBase *readStream = shared ?
+        static_cast<ByteStreamReaderBase*>(&sharedStream) : &copyStream;
+
+    BytecodeReader reader(builder, readStream);
+    reader.setLazyBodies();
+    SExpr *e2 = reader.read();
+    CHECK(e2 && reader.success());
+
+    // Only the outermost body has been seen: \self -> #future
+    LazyBodyStats *stats = reader.lazyStats();
+    CHECK(stats->NumDeferred == 1 && stats->NumDecoded == 0);
+    CHECK(isa<Future>(cast<Function>(e2)->body()));
+
+    // Force everything.
+    writeExpr(e2, false);
+    CHECK(stats->NumDeferred == 6 && stats->NumDecoded == 6);
+    CHECK(EqualsComparator::compareExprs(e, e2));
+  }
+
+  // A corrupted lazy body is decoded as undefined.
+  {
+    std::string bad = buffer;
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(bad.data());
+    ByteArrayReader readStream(data, bad.size(), arena);
+    BytecodeReader reader(builder, &readStream);
+    reader.setLazyBodies();
+    SExpr *e2 = reader.read();
+    CHECK(e2 && reader.success());
+
+    auto *fut = cast<Future>(cast<Function>(e2)->body());
+    std::fill(bad.begin() + bad.size() / 2, bad.end(), '\xff');
+    CHECK(isa<Undefined>(fut->force()));
+  }
+
+  // The size of a truncated lazy body is rejected before reading it.
+  for (int shared = 0; shared < 2; ++shared) {
+    std::string bad = buffer.substr(0, buffer.size() - 8);
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(bad.data());
+    InMemoryReader copyStream(bad.data(), bad.size(), arena);
+    ByteArrayReader sharedStream(data, bad.size(), arena);
+    ByteStreamReaderBase *readStream = shared ?
+        static_cast<ByteStreamReaderBase*>(&sharedStream) : &copyStream;
+
+    BytecodeReader reader(builder, readStream);
+    reader.setLazyBodies();
+    CHECK(reader.read() == nullptr && !reader.success());
+    CHECK(reader.lazyStats()->NumDeferred == 0);
+  }
+
+  // So is a number of shared definitions which cannot fit in the body.
+  {
+    BytecodeStringWriter writeStream;
+    LazyHeaderWriter writer(&writeStream);
+    writer.writeHeader(4, 1000000);
+    writeStream.flush();
+    std::string bad = writeStream.str();
+    InMemoryReader readStream(bad.data(), bad.size(), arena);
+    BytecodeReader reader(builder, &readStream);
+    reader.setLazyBodies();
+    CHECK(reader.read() == nullptr && !reader.success());
+    CHECK(reader.lazyStats()->NumDeferred == 0);
+  }
+
+  // Bodies which are larger than the read buffer are read in pieces.
+  {
+    SExpr *big = makeTypedModule(builder, 4000);
+    std::string bigBuffer = writeExpr(big, true);
+    CHECK(bigBuffer.size() > (1 << 16));
+    InMemoryReader readStream(bigBuffer.data(), bigBuffer.size(), arena);
+    BytecodeReader reader(builder, &readStream);
+    reader.setLazyBodies();
+    SExpr *e2 = reader.read();
+    CHECK(e2 && reader.success());
+    writeExpr(e2, false);
+    CHECK(EqualsComparator::compareExprs(big, e2));
+  }
+
+  // Lazy containers; definitions are only partially decoded.
+  buffer.clear();
+  {
+    BytecodeStringWriter writeStream;
+    BytecodeContainerWriter writer(&writeStream);
+    writer.setLazyBodies(true);
+    writer.writeModule(e);
+    writer.finish();
+    buffer = writeStream.str();
+  }
+  const uint8_t *data = reinterpret_cast<const uint8_t*>(buffer.data());
+  BytecodeContainerReader reader(data, buffer.size(), arena);
+  reader.setLazyBodies(true);
+  CHECK(reader.valid());
+
+  SExpr *e2 = reader.readModule(builder);
+  CHECK(reader.lazyStats()->NumDeferred == 2);
+  CHECK(reader.lazyStats()->numSkipped() == 2);
+  writeExpr(e2, false);
+  CHECK(reader.lazyStats()->NumDecoded == 5);
+  CHECK(EqualsComparator::compareExprs(e, e2));
+
+  // CFG offsets account for the nesting of lazy bodies.
+  CHECK(reader.numCFGs(0) == 1);
+  CHECK(reader.readCFG(0, 0, builder) != nullptr);
+}
+
+
+
+void testCompressedStream() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  // Redundant data, which spans several frames, and a large block.
+  std::vector<uint8_t> block(200000);
+  for (unsigned i = 0; i < block.size(); ++i)
+    block[i] = (i * 7) % 251;
+
+  std::string plain, buffer;
+  for (int compress = 0; compress < 2; ++compress) {
+    BytecodeStringWriter writer;
+    writer.setCompressed(compress);
+    for (unsigned i = 0; i < 20000; ++i) {
+      writer.writeUInt32(i);
+      writer.writeString("function_call");
+    }
+    writer.writeBytes(block.data(), block.size());
+    writer.writeString("Done.");
+    writer.flush();
+    (compress ? buffer : plain) = writer.str();
+  }
+  CHECK(buffer.size() < plain.size() / 4);
+
+  const uint8_t *data = reinterpret_cast<const uint8_t*>(buffer.data());
+  CHECK(ByteStreamReaderBase::isCompressedStream(data, buffer.size()));
+  CHECK(ByteStreamReaderBase::decompressedSize(data, buffer.size()) ==
+        static_cast<int64_t>(plain.size()));
+
+  // Serial and parallel decompression produce the original stream.
+  for (unsigned threads = 1; threads <= 4; threads += 3) {
+    std::vector<uint8_t> out(plain.size());
+    CHECK(ByteStreamReaderBase::decompressStream(data, buffer.size(),
+                                                 out.data(), threads));
+    CHECK(std::string(out.begin(), out.end()) == plain);
+  }
+
+  // Streaming and external readers both detect compression.
+  InMemoryReader copyStream(buffer.data(), buffer.size(), arena);
+  ByteArrayReader sharedStream(data, buffer.size(), arena);
+  for (int shared = 0; shared < 2; ++shared) {
+    ByteStreamReaderBase *reader = shared ?
+        static_cast<ByteStreamReaderBase*>(&sharedStream) : &copyStream;
+    for (unsigned i = 0; i < 20000; ++i) {
+      CHECK(reader->readUInt32() == i);
+      CHECK(reader->readString() == "function_call");
+    }
+    std::vector<uint8_t> block2(block.size());
+    reader->readBytes(block2.data(), block2.size());
+    CHECK(block2 == block);
+    CHECK(reader->readString() == "Done.");
+    CHECK(reader->compressed() && !reader->error() && reader->empty());
+  }
+
+  // Corrupt frames are reported as errors.
+  std::string bad = buffer;
+  bad[bad.size() / 2] ^= 0x55;
+  bad.resize(bad.size() - 1);
+  ByteArrayReader badStream(reinterpret_cast<const uint8_t*>(bad.data()),
+                            bad.size(), arena);
+  CHECK(badStream.error());
+
+  // Expressions, through a file.
+  const char* FileName = "test_serialization_lz.tmp";
+  SExpr *e = makeModule(builder);
+  {
+    BytecodeFileWriter writeStream(FileName);
+    writeStream.setCompressed(true);
+    BytecodeWriter writer(&writeStream);
+    writer.write(e);
+  }
+  {
+    BytecodeFileReader fileStream(FileName, arena);
+    BytecodeReader fileReader(builder, &fileStream);
+    SExpr *e2 = fileReader.read();
+    CHECK(e2 && fileReader.success() && fileStream.compressed());
+    CHECK(EqualsComparator::compareExprs(e, e2));
+
+    MmapBytecodeReader mmapStream(FileName, arena);
+    BytecodeReader mmapReader(builder, &mmapStream);
+    SExpr *e3 = mmapReader.read();
+    CHECK(e3 && mmapReader.success() && mmapStream.compressed());
+    CHECK(EqualsComparator::compareExprs(e, e3));
+  }
+  std::remove(FileName);
+
+  // Compressed containers.
+  {
+    BytecodeStringWriter writeStream;
+    writeStream.setCompressed(true);
+    BytecodeContainerWriter writer(&writeStream);
+    writer.writeModule(e);
+    writer.finish();
+    buffer = writeStream.str();
+  }
+  data = reinterpret_cast<const uint8_t*>(buffer.data());
+  BytecodeContainerReader container(data, buffer.size(), arena);
+  CHECK(container.valid() && container.numDefinitions() == 2);
+  SExpr *e4 = container.readModule(builder);
+  CHECK(e4 && EqualsComparator::compareExprs(e, e4));
+}
+
+
+
+// Build a module with N mutually recursive slots:
+//   f<i>(x) = if (x == 0) then i else self@().f<i+1>(x - 1)
+// Build slot i of makeWideModule, where self_vd is in scope.
+Slot* makeWideSlot(CFGBuilder& bld, VarDecl *self_vd, unsigned i, unsigned n) {
+  auto *self   = bld.newVariable(self_vd);
+  auto *int_ty = bld.newScalarType(BaseType::getBaseType<int>());
+
+  auto makeName = [&](unsigned i) {
+    std::string nm = "f" + std::to_string(i % n);
+    char *buf = bld.arena().allocateT<char>(nm.size() + 1);
+    memcpy(buf, nm.c_str(), nm.size() + 1);
+    return StringRef(buf, nm.size());
+  };
+
+  auto *vd_x = bld.newVarDecl(VarDecl::VK_Fun, "x", int_ty);
+  bld.enterScope(vd_x);
+  auto *x = bld.newVariable(vd_x);
+  auto *cond = bld.newBinaryOp(BOP_Eq, x, bld.newLiteralT<int>(0));
+  auto *x2   = bld.newBinaryOp(BOP_Sub, x, bld.newLiteralT<int>(1));
+  auto *prj  = bld.newProject(bld.newApply(self, nullptr, Apply::FAK_SApply),
+                              makeName(i + 1));
+  auto *call = bld.newCall(bld.newApply(prj, x2));
+  auto *ife  = bld.newIfThenElse(cond, bld.newLiteralT<int>(i), call);
+  bld.exitScope();
+  auto *f = bld.newFunction(vd_x, bld.newCode(int_ty, ife));
+  return bld.newSlot(makeName(i), f);
+}
+
+
+SExpr* makeWideModule(CFGBuilder& bld, unsigned n) {
+  auto *self_vd = bld.newVarDecl(VarDecl::VK_SFun, "self", nullptr);
+  bld.enterScope(self_vd);
+  auto *rec = bld.newRecord(n);
+  for (unsigned i = 0; i < n; ++i)
+    rec->addSlot(bld.arena(), makeWideSlot(bld, self_vd, i, n));
+  bld.exitScope();
+  return bld.newFunction(self_vd, rec);
+}
+
+
+void testParallelContainer() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  const unsigned n = 200;
+  SExpr *e = makeWideModule(builder, n);
+
+  for (int lazy = 0; lazy < 2; ++lazy) {
+    std::string buffer;
+    {
+      BytecodeStringWriter writeStream;
+      BytecodeContainerWriter writer(&writeStream);
+      writer.setLazyBodies(lazy);
+      writer.writeModule(e);
+      writer.finish();
+      buffer = writeStream.str();
+    }
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(buffer.data());
+
+    BytecodeContainerReader serial(data, buffer.size(), arena);
+    serial.setLazyBodies(lazy);
+    SExpr *e1 = serial.readModule(builder);
+    CHECK(e1);
+
+    // Parallel loads give the same result as serial loads, every time.
+    for (unsigned threads = 0; threads <= 8; threads += 4) {
+      MemRegion    region2;
+      MemRegionRef arena2(&region2);
+      CFGBuilder   builder2(arena2);
+
+      BytecodeContainerReader parallel(data, buffer.size(), arena2);
+      parallel.setLazyBodies(lazy);
+      parallel.setNumThreads(threads);
+      SExpr *e2 = parallel.readModule(builder2);
+      CHECK(e2);
+      if (lazy) {
+        CHECK(parallel.lazyStats()->NumDeferred == n);
+        writeExpr(e2, false);
+        CHECK(parallel.lazyStats()->numSkipped() == 0);
+        writeExpr(e1, false);
+      }
+      CHECK(EqualsComparator::compareExprs(e1, e2));
+      CHECK(EqualsComparator::compareExprs(e, e2));
+    }
+  }
+}
+
+
+
+void testStreamingContainer() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  const unsigned n = 50;
+  auto *self_vd = builder.newVarDecl(VarDecl::VK_SFun, "self", nullptr);
+  builder.enterScope(self_vd);
+  builder.exitScope();
+
+  // Build each slot in its own arena, which is freed once it is written.
+  std::string buffer;
+  {
+    BytecodeStringWriter writeStream;
+    BytecodeContainerWriter writer(&writeStream);
+    writer.beginModule(self_vd);
+    for (unsigned i = 0; i < n; ++i) {
+      MemRegion    slotRegion;
+      MemRegionRef slotArena(&slotRegion);
+      CFGBuilder   slotBuilder(slotArena);
+      slotBuilder.enterScope(self_vd);
+      CHECK(writer.addSlot(makeWideSlot(slotBuilder, self_vd, i, n)) == i);
+      slotBuilder.exitScope();
+    }
+    writer.finish();
+    buffer = writeStream.str();
+  }
+
+  const uint8_t *data = reinterpret_cast<const uint8_t*>(buffer.data());
+  BytecodeContainerReader reader(data, buffer.size(), arena);
+  CHECK(reader.valid() && reader.isModule());
+  CHECK(reader.numDefinitions() == n);
+  SExpr *e = makeWideModule(builder, n);
+  SExpr *e2 = reader.readModule(builder);
+  CHECK(e2 && EqualsComparator::compareExprs(e, e2));
+
+  // Definitions of a container without scope can be read by themselves.
+  {
+    BytecodeStringWriter writeStream;
+    BytecodeContainerWriter writer(&writeStream);
+    writer.addDefinition("simple", makeSimple(builder));
+    writer.finish();
+    buffer = writeStream.str();
+  }
+  data = reinterpret_cast<const uint8_t*>(buffer.data());
+  BytecodeContainerReader reader2(data, buffer.size(), arena);
+  int64_t size;
+  const uint8_t *def = reader2.definitionData(0, &size);
+  ByteArrayReader readStream(def, size, arena);
+  BytecodeReader defReader(builder, &readStream);
+  SExpr *e3 = defReader.read();
+  CHECK(e3 && EqualsComparator::compareExprs(makeSimple(builder), e3));
+}
+
+
+
+void testRelativeInstrRefs() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  SExpr* exprs[] = { makeBranch(builder), makeModule(builder) };
+  for (SExpr *e : exprs) {
+    std::string buffers[2];
+    for (int rel = 0; rel < 2; ++rel) {
+      BytecodeStringWriter writeStream;
+      BytecodeWriter writer(&writeStream);
+      writer.setRelativeInstrRefs(rel);
+      writer.write(e);
+      buffers[rel] = writeStream.str();
+
+      InMemoryReader readStream(buffers[rel].data(), buffers[rel].size(),
+                                arena);
+      BytecodeReader reader(builder, &readStream);
+      SExpr *e2 = reader.read();
+      CHECK(e2 && reader.success());
+      CHECK(EqualsComparator::compareExprs(e, e2));
+    }
+    CHECK(buffers[1].size() <= buffers[0].size());
+  }
+}
+
+
+// A module in which every slot has the same parameter and return types.
+SExpr* makeTypedModule(CFGBuilder& bld, unsigned n) {
+  auto *self_vd = bld.newVarDecl(VarDecl::VK_SFun, "self", nullptr);
+  bld.enterScope(self_vd);
+
+  auto *rec = bld.newRecord(n);
+  for (unsigned i = 0; i < n; ++i) {
+    // self.Point, and self.List(self.Point)
+    auto *self1 = bld.newApply(bld.newVariable(self_vd), nullptr,
+                               Apply::FAK_SApply);
+    auto *elem_ty = bld.newProject(self1, "Point");
+    auto *self2 = bld.newApply(bld.newVariable(self_vd), nullptr,
+                               Apply::FAK_SApply);
+    auto *self3 = bld.newApply(bld.newVariable(self_vd), nullptr,
+                               Apply::FAK_SApply);
+    auto *list_ty = bld.newApply(bld.newProject(self2, "List"),
+                                 bld.newProject(self3, "Point"));
+
+    auto *vd = bld.newVarDecl(VarDecl::VK_Fun, "point", elem_ty);
+    bld.enterScope(vd);
+    auto *body = bld.newCode(list_ty, bld.newVariable(vd));
+    bld.exitScope();
+    auto *f = bld.newFunction(vd, body);
+    rec->addSlot(bld.arena(),
+                 bld.newSlot(i % 2 ? "get_point" : "make_list", f));
+  }
+
+  bld.exitScope();
+  return bld.newFunction(self_vd, rec);
+}
+
+
+std::string printExpr(SExpr *e) {
+  std::ostringstream ss;
+  TILDebugPrinter::print(e, ss);
+  return ss.str();
+}
+
+
+void testSharedTables() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  SExpr* exprs[] = { makeModule(builder), makeTypedModule(builder, 20) };
+  for (SExpr *e : exprs) {
+    for (int lazy = 0; lazy < 2; ++lazy) {
+      std::string buffers[2];
+      for (int tables = 0; tables < 2; ++tables) {
+        BytecodeStringWriter writeStream;
+        BytecodeWriter writer(&writeStream);
+        writer.setLazyBodies(lazy);
+        writer.setStringTable(tables);
+        writer.setSharedSubtrees(tables);
+        writer.write(e);
+        buffers[tables] = writeStream.str();
+
+        for (int lazyRead = 0; lazyRead < 2; ++lazyRead) {
+          InMemoryReader readStream(buffers[tables].data(),
+                                    buffers[tables].size(), arena);
+          BytecodeReader reader(builder, &readStream);
+          if (lazyRead)
+            reader.setLazyBodies();
+          SExpr *e2 = reader.read();
+          CHECK(e2 && reader.success());
+          writeExpr(e2, false);   // Force lazy bodies.
+          CHECK(EqualsComparator::compareExprs(e, e2));
+          CHECK(printExpr(e) == printExpr(e2));
+        }
+      }
+      CHECK(buffers[1].size() <= buffers[0].size());
+    }
+  }
+
+  // Repeated types are read back as a single expression.
+  SExpr *e = makeTypedModule(builder, 4);
+  BytecodeStringWriter writeStream;
+  BytecodeWriter writer(&writeStream);
+  writer.setSharedSubtrees(true);
+  writer.write(e);
+  std::string buffer = writeStream.str();
+  InMemoryReader readStream(buffer.data(), buffer.size(), arena);
+  BytecodeReader reader(builder, &readStream);
+  auto *rec = cast<Record>(cast<Function>(reader.read())->body());
+  auto *f0 = cast<Function>(rec->slots()[0]->definition());
+  auto *f1 = cast<Function>(rec->slots()[1]->definition());
+  CHECK(f0->variableDecl()->definition() == f1->variableDecl()->definition());
+  CHECK(cast<Code>(f0->body())->returnType() ==
+        cast<Code>(f1->body())->returnType());
+}
+
+
+void testConstantPool() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  SExpr *e = builder.newLiteralT<int>(7);
+  e->addAnnotation(builder.newAnnotationT<SourceLocAnnot>(10));
+  std::string buffer = writeExpr(e, false);
+
+  // Annotations which are read with a constant pool go on a private copy.
+  ConstantPool pool(arena);
+  CFGBuilder pooled(arena);
+  pooled.switchConstantPool(&pool);
+  InMemoryReader readStream(buffer.data(), buffer.size(), arena);
+  BytecodeReader reader(pooled, &readStream);
+  SExpr *e2 = reader.read();
+  CHECK(e2 && reader.success());
+  CHECK(EqualsComparator::compareExprs(e, e2));
+
+  SExpr *shared = pool.getLiteralT<int>(7);
+  CHECK(e2 != shared && !pool.contains(e2));
+  CHECK(shared->annotations() == nullptr);
+}
+
+
+
+void testAsyncFileStreams() {
+  MemRegion    region;
+  MemRegionRef arena(&region);
+  CFGBuilder   builder(arena);
+
+  // Raw data which spans several blocks, with two and three blocks.
+  const char* FileName = "test_serialization_async.tmp";
+  std::vector<uint8_t> block(3 * AsyncBlockQueue::BlockSize + 12345);
+  for (unsigned i = 0; i < block.size(); ++i)
+    block[i] = (i * 13) % 253;
+  for (unsigned n = 2; n <= 3; ++n) {
+    {
+      AsyncBytecodeFileWriter writeStream(FileName, n);
+      writeStream.writeString("Start.");
+      writeStream.writeBytes(block.data(), block.size());
+      writeStream.writeUInt32(1234567890);
+      writeStream.close();
+      CHECK(!writeStream.error());
+    }
+    AsyncBytecodeFileReader readStream(FileName, arena, n);
+    CHECK(readStream.readString() == "Start.");
+    std::vector<uint8_t> block2(block.size());
+    readStream.readBytes(block2.data(), block2.size());
+    CHECK(block2 == block);
+    CHECK(readStream.readUInt32() == 1234567890);
+    CHECK(!readStream.error() && readStream.empty());
+  }
+
+  // A reader which is destroyed before the end of the file.
+  {
+    AsyncBytecodeFileReader readStream(FileName, arena);
+    CHECK(readStream.readString() == "Start.");
+  }
+
+  // Expressions, plain and compressed, are compatible with the synchronous
+  // streams.
+  SExpr *e = makeWideModule(builder, 2000);
+  for (int compress = 0; compress < 2; ++compress) {
+    {
+      AsyncBytecodeFileWriter writeStream(FileName);
+      writeStream.setCompressed(compress);
+      BytecodeWriter writer(&writeStream);
+      writer.write(e);
+    }
+    BytecodeFileReader fileStream(FileName, arena);
+    BytecodeReader fileReader(builder, &fileStream);
+    SExpr *e1 = fileReader.read();
+    CHECK(e1 && fileReader.success());
+    CHECK(EqualsComparator::compareExprs(e, e1));
+
+    AsyncBytecodeFileReader asyncStream(FileName, arena);
+    BytecodeReader asyncReader(builder, &asyncStream);
+    SExpr *e2 = asyncReader.read();
+    CHECK(e2 && asyncReader.success());
+    CHECK(asyncStream.compressed() == static_cast<bool>(compress));
+    CHECK(EqualsComparator::compareExprs(e, e2));
+  }
+  std::remove(FileName);
+
+  // Missing files are reported as errors.
+  AsyncBytecodeFileWriter badWriter("no_such_dir/test.tmp");
+  CHECK(badWriter.error());
+  AsyncBytecodeFileReader badReader("no_such_file.tmp", arena);
+  CHECK(badReader.empty());
+}
+
+
+
 int main(int argc, const char** argv) {
   testByteStream();
   testSerialization();
+  testMmapReader();
+  testContainer();
+  testLazyBodies();
+  testCompressedStream();
+  testParallelContainer();
+  testStreamingContainer();
+  testRelativeInstrRefs();
+  testSharedTables();
+  testConstantPool();
+  testAsyncFileStreams();
 }
 
@@ -0,0 +1,138 @@
+//===- test_specialize.cpp -------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "base/LLVMDependencies.h"
+
+#include "test/Driver.h"
+
+#include "til/Global.h"
+#include "til/TypedEvaluator.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace ohmu;
+using namespace til;
+
+
+#define CHECK(B)                            \
+  {                                         \
+    bool b_check = B;                       \
+    assert((b_check) && (#B " failed."));   \
+    if (!(b_check))                         \
+      exit(-1);                             \
+  }
+
+
+const char *source =
+  "scale(k: Int): Int -> {\n"
+  "  if (k < 0) then 0 - k\n"
+  "  else k * 2;\n"
+  "};\n"
+  "test(a: Int): Int -> {\n"
+  "  let b = scale(3)();\n"
+  "  let c = scale(3)();\n"
+  "  let d = scale(-4)();\n"
+  "  b + c + d + a;\n"
+  "};\n";
+
+
+// Return the definition of the slot named Name in the global record E.
+SExpr *findDefinition(SExpr *E, StringRef Name) {
+  auto *F = dyn_cast_or_null<Function>(E);
+  auto *R = F ? dyn_cast<Record>(F->body()) : nullptr;
+  Slot *S = R ? R->findSlot(Name) : nullptr;
+  return S ? S->definition() : nullptr;
+}
+
+
+// Return the literal which the code block C returns, or null if C does not
+// return a constant.
+Literal *returnedLiteral(SExpr *C) {
+  auto *Cd  = dyn_cast_or_null<Code>(C);
+  auto *Cfg = Cd ? dyn_cast<SCFG>(Cd->body()) : nullptr;
+  if (!Cfg || Cfg->exit()->arguments().size() != 1)
+    return nullptr;
+  Phi *Ph = Cfg->exit()->arguments()[0];
+  if (!Ph || Ph->values().size() != 1)
+    return nullptr;
+  return dyn_cast_or_null<Literal>(Ph->values()[0].get());
+}
+
+
+// Return the name of the slot called by the instruction named Name in the
+// function F, or the empty string if there is no such call.
+StringRef calledSlot(SExpr *F, StringRef Name) {
+  while (auto *Fn = dyn_cast_or_null<Function>(F))
+    F = Fn->body();
+  auto *Cd  = dyn_cast_or_null<Code>(F);
+  auto *Cfg = Cd ? dyn_cast<SCFG>(Cd->body()) : nullptr;
+  if (!Cfg)
+    return StringRef("", 0);
+  for (auto &B : Cfg->blocks()) {
+    for (auto *I : B->instructions()) {
+      if (!I || I->instrName() != Name)
+        continue;
+      auto *Cl = dyn_cast<Call>(I);
+      SExpr *Target = Cl ? Cl->target() : nullptr;
+      while (auto *Ap = dyn_cast_or_null<Apply>(Target))
+        Target = Ap->fun();
+      if (auto *P = dyn_cast_or_null<Project>(Target))
+        return P->slotName();
+    }
+  }
+  return StringRef("", 0);
+}
+
+
+void testSpecialize() {
+  Driver driver;
+  CHECK(driver.initParser("src/grammar/ohmu.grammar"));
+
+  Global G;
+  StringStream S(source);
+  CHECK(driver.parseDefinitions(&G, S));
+
+  TypedEvaluator Eval(G.DefArena);
+  Eval.setSpecializeCalls(true);
+  Eval.setConstantPool(&G.Constants);
+  SExpr *E = Eval.traverseAll(G.global());
+
+  // The specialized slots exist, and fold to literals.  The argument -4 is
+  // a unary operation on a literal, which is folded before the call.
+  Literal *L1 = returnedLiteral(findDefinition(E, "scale$1"));
+  CHECK(L1 && L1->baseType() == BaseType::getBaseType<int32_t>());
+  CHECK(L1->as<int32_t>()->value() == 6);
+
+  Literal *L2 = returnedLiteral(findDefinition(E, "scale$2"));
+  CHECK(L2 && L2->baseType() == BaseType::getBaseType<int32_t>());
+  CHECK(L2->as<int32_t>()->value() == 4);
+
+  // The second call to scale(3) reuses the first specialization.
+  SExpr *T = findDefinition(E, "test");
+  CHECK(calledSlot(T, "b") == "scale$1");
+  CHECK(calledSlot(T, "c") == "scale$1");
+  CHECK(calledSlot(T, "d") == "scale$2");
+  CHECK(Eval.specializer().numSpecializations() == 2);
+  CHECK(Eval.specializer().numCacheHits() == 1);
+}
+
+
+int main(int argc, const char** argv) {
+  testSpecialize();
+  std::cout << "Specialization tests passed.\n";
+}
@@ -9,39 +9,309 @@
 
 
 #include "Bytecode.h"
+#include "TILVisitor.h"
+#include "base/BlockCompressor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace ohmu {
 namespace til {
 
 
+namespace {
+
+void writeLE32(uint8_t *P, uint32_t V) {
+  P[0] = V & 0xFF;
+  P[1] = (V >> 8)  & 0xFF;
+  P[2] = (V >> 16) & 0xFF;
+  P[3] = (V >> 24) & 0xFF;
+}
+
+uint32_t readLE32(const uint8_t *P) {
+  return P[0] | (P[1] << 8) | (P[2] << 16) |
+         (static_cast<uint32_t>(P[3]) << 24);
+}
+
+// Decode a frame header.  Returns the size of the frame data, or -1 if the
+// header is malformed.
+int64_t readFrameHeader(const uint8_t *P, uint32_t *RawSize, bool *Stored) {
+  *RawSize = readLE32(P);
+  uint32_t CSize = readLE32(P + 4);
+  *Stored = CSize & BytecodeBase::FrameStored;
+  CSize &= ~BytecodeBase::FrameStored;
+  if (*Stored && CSize != *RawSize)
+    return -1;
+  return CSize;
+}
+
+// Decode the data of a frame, which has been read from a header.
+bool decodeFrame(const uint8_t *Src, int64_t Size, bool Stored,
+                 uint8_t *Dst, uint32_t RawSize) {
+  if (Stored) {
+    memcpy(Dst, Src, RawSize);
+    return true;
+  }
+  return BlockCompressor::decompress(Src, Size, Dst, RawSize) == RawSize;
+}
+
+}  // end anonymous namespace
+
+
 void ByteStreamWriterBase::flush() {
-  if (Pos > 0)
-    writeData(Buffer.data(), Pos);
+  if (Pos > 0) {
+    if (Compressed)
+      writeFrame(Buffer.data(), Pos);
+    else
+      writeData(Buffer.data(), Pos);
+  }
+  Flushed += Pos;
   Pos = 0;
 }
 
 
+void ByteStreamWriterBase::setCompressed(bool B) {
+  assert(position() == 0 && "Cannot compress a stream after writing.");
+  if (B == Compressed)
+    return;
+  Compressed = B;
+  if (B) {
+    // The magic is not part of the uncompressed stream, so we don't count it.
+    uint8_t Magic[4];
+    writeLE32(Magic, BytecodeBase::CompressedMagic);
+    writeData(Magic, 4);
+  }
+}
+
+
+void ByteStreamWriterBase::writeFrame(const uint8_t *D, int64_t Size) {
+  size_t MaxSize = BlockCompressor::maxCompressedSize(BufferSize);
+  if (FrameBuffer.size() < BytecodeBase::FrameHeaderSize + MaxSize)
+    FrameBuffer.resize(BytecodeBase::FrameHeaderSize + MaxSize);
+
+  uint8_t *Out = FrameBuffer.data() + BytecodeBase::FrameHeaderSize;
+  int64_t CSize = BlockCompressor::compress(D, Size, Out);
+  uint32_t CWord = CSize;
+  if (CSize >= Size) {
+    // Incompressible data is stored as is.
+    memcpy(Out, D, Size);
+    CSize = Size;
+    CWord = Size | BytecodeBase::FrameStored;
+  }
+  writeLE32(FrameBuffer.data(), Size);
+  writeLE32(FrameBuffer.data() + 4, CWord);
+  writeData(FrameBuffer.data(), BytecodeBase::FrameHeaderSize + CSize);
+}
+
+
 void ByteStreamReaderBase::refill() {
   if (Eof)
     return;
 
+  if (Buffer.empty()) {
+    Buffer.resize(BufferSize);
+    Data = Buffer.data();
+  }
+
   if (Pos > 0) {  // Move remaining contents to start of buffer.
     assert(Pos > length() && "Cannot refill a nearly full buffer.");
 
-    int len = length();
+    int64_t len = length();
     if (len > 0)
       memcpy(Buffer.data(), Buffer.data() + Pos, len);
     Pos = 0;
     BufferLen = len;
   }
 
-  int read = readData(Buffer.data() + BufferLen, BufferSize - BufferLen);
+  int64_t read = readRaw(Buffer.data() + BufferLen, BufferSize - BufferLen);
   BufferLen += read;
   if (BufferLen < BufferSize)
     Eof = true;
 }
 
 
+void ByteStreamReaderBase::setExternalData(const uint8_t *D, int64_t Size,
+                                           bool SharedStr) {
+  Pos = 0;
+  Eof = true;      // Nothing more to read, so refill() is a no-op.
+  Detected = true;
+
+  if (isCompressedStream(D, Size)) {
+    // Decompress everything up front, so that frames can be done in parallel.
+    Compressed = true;
+    int64_t Len = decompressedSize(D, Size);
+    Buffer.resize(Len > 0 ? Len : 0);
+    if (Len < 0 || !decompressStream(D, Size, Buffer.data())) {
+      Error = true;
+      Len = 0;
+    }
+    Data = Buffer.data();
+    BufferLen = Len;
+    SharedStrings = false;
+    return;
+  }
+
+  Data = D;
+  BufferLen = Size;
+  SharedStrings = SharedStr;
+  std::vector<uint8_t>().swap(Buffer);
+}
+
+
+int64_t ByteStreamReaderBase::readRaw(void *Buf, int64_t Size) {
+  uint8_t *Dest = static_cast<uint8_t*>(Buf);
+  int64_t Total = 0;
+
+  if (!Detected) {
+    Detected = true;
+    uint8_t Magic[4];
+    int64_t L = readData(Magic, 4);
+    if (L == 4 && readLE32(Magic) == BytecodeBase::CompressedMagic) {
+      Compressed = true;
+    }
+    else {
+      // Not compressed, so pass the bytes through.
+      assert(Size >= 4 && "First read is too small.");
+      memcpy(Dest, Magic, L);
+      if (L < 4)
+        return L;
+      Total = L;
+    }
+  }
+
+  if (!Compressed)
+    return Total + readData(Dest + Total, Size - Total);
+
+  while (Total < Size) {
+    if (FramePos == static_cast<int64_t>(Frame.size()) && !readFrame())
+      break;
+    int64_t L = std::min(Size - Total,
+                         static_cast<int64_t>(Frame.size()) - FramePos);
+    memcpy(Dest + Total, Frame.data() + FramePos, L);
+    FramePos += L;
+    Total += L;
+  }
+  return Total;
+}
+
+
+bool ByteStreamReaderBase::readFrame() {
+  uint8_t Header[BytecodeBase::FrameHeaderSize];
+  int64_t L = readData(Header, BytecodeBase::FrameHeaderSize);
+  Frame.clear();
+  FramePos = 0;
+  if (L == 0)
+    return false;    // End of stream.
+
+  uint32_t RawSize = 0;
+  bool Stored = false;
+  int64_t CSize = -1;
+  if (L == BytecodeBase::FrameHeaderSize)
+    CSize = readFrameHeader(Header, &RawSize, &Stored);
+  int64_t MaxSize = BlockCompressor::maxCompressedSize(RawSize);
+  if (CSize < 0 || RawSize > BufferSize || CSize > MaxSize) {
+    Error = true;
+    return false;
+  }
+
+  FrameIn.resize(CSize);
+  Frame.resize(RawSize);
+  if (readData(FrameIn.data(), CSize) != CSize ||
+      !decodeFrame(FrameIn.data(), CSize, Stored, Frame.data(), RawSize)) {
+    Frame.clear();
+    Error = true;
+    return false;
+  }
+  return true;
+}
+
+
+bool ByteStreamReaderBase::isCompressedStream(const uint8_t *D, int64_t Size) {
+  return Size >= 4 && readLE32(D) == BytecodeBase::CompressedMagic;
+}
+
+
+int64_t ByteStreamReaderBase::decompressedSize(const uint8_t *D, int64_t Size) {
+  if (!isCompressedStream(D, Size))
+    return -1;
+  int64_t Total = 0;
+  int64_t P = 4;
+  while (P < Size) {
+    if (Size - P < BytecodeBase::FrameHeaderSize)
+      return -1;
+    uint32_t RawSize;
+    bool Stored;
+    int64_t CSize = readFrameHeader(D + P, &RawSize, &Stored);
+    P += BytecodeBase::FrameHeaderSize;
+    if (CSize < 0 || CSize > Size - P)
+      return -1;
+    P += CSize;
+    Total += RawSize;
+  }
+  return Total;
+}
+
+
+bool ByteStreamReaderBase::decompressStream(const uint8_t *D, int64_t Size,
+                                            uint8_t *Out,
+                                            unsigned NumThreads) {
+  struct FrameInfo {
+    const uint8_t *Src;
+    int64_t  Size;
+    bool     Stored;
+    uint8_t  *Dst;
+    uint32_t RawSize;
+  };
+
+  // Find the frames.  The headers have been validated by decompressedSize.
+  std::vector<FrameInfo> Frames;
+  int64_t P = 4;
+  int64_t OutPos = 0;
+  while (P + BytecodeBase::FrameHeaderSize <= Size) {
+    FrameInfo F;
+    F.Size = readFrameHeader(D + P, &F.RawSize, &F.Stored);
+    if (F.Size < 0)
+      return false;
+    P += BytecodeBase::FrameHeaderSize;
+    F.Src = D + P;
+    F.Dst = Out + OutPos;
+    P += F.Size;
+    OutPos += F.RawSize;
+    Frames.push_back(F);
+  }
+
+  std::atomic<size_t> Next(0);
+  std::atomic<bool>   Ok(true);
+  auto Work = [&]() {
+    for (size_t i = Next++; i < Frames.size(); i = Next++) {
+      FrameInfo &F = Frames[i];
+      if (!decodeFrame(F.Src, F.Size, F.Stored, F.Dst, F.RawSize))
+        Ok = false;
+    }
+  };
+
+  if (NumThreads == 0)
+    NumThreads = std::thread::hardware_concurrency();
+  unsigned NumWorkers = std::min<size_t>(NumThreads, Frames.size());
+
+  std::vector<std::thread> Workers;
+  for (unsigned i = 1; i < NumWorkers; ++i)
+    Workers.emplace_back(Work);
+  Work();
+  for (auto &T : Workers)
+    T.join();
+  return Ok;
+}
+
+
 void ByteStreamWriterBase::endAtom() {
   if (length() <= BytecodeBase::MaxAtomSize)
     flush();
@@ -57,7 +327,16 @@ void ByteStreamReaderBase::endAtom() {
 void ByteStreamWriterBase::writeBytes(const void *Data, int64_t Size) {
   if (Size >= (BufferSize >> 1)) {   // Don't buffer large writes.
     flush();                  // Flush current data to disk.
-    writeData(Data, Size);    // Directly write the bytes to disk.
+    if (Compressed) {
+      // Frames must fit in the reader's buffer.
+      const uint8_t *P = static_cast<const uint8_t*>(Data);
+      for (int64_t i = 0; i < Size; i += BufferSize)
+        writeFrame(P + i, std::min<int64_t>(BufferSize, Size - i));
+    }
+    else {
+      writeData(Data, Size);  // Directly write the bytes to disk.
+    }
+    Flushed += Size;
     return;
   }
   // Flush buffer if the write would fill it up.
@@ -70,19 +349,20 @@ void ByteStreamWriterBase::writeBytes(const void *Data, int64_t Size) {
 }
 
 
-void ByteStreamReaderBase::readBytes(void *Data, int64_t Size) {
-  int len = length();
+void ByteStreamReaderBase::readBytes(void *Dest, int64_t Size) {
+  int64_t len = length();
   if (Size > len) {
-    memcpy(Data, Buffer.data() + Pos, len);   // Copy out current buffer.
+    memcpy(Dest, Data + Pos, len);   // Copy out current buffer.
+    Pos += len;
     Size = Size - len;
-    Data = reinterpret_cast<char*>(Data) + len;
+    Dest = reinterpret_cast<char*>(Dest) + len;
 
     if (Size >= (BufferSize >> 1)) {   // Don't buffer large reads.
       if (Eof) {
         Error = true;
         return;
       }
-      int64_t L = readData(Data, Size);   // Read more data.
+      int64_t L = readRaw(Dest, Size);    // Read more data.
       if (L < Size)
         Eof = true;
       refill();                        // Refill buffer
@@ -97,7 +377,7 @@ void ByteStreamReaderBase::readBytes(void *Data, int64_t Size) {
   }
 
   // Size < length() at this point.
-  memcpy(Data, Buffer.data() + Pos, Size);
+  memcpy(Dest, Data + Pos, Size);
   Pos += Size;
   if (length() < BytecodeBase::MaxAtomSize)
     refill();
@@ -127,7 +407,7 @@ uint32_t ByteStreamReaderBase::readBits32(int Nbits) {
   uint32_t V = 0;
   int B = 0;
   while (true) {
-    uint32_t Byt = Buffer[Pos++];
+    uint32_t Byt = Data[Pos++];
     V = V | (Byt << B);
     B += 8;
     if (B >= Nbits)
@@ -142,7 +422,7 @@ uint64_t ByteStreamReaderBase::readBits64(int Nbits) {
   uint64_t V = 0;
   int B = 0;
   while (true) {
-    uint64_t Byt = Buffer[Pos++];
+    uint64_t Byt = Data[Pos++];
     V = V | (Byt << B);
     B += 8;
     if (B >= Nbits)
@@ -152,60 +432,6 @@ uint64_t ByteStreamReaderBase::readBits64(int Nbits) {
 }
 
 
-void ByteStreamWriterBase::writeUInt32_Vbr(uint32_t V) {
-  if (V == 0) {
-    Buffer[Pos++] = 0;
-    return;
-  }
-  while (V > 0) {
-    uint32_t V2 = V >> 7;
-    uint8_t Hibit = (V2 == 0) ? 0 : 0x80;
-    // Write lower 7 bits.  The 8th bit is high if there's more to write.
-    Buffer[Pos++] = static_cast<uint8_t>((V & 0x7F) | Hibit);
-    V = V2;
-  }
-}
-
-
-void ByteStreamWriterBase::writeUInt64_Vbr(uint64_t V) {
-  if (V == 0) {
-    Buffer[Pos++] = 0;
-    return;
-  }
-  while (V > 0) {
-    uint64_t V2 = V >> 7;
-    uint8_t Hibit = (V2 == 0) ? 0 : 0x80;
-    // Write lower 7 bits.  The 8th bit is high if there's more to write.
-    Buffer[Pos++] = static_cast<uint8_t>((V & 0x7Fu) | Hibit);
-    V = V2;
-  }
-}
-
-
-uint32_t ByteStreamReaderBase::readUInt32_Vbr() {
-  uint32_t V = 0;
-  for (unsigned B = 0; B < 32; B += 7) {
-    uint32_t Byt = Buffer[Pos++];
-    V = V | ((Byt & 0x7Fu) << B);
-    if ((Byt & 0x80) == 0)
-      break;
-  }
-  return V;
-}
-
-
-uint64_t ByteStreamReaderBase::readUInt64_Vbr() {
-  uint64_t V = 0;
-  for (unsigned B = 0; B < 64; B += 7) {
-    uint64_t Byt = Buffer[Pos++];
-    V = V | ((Byt & 0x7Fu) << B);
-    if ((Byt & 0x80) == 0)
-      break;
-  }
-  return V;
-}
-
-
 void ByteStreamWriterBase::writeFloat(float f) {
   // TODO: works only on machines which use in-memory IEEE format.
   union { float Fnum; uint32_t Inum; } U;
@@ -244,8 +470,31 @@ void ByteStreamWriterBase::writeString(StringRef S) {
 }
 
 
+const uint8_t* ByteStreamReaderBase::readSharedBytes(int64_t Size) {
+  if (!SharedStrings || Size > length())
+    return nullptr;
+  const uint8_t *P = Data + Pos;
+  Pos += Size;
+  return P;
+}
+
+
 StringRef ByteStreamReaderBase::readString() {
-  uint32_t Sz = readUInt32();
+  return readString(readUInt32());
+}
+
+
+StringRef ByteStreamReaderBase::readString(uint32_t Sz) {
+  if (SharedStrings) {
+    if (Sz > length()) {
+      Error = true;
+      return StringRef(nullptr, 0);
+    }
+    const char* S = reinterpret_cast<const char*>(Data + Pos);
+    Pos += Sz;
+    return StringRef(S, Sz);
+  }
+
   char* S = allocStringData(Sz);
   if (!S) {
     Error = true;
@@ -291,10 +540,14 @@ BasicBlock *BytecodeReader::getBlock(int Bid, int Nargs) {
 
 void BytecodeWriter::enterScope(VarDecl *Vd) {
   writePseudoOpcode(PSOP_EnterScope);
+  if (CFGIndex)
+    ScopeVars.push_back(Vd);
 }
 
 void BytecodeWriter::exitScope(VarDecl *Vd) {
   writePseudoOpcode(PSOP_ExitScope);
+  if (CFGIndex)
+    ScopeVars.pop_back();
 }
 
 void BytecodeReader::enterScope() {
@@ -310,12 +563,21 @@ void BytecodeReader::exitScope() {
   Vars.pop_back();
 }
 
+void BytecodeReader::addScope(VarDecl *Vd) {
+  if (Vars.size() != Vd->varIndex()) {
+    fail("Invalid variable declaration.");
+    return;
+  }
+  Vars.push_back(Vd);
+}
+
 
 void BytecodeWriter::enterBlock(BasicBlock *B) {
   writePseudoOpcode(PSOP_EnterBlock);
   Writer->writeUInt32(B->blockID());
   Writer->writeUInt32(B->firstInstrID());
   Writer->writeUInt32(B->numArguments());
+  CurrentInstrID = B->firstInstrID() + B->numArguments();
 }
 
 void BytecodeReader::enterBlock() {
@@ -337,6 +599,15 @@ void BytecodeReader::enterBlock() {
 
 
 void BytecodeWriter::enterCFG(SCFG *Cfg) {
+  ++CFGDepth;
+  if (CFGIndex) {
+    OpenCFGs.push_back(CFGIndex->size());
+    CFGIndex->push_back(CFGLocation());
+    CFGLocation &Loc = CFGIndex->back();
+    Loc.Offset = Writer->position();
+    Loc.Size   = 0;
+    Loc.Scope  = ScopeVars;
+  }
   writePseudoOpcode(PSOP_EnterCFG);
   Writer->writeUInt32(Cfg->numBlocks());
   Writer->writeUInt32(Cfg->numInstructions());
@@ -358,6 +629,428 @@ void BytecodeReader::enterCFG() {
 }
 
 
+void BytecodeWriter::traverseFunction(Function *E) {
+  if (!LazyBodies || CFGDepth > 0) {
+    SuperTv::traverseFunction(E);
+    return;
+  }
+  traverse(E->variableDecl(), TRV_Decl);
+  enterScope(E->variableDecl());
+  writeLazyBody(E->body());
+  exitScope(E->variableDecl());
+  reduceFunction(E);
+}
+
+
+void BytecodeWriter::traverseCode(Code *E) {
+  if (!LazyBodies || CFGDepth > 0) {
+    SuperTv::traverseCode(E);
+    return;
+  }
+  traverseArg(E->returnType(), TRV_Type);
+  writeLazyBody(E->body());
+  reduceCode(E);
+}
+
+
+void BytecodeWriter::writeLazyBody(SExpr *E) {
+  // Write the body to a separate buffer, so that we know its size.
+  if (LazyDepth == LazyWriters.size())
+    LazyWriters.emplace_back(new BytecodeBufferWriter());
+  BytecodeBufferWriter *Sub = LazyWriters[LazyDepth].get();
+  Sub->clear();
+
+  unsigned FirstCFG = CFGIndex ? CFGIndex->size() : 0;
+  unsigned FirstShared = NumShared;
+  unsigned FirstKey    = SharedKeys.size();
+  ByteStreamWriterBase *Outer = Writer;
+  Writer = Sub;
+  ++LazyDepth;
+  traverseArg(E, TRV_Lazy);
+  Sub->flush();
+  --LazyDepth;
+  Writer = Outer;
+
+  // Shared definitions in the body are not visible outside of it, because
+  // the reader may skip the body.  They keep their indices, so the reader
+  // must be told how many there are, including those in nested bodies.
+  unsigned NumDefs = NumShared - FirstShared;
+  for (unsigned i = FirstKey, n = SharedKeys.size(); i < n; ++i)
+    SharedIndex.erase(SharedKeys[i]);
+  SharedKeys.resize(FirstKey);
+
+  writePseudoOpcode(PSOP_LazyBody);
+  Writer->writeUInt64(Sub->size());
+  Writer->writeUInt32(NumDefs);
+  Writer->endAtom();
+
+  // CFGs in the body were recorded relative to the start of the body.
+  int64_t Start = Writer->position();
+  if (CFGIndex) {
+    for (unsigned i = FirstCFG, n = CFGIndex->size(); i < n; ++i)
+      (*CFGIndex)[i].Offset += Start;
+  }
+  Writer->writeBytes(Sub->data(), Sub->size());
+}
+
+
+/// A future which decodes a body that was skipped by a lazy reader.
+class LazyBodyFuture : public Future {
+public:
+  LazyBodyFuture(const uint8_t *D, int64_t Sz, VarDecl **Vs, unsigned Nv,
+                 SExpr **Sh, unsigned Ns, StringRef *Strs, unsigned NStrs,
+                 MemRegionRef A, ConstantPool *P, LazyBodyStats *S)
+      : Data(D), Size(Sz), Vars(Vs), NumVars(Nv), Shared(Sh), NumShared(Ns),
+        Strings(Strs), NumStrings(NStrs), Arena(A), Constants(P), Stats(S) { }
+
+  virtual SExpr* evaluate() override {
+    ByteArrayReader ReadStream(Data, Size, Arena);
+    CFGBuilder Builder(Arena);
+    Builder.switchConstantPool(Constants);
+    BytecodeReader Reader(Builder, &ReadStream);
+    Reader.setLazyBodies(Stats);
+    Reader.setStringTable(Strings, NumStrings);
+    for (unsigned i = 0; i < NumVars; ++i)
+      Reader.addScope(Vars[i]);
+    for (unsigned i = 0; i < NumShared; ++i)
+      Reader.addShared(Shared[i]);
+    SExpr *E = Reader.read();
+    ++Stats->NumDecoded;
+    // The reader has already reported the error.
+    if (!E || !Reader.success())
+      return Builder.newUndefined();
+    return E;
+  }
+
+private:
+  const uint8_t *Data;
+  int64_t        Size;
+  VarDecl      **Vars;      // Variables in scope.
+  unsigned       NumVars;
+  SExpr        **Shared;    // Shared definitions which precede the body.
+  unsigned       NumShared;
+  StringRef     *Strings;
+  unsigned       NumStrings;
+  MemRegionRef   Arena;
+  ConstantPool  *Constants;
+  LazyBodyStats *Stats;
+};
+
+
+void BytecodeReader::setLazyBodies(LazyBodyStats *Stats) {
+  if (!Stats)
+    Stats = new (Builder.arena()) LazyBodyStats();
+  LazyStats = Stats;
+}
+
+
+void BytecodeReader::readLazyBody() {
+  uint64_t Sz = Reader->readUInt64();
+  unsigned NumDefs = Reader->readUInt32();
+  if (!LazyStats)
+    return;   // The body follows inline, and is read as usual.
+
+  // The size comes from the stream, so check it before allocating.
+  int64_t Left = Reader->remaining();
+  if (static_cast<int64_t>(Sz) < 0 ||
+      (Left >= 0 && static_cast<int64_t>(Sz) > Left)) {
+    fail("Invalid lazy body size.");
+    return;
+  }
+  // Each definition in the body takes at least one byte.
+  if (NumDefs > Sz) {
+    fail("Invalid number of shared definitions.");
+    return;
+  }
+
+  // Keep the body, rather than decoding it.
+  const uint8_t *D = Reader->readSharedBytes(Sz);
+  if (!D && Left >= 0) {
+    uint8_t *Buf = Builder.arena().allocateT<uint8_t>(Sz);
+    Reader->readBytes(Buf, Sz);
+    D = Buf;
+  }
+  else if (!D) {
+    // The end of the stream is not known, so read the body in pieces;
+    // a bad size fails at the end of the stream rather than allocating.
+    static const uint64_t ChunkSize = 1 << 20;
+    std::vector<uint8_t> Tmp;
+    while (Tmp.size() < Sz && !Reader->error()) {
+      size_t N = Tmp.size();
+      Tmp.resize(N + std::min(Sz - N, ChunkSize));
+      Reader->readBytes(Tmp.data() + N, Tmp.size() - N);
+    }
+    if (!Reader->error()) {
+      uint8_t *Buf = Builder.arena().allocateT<uint8_t>(Sz);
+      std::copy(Tmp.begin(), Tmp.end(), Buf);
+      D = Buf;
+    }
+  }
+  if (Reader->error()) {
+    fail("Invalid lazy body size.");
+    return;
+  }
+
+  // Vars[0] is a placeholder.
+  unsigned Nv = Vars.size() - 1;
+  VarDecl **Vs = Builder.arena().allocateT<VarDecl*>(Nv);
+  for (unsigned i = 0; i < Nv; ++i)
+    Vs[i] = Vars[i + 1];
+
+  unsigned Ns = Shared.size();
+  SExpr **Sh = nullptr;
+  if (Ns > 0) {
+    Sh = Builder.arena().allocateT<SExpr*>(Ns);
+    std::copy(Shared.begin(), Shared.end(), Sh);
+  }
+  // Definitions in the body can only be referred to from within the body.
+  Shared.resize(Ns + NumDefs, nullptr);
+
+  auto *F = new (Builder.arena()) LazyBodyFuture(D, Sz, Vs, Nv, Sh, Ns,
+      Strings, NumStrings, Builder.arena(), Builder.constantPool(),
+      LazyStats);
+  ++LazyStats->NumDeferred;
+  push(F);
+}
+
+
+namespace {
+
+// Append a key for E to Key.  Two expressions have the same key if they have
+// the same shape, names, and variables, so one can be substituted for the
+// other.  Returns false if E cannot be shared.
+bool appendSubtreeKey(const SExpr *E, std::string &Key) {
+  static const size_t MaxKeySize = 256;
+
+  if (!E) {
+    Key.push_back(0);
+    return true;
+  }
+  if (E->annotations() || E->asCFGInstruction() || Key.size() > MaxKeySize)
+    return false;
+
+  Key.push_back(static_cast<char>(E->opcode()));
+  switch (E->opcode()) {
+    case COP_ScalarType: {
+      BaseType Bt = cast<ScalarType>(E)->baseType();
+      uint16_t V = Bt.asUInt16();
+      Key.append(reinterpret_cast<const char*>(&V), sizeof(V));
+      return true;
+    }
+    case COP_Variable: {
+      // Variables are compared by identity, so a shared expression always
+      // refers to the same declaration.
+      const VarDecl *Vd = cast<Variable>(E)->variableDecl();
+      Key.append(reinterpret_cast<const char*>(&Vd), sizeof(Vd));
+      return true;
+    }
+    case COP_Project: {
+      auto *P = cast<Project>(E);
+      uint32_t Sz = P->slotName().size();
+      Key.append(reinterpret_cast<const char*>(&Sz), sizeof(Sz));
+      Key.append(P->slotName().data(), Sz);
+      return appendSubtreeKey(P->record(), Key);
+    }
+    case COP_Apply: {
+      auto *A = cast<Apply>(E);
+      Key.push_back(static_cast<char>(A->applyKind()));
+      return appendSubtreeKey(A->fun(), Key) &&
+             appendSubtreeKey(A->arg(), Key);
+    }
+    case COP_Identifier: {
+      StringRef S = cast<Identifier>(E)->idString();
+      uint32_t Sz = S.size();
+      Key.append(reinterpret_cast<const char*>(&Sz), sizeof(Sz));
+      Key.append(S.data(), Sz);
+      return true;
+    }
+    case COP_Wildcard:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+// Return the key of E in Key, if E is worth sharing.  A back-reference
+// takes at least two bytes, so single nodes are not shared.
+bool getSubtreeKey(const SExpr *E, std::string &Key) {
+  if (E->opcode() != COP_Project && E->opcode() != COP_Apply)
+    return false;
+  Key.clear();
+  return appendSubtreeKey(E, Key);
+}
+
+
+// Counts the names and shareable subexpressions in an expression.
+class BytecodeTableCounter : public Visitor<BytecodeTableCounter> {
+public:
+  typedef Visitor<BytecodeTableCounter> SuperV;
+
+  BytecodeTableCounter(bool Strs, bool Subtrees)
+      : CountStrings(Strs), CountSubtrees(Subtrees), CFGDepth(0) { }
+
+  template <class T>
+  void traverse(T *E, TraversalKind K) {
+    if (CountStrings)
+      countName(E);
+    if (CountSubtrees && CFGDepth == 0 && getSubtreeKey(E, Key))
+      ++SubtreeUses[Key];
+    SuperV::traverse(E, K);
+  }
+
+  void enterCFG(SCFG *Cfg) { ++CFGDepth; }
+  void exitCFG (SCFG *Cfg) { --CFGDepth; }
+
+  void countName(SExpr *E) {
+    switch (E->opcode()) {
+      case COP_VarDecl:    countName(cast<VarDecl>(E)->varName());     break;
+      case COP_Slot:       countName(cast<Slot>(E)->slotName());       break;
+      case COP_Project:    countName(cast<Project>(E)->slotName());    break;
+      case COP_Identifier: countName(cast<Identifier>(E)->idString()); break;
+      case COP_Literal: {
+        auto *L = cast<Literal>(E);
+        if (L->baseType().Base == BaseType::BT_String)
+          countName(L->as<StringRef>()->value());
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  void countName(StringRef S) {
+    auto &N = NameUses[std::string(S.data(), S.size())];
+    if (N++ == 0)
+      Names.push_back(S);
+  }
+
+  bool CountStrings;
+  bool CountSubtrees;
+  unsigned CFGDepth;
+  std::string Key;
+
+  std::vector<StringRef> Names;   // In order of first use.
+  std::unordered_map<std::string, unsigned> NameUses;
+  std::unordered_map<std::string, unsigned> SubtreeUses;
+};
+
+}  // end anonymous namespace
+
+
+void BytecodeWriter::writeTables(SExpr *E) {
+  BytecodeTableCounter Counter(StringTable, SharedSubtrees);
+  Counter.traverseAll(E);
+  SubtreeUses = std::move(Counter.SubtreeUses);
+
+  // Names which are used once are written inline.  The most frequent names
+  // come first, so that their indices are short.
+  std::vector<std::pair<unsigned, StringRef>> Repeated;
+  for (StringRef S : Counter.Names) {
+    unsigned N = Counter.NameUses[std::string(S.data(), S.size())];
+    if (N > 1)
+      Repeated.push_back(std::make_pair(N, S));
+  }
+  if (Repeated.empty())
+    return;
+  std::stable_sort(Repeated.begin(), Repeated.end(),
+    [](const std::pair<unsigned, StringRef> &A,
+       const std::pair<unsigned, StringRef> &B) { return A.first > B.first; });
+
+  writePseudoOpcode(PSOP_StringTable);
+  Writer->writeUInt32(Repeated.size());
+  Writer->endAtom();
+  for (unsigned i = 0, n = Repeated.size(); i < n; ++i) {
+    StringRef S = Repeated[i].second;
+    StringIndex[std::string(S.data(), S.size())] = i;
+    Writer->writeString(S);
+    Writer->endAtom();
+  }
+}
+
+void BytecodeReader::readStringTable() {
+  unsigned N = Reader->readUInt32();
+  Reader->endAtom();
+  Strings = Builder.arena().allocateT<StringRef>(N);
+  for (unsigned i = 0; i < N && !Reader->error(); ++i) {
+    new (&Strings[i]) StringRef(Reader->readString());
+    Reader->endAtom();
+  }
+  NumStrings = N;
+  if (Reader->error())
+    fail("Invalid string table.");
+}
+
+
+void BytecodeWriter::writeName(StringRef S) {
+  if (StringIndex.empty()) {
+    Writer->writeString(S);
+    return;
+  }
+  // A value less than the size of the table is an index.  Other names are
+  // written inline, with the size of the table added to their length.
+  auto It = StringIndex.find(std::string(S.data(), S.size()));
+  if (It != StringIndex.end()) {
+    Writer->writeUInt32(It->second);
+    return;
+  }
+  Writer->writeUInt32(StringIndex.size() + S.size());
+  Writer->writeBytes(S.data(), S.size());
+}
+
+StringRef BytecodeReader::readName() {
+  if (!Strings)
+    return Reader->readString();
+  unsigned i = Reader->readUInt32();
+  if (i < NumStrings)
+    return Strings[i];
+
+  return Reader->readString(i - NumStrings);
+}
+
+
+bool BytecodeWriter::writeSharedRef(SExpr *E, bool *Define) {
+  std::string Key;
+  if (CFGDepth > 0 || !getSubtreeKey(E, Key))
+    return false;
+  auto It = SharedIndex.find(Key);
+  if (It == SharedIndex.end()) {
+    *Define = SubtreeUses[Key] > 1;
+    return false;
+  }
+  writePseudoOpcode(PSOP_SharedRef);
+  Writer->writeUInt32(It->second);
+  Writer->endAtom();
+  return true;
+}
+
+void BytecodeWriter::writeSharedDef(SExpr *E) {
+  std::string Key;
+  getSubtreeKey(E, Key);
+  SharedIndex[Key] = NumShared++;
+  SharedKeys.push_back(std::move(Key));
+  writePseudoOpcode(PSOP_SharedDef);
+  Writer->endAtom();
+}
+
+void BytecodeReader::readSharedDef() {
+  if (Stack.empty()) {
+    fail("Internal error: corrupted stack.");
+    return;
+  }
+  Shared.push_back(arg(0));
+}
+
+void BytecodeReader::readSharedRef() {
+  unsigned i = Reader->readUInt32();
+  if (i >= Shared.size() || !Shared[i]) {
+    fail("Invalid shared expression.");
+    return;
+  }
+  push(Shared[i]);
+}
+
+
 void BytecodeWriter::reduceBasicBlock(BasicBlock *E) {
   writeOpcode(COP_BasicBlock);
 }
@@ -375,6 +1068,15 @@ void BytecodeWriter::reduceSCFG(SCFG *E) {
   writeOpcode(COP_SCFG);
 }
 
+void BytecodeWriter::exitCFG(SCFG *Cfg) {
+  --CFGDepth;
+  if (CFGIndex) {
+    CFGLocation &Loc = (*CFGIndex)[OpenCFGs.back()];
+    Loc.Size = Writer->position() - Loc.Offset;
+    OpenCFGs.pop_back();
+  }
+}
+
 
 void BytecodeReader::readSCFG() {
   assert(Stack.size() == CFGStackSize && "Internal error.");
@@ -413,8 +1115,15 @@ void BytecodeReader::readNull() {
 
 
 void BytecodeWriter::reduceWeak(Instruction *I) {
-  writePseudoOpcode(PSOP_WeakInstrRef);
-  Writer->writeUInt32(I->instrID());
+  if (!RelativeRefs) {
+    writePseudoOpcode(PSOP_WeakInstrRef);
+    Writer->writeUInt32(I->instrID());
+    return;
+  }
+  // Phi arguments may refer forward, so the distance is zigzag encoded.
+  int32_t D = static_cast<int32_t>(CurrentInstrID - I->instrID());
+  writePseudoOpcode(PSOP_RelInstrRef);
+  Writer->writeUInt32((static_cast<uint32_t>(D) << 1) ^ (D >> 31));
 }
 
 void BytecodeReader::readWeak() {
@@ -426,6 +1135,17 @@ void BytecodeReader::readWeak() {
   push(Instrs[i]);
 }
 
+void BytecodeReader::readRelWeak() {
+  uint32_t Z = Reader->readUInt32();
+  int32_t  D = static_cast<int32_t>(Z >> 1) ^ -static_cast<int32_t>(Z & 1);
+  unsigned i = CurrentInstrID - static_cast<unsigned>(D);
+  if (i >= Instrs.size()) {
+    fail("Invalid instruction ID.");
+    return;
+  }
+  push(Instrs[i]);
+}
+
 
 void BytecodeWriter::reduceBBArgument(Phi *E) {
   writePseudoOpcode(PSOP_BBArgument);
@@ -439,6 +1159,7 @@ void BytecodeReader::readBBArgument() {
 
 void BytecodeWriter::reduceBBInstruction(Instruction *E) {
   writePseudoOpcode(PSOP_BBInstruction);
+  ++CurrentInstrID;
 }
 
 void BytecodeReader::readBBInstruction() {
@@ -460,13 +1181,13 @@ void BytecodeWriter::reduceVarDecl(VarDecl* E) {
   writeOpcode(COP_VarDecl);
   writeFlag(E->kind());
   Writer->writeUInt32(E->varIndex());
-  Writer->writeString(E->varName());
+  writeName(E->varName());
 }
 
 void BytecodeReader::readVarDecl() {
   auto K = readFlag<VarDecl::VariableKind>();
   unsigned Id = Reader->readUInt32();
-  StringRef Nm = Reader->readString();
+  StringRef Nm = readName();
   auto *E = Builder.newVarDecl(K, Nm, arg(0));  // TODO: enter Scope?
   E->setVarIndex(Id);
   drop(1);
@@ -513,12 +1234,12 @@ void BytecodeReader::readField() {
 void BytecodeWriter::reduceSlot(Slot *E) {
   writeOpcode(COP_Slot);
   Writer->writeUInt16(E->modifiers());
-  Writer->writeString(E->slotName());
+  writeName(E->slotName());
 }
 
 void BytecodeReader::readSlot() {
   uint16_t Mods = Reader->readUInt16();
-  StringRef S = Reader->readString();
+  StringRef S = readName();
   auto *E = Builder.newSlot(S, arg(0));
   E->setModifiers(Mods);
   drop(1);
@@ -634,11 +1355,11 @@ void BytecodeReader::readApply() {
 
 void BytecodeWriter::reduceProject(Project *E) {
   writeOpcode(COP_Project);
-  Writer->writeString(E->slotName());
+  writeName(E->slotName());
 }
 
 void BytecodeReader::readProject() {
-  StringRef Nm = Reader->readString();
+  StringRef Nm = readName();
   auto *E = Builder.newProject(arg(0), Nm);
   drop(1);
   push(E);
@@ -875,11 +1596,11 @@ void BytecodeReader::readWildcard() {
 
 void BytecodeWriter::reduceIdentifier(Identifier *E) {
   writeOpcode(COP_Identifier);
-  Writer->writeString(E->idString());
+  writeName(E->idString());
 }
 
 void BytecodeReader::readIdentifier() {
-  StringRef S = Reader->readString();
+  StringRef S = readName();
   auto *E = Builder.newIdentifier(S);
   push(E);
 }
@@ -921,6 +1642,11 @@ void BytecodeReader::readSExpr() {
     case PSOP_EnterBlock:    enterBlock();        break;
     case PSOP_EnterCFG:      enterCFG();          break;
     case PSOP_Annotation:    readAnnotation();    break;
+    case PSOP_LazyBody:      readLazyBody();      break;
+    case PSOP_RelInstrRef:   readRelWeak();       break;
+    case PSOP_StringTable:   readStringTable();   break;
+    case PSOP_SharedDef:     readSharedDef();     break;
+    case PSOP_SharedRef:     readSharedRef();     break;
     default:
       readSExprByType(getOpcode(Psop));  break;
   }
@@ -949,7 +1675,13 @@ void BytecodeReader::readAnnotationByKind(TIL_AnnKind Ak) {
     case ANNKIND_##X: A = X::deserialize(this); break;
 #include "TILAnnKinds.def"
   }
-  arg(0)->addAnnotation(A);
+  // Shared constants are never annotated; annotate a private copy instead.
+  SExpr *E = arg(0);
+  if (Builder.isSharedConstant(E)) {
+    E = Builder.unshare(E);
+    Stack.back() = E;
+  }
+  E->addAnnotation(A);
 }
 
 
@@ -984,5 +1716,245 @@ void BytecodeStringWriter::dump() {
 }
 
 
+/** Asynchronous file streams **/
+
+AsyncBlockQueue::AsyncBlockQueue(unsigned NumBlocks)
+    : Closed(false), Blocks(std::max(NumBlocks, 2u)), Sizes(Blocks.size()) {
+  for (unsigned i = 0, n = Blocks.size(); i < n; ++i) {
+    Blocks[i].resize(BlockSize);
+    Free.push_back(n - 1 - i);
+  }
+}
+
+
+int AsyncBlockQueue::acquireFree() {
+  std::unique_lock<std::mutex> Lock(Mutex);
+  Cond.wait(Lock, [this]() { return !Free.empty() || Closed; });
+  if (Closed)
+    return -1;
+  unsigned i = Free.back();
+  Free.pop_back();
+  return i;
+}
+
+
+int AsyncBlockQueue::acquireFull(int64_t *Size) {
+  std::unique_lock<std::mutex> Lock(Mutex);
+  Cond.wait(Lock, [this]() { return !Full.empty() || Closed; });
+  if (Full.empty())
+    return -1;     // Full blocks are drained even after closing.
+  unsigned i = Full.front();
+  Full.pop_front();
+  *Size = Sizes[i];
+  return i;
+}
+
+
+void AsyncBlockQueue::release(unsigned i) {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Free.push_back(i);
+  }
+  Cond.notify_all();
+}
+
+
+void AsyncBlockQueue::submit(unsigned i, int64_t Size) {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Sizes[i] = Size;
+    Full.push_back(i);
+  }
+  Cond.notify_all();
+}
+
+
+void AsyncBlockQueue::close() {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Closed = true;
+  }
+  Cond.notify_all();
+}
+
+
+AsyncBytecodeFileWriter::AsyncBytecodeFileWriter(const std::string &Name,
+                                                 unsigned NumBlocks)
+    : File(std::fopen(Name.c_str(), "wb")), Error(false), Queue(NumBlocks),
+      Current(-1), CurrentSize(0) {
+  Error = (File == nullptr);
+  Current = Queue.acquireFree();
+  Thread = std::thread(&AsyncBytecodeFileWriter::run, this);
+}
+
+
+void AsyncBytecodeFileWriter::writeData(const void *Buf, int64_t Size) {
+  const uint8_t *Src = static_cast<const uint8_t*>(Buf);
+  while (Size > 0) {
+    int64_t L = std::min(Size, AsyncBlockQueue::BlockSize - CurrentSize);
+    memcpy(Queue.data(Current) + CurrentSize, Src, L);
+    CurrentSize += L;
+    Src  += L;
+    Size -= L;
+    if (CurrentSize == AsyncBlockQueue::BlockSize) {
+      Queue.submit(Current, CurrentSize);
+      Current = Queue.acquireFree();
+      CurrentSize = 0;
+    }
+  }
+}
+
+
+void AsyncBytecodeFileWriter::close() {
+  if (!Thread.joinable())
+    return;
+  flush();
+  if (CurrentSize > 0)
+    Queue.submit(Current, CurrentSize);
+  Queue.close();
+  Thread.join();
+  if (File && std::fclose(File) != 0)
+    Error = true;
+  File = nullptr;
+}
+
+
+void AsyncBytecodeFileWriter::run() {
+  int64_t Size;
+  int i;
+  while ((i = Queue.acquireFull(&Size)) >= 0) {
+    if (File && std::fwrite(Queue.data(i), 1, Size, File) !=
+                static_cast<size_t>(Size))
+      Error = true;
+    Queue.release(i);
+  }
+}
+
+
+AsyncBytecodeFileReader::AsyncBytecodeFileReader(const std::string &FileName,
+                                                 MemRegionRef A,
+                                                 unsigned NumBlocks)
+    : File(std::fopen(FileName.c_str(), "rb")), Arena(A), Queue(NumBlocks),
+      Current(-1), CurrentSize(0), CurrentPos(0), Done(false) {
+  Thread = std::thread(&AsyncBytecodeFileReader::run, this);
+  refill();
+}
+
+
+AsyncBytecodeFileReader::~AsyncBytecodeFileReader() {
+  Queue.close();
+  Thread.join();
+  if (File)
+    std::fclose(File);
+}
+
+
+int64_t AsyncBytecodeFileReader::readData(void *Buf, int64_t Sz) {
+  uint8_t *Dest = static_cast<uint8_t*>(Buf);
+  int64_t Total = 0;
+  while (Total < Sz) {
+    if (CurrentPos == CurrentSize) {
+      if (Current >= 0)
+        Queue.release(Current);
+      Current = Done ? -1 : Queue.acquireFull(&CurrentSize);
+      CurrentPos = 0;
+      if (Current < 0) {
+        Done = true;
+        CurrentSize = 0;
+        break;
+      }
+      continue;
+    }
+    int64_t L = std::min(Sz - Total, CurrentSize - CurrentPos);
+    memcpy(Dest + Total, Queue.data(Current) + CurrentPos, L);
+    CurrentPos += L;
+    Total += L;
+  }
+  return Total;
+}
+
+
+void AsyncBytecodeFileReader::run() {
+  int i;
+  while (File && (i = Queue.acquireFree()) >= 0) {
+    int64_t N = std::fread(Queue.data(i), 1, AsyncBlockQueue::BlockSize, File);
+    Queue.submit(i, N);
+    if (N < AsyncBlockQueue::BlockSize)
+      break;
+  }
+  Queue.close();
+}
+
+
+
+/** MmapBytecodeReader **/
+
+namespace {
+
+// A mapped region of a file, which is unmapped when its arena is destroyed.
+struct FileMapping {
+  void*  Addr;
+  size_t Size;
+
+  static void release(void *P) {
+    FileMapping *M = static_cast<FileMapping*>(P);
+#ifndef _MSC_VER
+    munmap(M->Addr, M->Size);
+#endif
+  }
+};
+
+}  // end anonymous namespace
+
+
+const uint8_t* MmapBytecodeReader::mapFile(const std::string &FileName,
+                                           MemRegionRef A, int64_t *Size) {
+  const uint8_t *Addr = nullptr;
+  *Size = 0;
+
+#ifndef _MSC_VER
+  int Fd = open(FileName.c_str(), O_RDONLY);
+  if (Fd < 0)
+    return nullptr;
+  struct stat St;
+  if (fstat(Fd, &St) == 0 && St.st_size > 0) {
+    void *P = mmap(nullptr, St.st_size, PROT_READ, MAP_PRIVATE, Fd, 0);
+    if (P != MAP_FAILED) {
+      madvise(P, St.st_size, MADV_SEQUENTIAL);
+      FileMapping *M = A.allocateT<FileMapping>();
+      M->Addr = P;
+      M->Size = St.st_size;
+      A.addCleanup(&FileMapping::release, M);
+      Addr = static_cast<const uint8_t*>(P);
+      *Size = St.st_size;
+    }
+  }
+  close(Fd);
+#else
+  // No mmap; read the whole file into the arena instead.
+  std::ifstream FileStream(FileName, std::ios::binary | std::ios::ate);
+  int64_t Sz = FileStream ? static_cast<int64_t>(FileStream.tellg()) : 0;
+  if (Sz > 0) {
+    uint8_t *Buf = A.allocateT<uint8_t>(Sz);
+    FileStream.seekg(0);
+    FileStream.read(reinterpret_cast<char*>(Buf), Sz);
+    Addr = Buf;
+    *Size = Sz;
+  }
+#endif
+
+  return Addr;
+}
+
+
+MmapBytecodeReader::MmapBytecodeReader(const std::string &FileName,
+                                       MemRegionRef A)
+    : Arena(A) {
+  const uint8_t *Addr = mapFile(FileName, A, &FileSize);
+  Mapped = (Addr != nullptr);
+  setExternalData(Addr, FileSize, true);
+}
+
+
 }  // end namespace til
 }  // end namespace ohmu
@@ -14,10 +14,21 @@
 #include "CFGBuilder.h"
 #include "TIL.h"
 #include "TILTraverse.h"
+#include "base/VarInt.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace ohmu {
 namespace til {
@@ -30,6 +41,17 @@ public:
   // Maximum size of a single atom.
   static const int MaxAtomSize = (1 << 12);  // 4k
 
+  // A compressed stream begins with this magic number, which is followed by
+  // a sequence of frames.  Each frame has a header, with the uncompressed
+  // size and the compressed size as 32-bit little-endian integers, followed
+  // by the compressed data.  If the FrameStored bit is set in the compressed
+  // size, then the data is stored without compression.  A bytecode stream
+  // never begins with the byte 0xFF, so the magic cannot be confused with
+  // uncompressed data.
+  static const uint32_t CompressedMagic = 0x5a4c4fff;   // "\xFFOLZ"
+  static const int      FrameHeaderSize = 8;
+  static const uint32_t FrameStored     = 0x80000000;
+
   enum PseudoOpcode : uint8_t {
     PSOP_Null = 0,
     PSOP_WeakInstrRef,
@@ -40,6 +62,11 @@ public:
     PSOP_EnterBlock,
     PSOP_EnterCFG,
     PSOP_Annotation,
+    PSOP_LazyBody,
+    PSOP_RelInstrRef,
+    PSOP_StringTable,
+    PSOP_SharedDef,
+    PSOP_SharedRef,
     PSOP_Last
   };
 
@@ -68,7 +95,8 @@ public:
 /// a destination.  (E.g. file, network, etc.)
 class ByteStreamWriterBase {
 public:
-  ByteStreamWriterBase() : Pos(0), Buffer(BufferSize) { }
+  ByteStreamWriterBase()
+      : Compressed(false), Flushed(0), Pos(0), Buffer(BufferSize) { }
 
   virtual ~ByteStreamWriterBase() {
     assert(Pos == 0 && "Must flush writer before destruction.");
@@ -88,6 +116,18 @@ public:
   /// Emit a block of bytes.
   void writeBytes(const void *Data, int64_t Size);
 
+  /// Return the total number of bytes written so far, including buffered
+  /// data which has not yet been flushed.  For compressed streams, this is
+  /// the number of bytes before compression.
+  int64_t position() { return Flushed + Pos; }
+
+  /// Compress the stream.  Each flushed buffer is compressed as a separate
+  /// frame, which can be decompressed independently of the other frames.
+  /// This must be called before anything is written.
+  void setCompressed(bool B);
+
+  bool compressed() const { return Compressed; }
+
   /// Emit up to 32 bits in little-endian byte order.
   void writeBits32(uint32_t V, int Nbits);
 
@@ -95,10 +135,14 @@ public:
   void writeBits64(uint64_t V, int Nbits);
 
   /// Emit a 32-bit unsigned int in a variable number of bytes.
-  void writeUInt32_Vbr(uint32_t V);
+  void writeUInt32_Vbr(uint32_t V) {
+    Pos += VarInt::encode(V, Buffer.data() + Pos);
+  }
 
   /// Emit a 64-bit unsigned int in a variable number of bytes.
-  void writeUInt64_Vbr(uint64_t V);
+  void writeUInt64_Vbr(uint64_t V) {
+    Pos += VarInt::encode(V, Buffer.data() + Pos);
+  }
 
   void writeBool(bool V) { writeBits32(V, 1); }
 
@@ -120,11 +164,17 @@ private:
   /// Returns the remaining size in the buffer
   int length() { return BufferSize - Pos; }
 
+  /// Compress Size bytes of D, and write them as a single frame.
+  void writeFrame(const uint8_t *D, int64_t Size);
+
   /// Size of the buffer.  Default is 64k.
   static const int BufferSize = BytecodeBase::MaxAtomSize << 4;
 
+  bool Compressed;
+  int64_t Flushed;
   int Pos;
   std::vector<uint8_t> Buffer;
+  std::vector<uint8_t> FrameBuffer;   ///< Output of compression.
 };
 
 
@@ -135,7 +185,8 @@ private:
 class ByteStreamReaderBase {
 public:
   ByteStreamReaderBase() : BufferLen(0), Pos(0), Eof(false), Error(false),
-      Buffer(BufferSize) { }
+      SharedStrings(false), Detected(false), Compressed(false),
+      FramePos(0), Data(nullptr) { }
 
   virtual ~ByteStreamReaderBase() { }
 
@@ -146,6 +197,8 @@ public:
   /// Read a block of data from disk.
   /// Returns the amount of data read, in bytes.
   /// If the amount is less than Size, we assume end of file.
+  /// Compressed streams are detected and decompressed automatically, so
+  /// derived classes should return the raw data.
   virtual int64_t readData(void *Buf, int64_t Size) = 0;
 
   /// Allocate memory for a new string.
@@ -165,10 +218,14 @@ public:
   uint64_t readBits64(int Nbits);
 
   /// Read a 32-bit unsigned int in a variable number of bytes.
-  uint32_t readUInt32_Vbr();
+  uint32_t readUInt32_Vbr() { return static_cast<uint32_t>(readUInt64_Vbr()); }
 
   /// Read a 64-bit unsigned int in a variable number of bytes.
-  uint64_t readUInt64_Vbr();
+  uint64_t readUInt64_Vbr() {
+    uint64_t V;
+    Pos = VarInt::decode(Data + Pos, Data + BufferLen, &V) - Data;
+    return V;
+  }
 
   bool     readBool()   { return readBits32(1); }
 
@@ -186,20 +243,110 @@ public:
   double    readDouble();
   StringRef readString();
 
+  /// Read a string of Size bytes, whose size has already been read.
+  StringRef readString(uint32_t Size);
+
   bool empty() { return Eof && length() <= 0; }
 
+  bool error() { return Error; }
+
+  /// If the data is external and outlives the reader, return a pointer to
+  /// the next Size bytes, and skip over them.  Otherwise return nullptr.
+  const uint8_t* readSharedBytes(int64_t Size);
+
+  /// Return the number of bytes left in the stream, or -1 if the rest of the
+  /// stream has not been buffered yet, so the number is not known.
+  int64_t remaining() { return Eof ? length() : -1; }
+
+  /// Return true if the stream is compressed.
+  bool compressed() { return Compressed; }
+
+  /// Return true if the Size bytes in D begin with a compressed stream.
+  static bool isCompressedStream(const uint8_t *D, int64_t Size);
+
+  /// Return the size of the compressed stream in D after decompression,
+  /// or -1 if the stream is malformed.
+  static int64_t decompressedSize(const uint8_t *D, int64_t Size);
+
+  /// Decompress the stream in D into Out, which must hold decompressedSize()
+  /// bytes.  Frames are decompressed in parallel, on up to NumThreads
+  /// threads; 0 means one per hardware thread.  Returns false on error.
+  static bool decompressStream(const uint8_t *D, int64_t Size, uint8_t *Out,
+                               unsigned NumThreads = 0);
+
+protected:
+  /// Decode directly from D, which holds the entire stream, rather than
+  /// copying data through the internal buffer.  D must remain valid for as
+  /// long as the reader is in use.  If SharedStr is true, then D must also
+  /// outlive the expressions that are read, because strings will point into
+  /// D rather than being copied with allocStringData.  If D holds a
+  /// compressed stream, it is decompressed into an internal buffer, and
+  /// strings are always copied.
+  void setExternalData(const uint8_t *D, int64_t Size, bool SharedStr);
+
 private:
   /// Return the remaining data in the buffer.
-  int length() { return BufferLen - Pos; }
+  int64_t length() { return BufferLen - Pos; }
+
+  /// Read up to Size bytes of the uncompressed stream, using readData.
+  int64_t readRaw(void *Buf, int64_t Size);
+
+  /// Read and decompress the next frame of a compressed stream.
+  /// Returns false at the end of the stream, or on error.
+  bool readFrame();
 
   /// Size of the buffer.  Default is 64k.
   static const int BufferSize = BytecodeBase::MaxAtomSize << 4;
 
-  int  BufferLen;
-  int  Pos;
+  int64_t BufferLen;
+  int64_t Pos;
   bool Eof;
   bool Error;
-  std::vector<uint8_t> Buffer;
+  bool SharedStrings;         ///< Strings point into Data.
+  bool Detected;              ///< The compression magic has been checked.
+  bool Compressed;
+  int64_t FramePos;           ///< Position in the current frame.
+  const uint8_t* Data;        ///< Buffer.data(), or external data.
+  std::vector<uint8_t> Buffer;    ///< Allocated by the first refill.
+  std::vector<uint8_t> Frame;     ///< Current frame, after decompression.
+  std::vector<uint8_t> FrameIn;   ///< Current frame, before decompression.
+};
+
+
+
+/// Simple writer that serializes to a vector of bytes.
+class BytecodeBufferWriter : public ByteStreamWriterBase {
+public:
+  virtual ~BytecodeBufferWriter() { flush(); }
+
+  /// Append a block of data to the buffer.
+  virtual void writeData(const void *Buf, int64_t Size) override {
+    const uint8_t *B = static_cast<const uint8_t*>(Buf);
+    Data.insert(Data.end(), B, B + Size);
+  }
+
+  const uint8_t* data() const { return Data.data(); }
+  int64_t        size() const { return Data.size(); }
+
+  /// Discard the contents of the buffer.  The writer must be flushed.
+  void clear() { Data.clear(); }
+
+private:
+  std::vector<uint8_t> Data;
+};
+
+
+
+/// Counts the Code and Function bodies which were deferred by a lazy
+/// BytecodeReader, and how many of those have since been decoded.
+struct LazyBodyStats {
+  LazyBodyStats() : NumDeferred(0), NumDecoded(0) { }
+
+  unsigned numSkipped() const { return NumDeferred - NumDecoded; }
+
+  // Atomic, because definitions may be read on several threads.
+  std::atomic<unsigned> NumDeferred;
+  std::atomic<unsigned> NumDecoded;
 };
 
 
@@ -207,6 +354,15 @@ private:
 /// Traverse a SExpr and serialize it.
 class BytecodeWriter : public Traversal<BytecodeWriter>,
                        public BytecodeBase {
+public:
+  /// The location of a serialized SCFG in the output stream, along with the
+  /// variables which were in scope, so that it can be read independently.
+  struct CFGLocation {
+    int64_t Offset;
+    int64_t Size;
+    std::vector<VarDecl*> Scope;
+  };
+
 protected:
   typedef Traversal<BytecodeWriter> SuperTv;
 
@@ -243,7 +399,7 @@ protected:
   void writeLitVal(float  V)    { Writer->writeFloat(V);  }
   void writeLitVal(double V)    { Writer->writeDouble(V); }
 
-  void writeLitVal(StringRef S) { Writer->writeString(S); }
+  void writeLitVal(StringRef S) { writeName(S); }
 
   void writeLitVal(void* P) {
     assert(P == nullptr && "Cannot serialize non-null pointer literal.");
@@ -252,6 +408,10 @@ protected:
 public:
   template<class T>
   void traverse(T *E, TraversalKind K) {
+    bool Define = false;
+    if (SharedSubtrees && writeSharedRef(E, &Define))
+      return;
+
     SuperTv::traverse(E, K);
     Writer->endAtom();
 
@@ -261,6 +421,9 @@ public:
       Writer->endAtom();
       A = A->next();
     }
+
+    if (Define)
+      writeSharedDef(E);
   }
 
   // Postpone traversal until the SExpr is fully written.
@@ -284,12 +447,15 @@ public:
   bool enterSubExpr(TraversalKind K) { return false; }
   void exitSubExpr(TraversalKind K, LocationState S) { }
 
+  void traverseFunction(Function *E);
+  void traverseCode(Code *E);
+
   void enterScope(VarDecl *Vd);
   void enterCFG  (SCFG *Cfg);
   void enterBlock(BasicBlock *B);
 
   void exitScope (VarDecl *Vd);
-  void exitCFG   (SCFG *Cfg)     { }
+  void exitCFG   (SCFG *Cfg);
   void exitBlock (BasicBlock *B) { }
 
   void reduceNull();
@@ -331,18 +497,84 @@ public:
   void reduceLet(Let *E);
   void reduceIfThenElse(IfThenElse *E);
 
-  BytecodeWriter(ByteStreamWriterBase *W) : Writer(W) { }
+  BytecodeWriter(ByteStreamWriterBase *W)
+      : Writer(W), LazyBodies(false), RelativeRefs(false), StringTable(false),
+        SharedSubtrees(false), LazyDepth(0), CFGDepth(0), CurrentInstrID(0),
+        NumShared(0), CFGIndex(nullptr) { }
       // WritingAnn(false) { }
 
   ByteStreamWriterBase *getWriter() { return Writer; }
 
+  /// Record the location of each SCFG that is written in Idx.
+  void setCFGIndex(std::vector<CFGLocation> *Idx) { CFGIndex = Idx; }
+
+  /// Prefix the bodies of Code and Function with their size, so that a
+  /// reader can skip them and decode them on demand.  Bodies within an SCFG
+  /// are always written inline.
+  void setLazyBodies(bool B) { LazyBodies = B; }
+
+  /// Encode references to instructions relative to the instruction which is
+  /// being read, rather than by absolute ID.  Most operands refer to recent
+  /// instructions, so relative references are smaller.  Readers accept both
+  /// encodings, but older readers cannot read relative references.
+  void setRelativeInstrRefs(bool B) { RelativeRefs = B; }
+
+  /// Begin the stream with a table of the names which occur more than once,
+  /// and refer to names in the table by index.  Used by write().
+  void setStringTable(bool B) { StringTable = B; }
+
+  /// Write subexpressions which occur more than once only the first time,
+  /// and refer back to them afterwards.  Only closed expressions outside of
+  /// an SCFG, such as types, are shared, so the expression which is read
+  /// back is a DAG.  Used by write().  Cannot be combined with setCFGIndex,
+  /// because a shared expression may be defined outside of the SCFG.
+  void setSharedSubtrees(bool B) { SharedSubtrees = B; }
+
   void write(SExpr* E) {
+    assert(!(SharedSubtrees && CFGIndex) && "Cannot index shared subtrees.");
+    if (StringTable || SharedSubtrees)
+      writeTables(E);
     traverseAll(E);
     Writer->flush();
   }
 
 private:
+  /// Write a body which may be skipped by the reader.
+  void writeLazyBody(SExpr *E);
+
+  /// Count the names and subexpressions in E, and write the string table.
+  void writeTables(SExpr *E);
+
+  /// Write a name, using the string table if there is one.
+  void writeName(StringRef S);
+
+  /// If E has already been written, write a reference to it and return
+  /// true.  Otherwise, set Define if E should be written as a definition.
+  bool writeSharedRef(SExpr *E, bool *Define);
+
+  /// Mark E, which has just been written, as a shared definition.
+  void writeSharedDef(SExpr *E);
+
   ByteStreamWriterBase *Writer;
+
+  bool     LazyBodies;
+  bool     RelativeRefs;
+  bool     StringTable;
+  bool     SharedSubtrees;
+  unsigned LazyDepth;    // Number of nested bodies being written.
+  unsigned CFGDepth;     // Number of nested SCFGs being written.
+  unsigned CurrentInstrID;   // Mirrors BytecodeReader::CurrentInstrID.
+  unsigned NumShared;        // Number of shared definitions written.
+  std::vector<std::unique_ptr<BytecodeBufferWriter>> LazyWriters;
+
+  std::unordered_map<std::string, unsigned> StringIndex;
+  std::unordered_map<std::string, unsigned> SubtreeUses;  // Keyed by shape.
+  std::unordered_map<std::string, unsigned> SharedIndex;  // Visible defs.
+  std::vector<std::string>                  SharedKeys;   // In def order.
+
+  std::vector<CFGLocation> *CFGIndex;
+  std::vector<VarDecl*>     ScopeVars;   // Only maintained for CFGIndex.
+  std::vector<unsigned>     OpenCFGs;    // Indices of CFGs being written.
 };
 
 
@@ -380,7 +612,7 @@ protected:
 
   float     readLitVal(float*)     { return Reader->readFloat();  }
   double    readLitVal(double*)    { return Reader->readDouble(); }
-  StringRef readLitVal(StringRef*) { return Reader->readString(); }
+  StringRef readLitVal(StringRef*) { return readName(); }
   void*     readLitVal(void**)     { return nullptr; }
 
   ArrayRef<SExpr*> lastArgs(unsigned n) {
@@ -410,6 +642,13 @@ protected:
   void exitScope();
   void enterBlock();
   void enterCFG();
+  void readLazyBody();
+  void readStringTable();
+  void readSharedDef();
+  void readSharedRef();
+
+  /// Read a name, which may refer to the string table.
+  StringRef readName();
 
   /// Get the VarDecl for the given variable index.
   VarDecl* getVarDecl(unsigned Vidx);
@@ -420,6 +659,7 @@ protected:
 
   void readNull();
   void readWeak();
+  void readRelWeak();
   void readBBArgument();
   void readBBInstruction();
 
@@ -460,13 +700,37 @@ protected:
 
 public:
   BytecodeReader(CFGBuilder& B, ByteStreamReaderBase* R)
-      : Builder(B), Reader(R), Success(true),
-        CurrentInstrID(0), CurrentArg(0), CFGStackSize(0) {
+      : Builder(B), Reader(R), Success(true), LazyStats(nullptr),
+        Strings(nullptr), NumStrings(0), CurrentInstrID(0), CurrentArg(0),
+        CFGStackSize(0) {
     Vars.push_back(nullptr);  // indices start at 1.
   }
 
   SExpr* read();
 
+  /// Declare Vd, so that it is in scope for the expressions which are read.
+  /// Used to read an expression which was written inside of Vd's scope.
+  void addScope(VarDecl *Vd);
+
+  /// Use the string table of the stream that holds the expression to be
+  /// read.  Used to read an expression from the middle of a stream.
+  void setStringTable(StringRef *S, unsigned N) {
+    Strings = S;
+    NumStrings = N;
+  }
+
+  /// Append E to the shared subexpressions, in the order in which they were
+  /// defined by the enclosing stream.
+  void addShared(SExpr *E) { Shared.push_back(E); }
+
+  /// Read bodies which were written with BytecodeWriter::setLazyBodies as
+  /// futures, which decode the body when forced.  Stats counts the deferred
+  /// and decoded bodies; it is allocated in the arena if null.
+  void setLazyBodies(LazyBodyStats *Stats = nullptr);
+
+  /// Return the lazy body counters, or null if bodies are read eagerly.
+  LazyBodyStats* lazyStats() { return LazyStats; }
+
   bool success() { return Success; }
 
   SExpr *arg(int i) {
@@ -491,6 +755,9 @@ private:
   CFGBuilder&            Builder;
   ByteStreamReaderBase*  Reader;
   bool                   Success;
+  LazyBodyStats*         LazyStats;
+  StringRef*             Strings;     // String table, in the arena.
+  unsigned               NumStrings;
 
   unsigned  CurrentInstrID;
   int       CurrentArg;
@@ -500,6 +767,7 @@ private:
   std::vector<VarDecl*>     Vars;
   std::vector<BasicBlock*>  Blocks;
   std::vector<Instruction*> Instrs;
+  std::vector<SExpr*>       Shared;   // Null if defined in a skipped body.
 };
 
 
@@ -555,6 +823,29 @@ private:
 };
 
 
+/// Reader that decodes directly from an array of bytes in memory, without
+/// copying it.  If SharedStr is true, then strings point into the array, so
+/// the array must outlive the expressions that are read.
+class ByteArrayReader : public ByteStreamReaderBase {
+public:
+  ByteArrayReader(const uint8_t* Buf, int64_t Sz, MemRegionRef A,
+                  bool SharedStr = true)
+      : Arena(A) {
+    setExternalData(Buf, Sz, SharedStr);
+  }
+
+  /// All of the data is available up front, so there is nothing to read.
+  virtual int64_t readData(void *Buf, int64_t Sz) override { return 0; }
+
+  virtual char* allocStringData(uint32_t Sz) override {
+    return Arena.allocateT<char>(Sz + 1);
+  }
+
+private:
+  MemRegionRef Arena;
+};
+
+
 /// Simple writer that serializes to a file.
 class BytecodeFileWriter : public ByteStreamWriterBase {
 public:
@@ -604,6 +895,139 @@ private:
 };
 
 
+/// A set of blocks which are passed between a stream and its I/O thread.
+/// Blocks are either free, or full and waiting to be consumed, in order.
+class AsyncBlockQueue {
+public:
+  /// Size of each block.  Default is 1M.
+  static const int64_t BlockSize = 1 << 20;
+
+  AsyncBlockQueue(unsigned NumBlocks);
+
+  uint8_t* data(unsigned i) { return Blocks[i].data(); }
+
+  /// Wait for a free block, and return its index, or -1 if closed.
+  int acquireFree();
+
+  /// Wait for the next full block, and return its index, or -1 if there are
+  /// no more blocks.  Sets Size to the amount of data in the block.
+  int acquireFull(int64_t *Size);
+
+  /// Return block i to the free list.
+  void release(unsigned i);
+
+  /// Mark block i as full, with Size bytes of data.
+  void submit(unsigned i, int64_t Size);
+
+  /// No more blocks will be submitted, or wanted.  Wakes waiting threads.
+  void close();
+
+private:
+  std::mutex Mutex;
+  std::condition_variable Cond;
+  bool Closed;
+  std::vector<std::vector<uint8_t>> Blocks;
+  std::vector<int64_t>  Sizes;
+  std::vector<unsigned> Free;
+  std::deque<unsigned>  Full;
+};
+
+
+/// Writer that writes to a file on a background thread, so that encoding
+/// overlaps with disk I/O.  Data is collected into blocks; each full block is
+/// handed to the thread, while the encoder continues with a free one.  The
+/// encoder only waits if all NumBlocks blocks are waiting to be written.
+class AsyncBytecodeFileWriter : public ByteStreamWriterBase {
+public:
+  AsyncBytecodeFileWriter(const std::string &Name, unsigned NumBlocks = 2);
+
+  virtual ~AsyncBytecodeFileWriter() { close(); }
+
+  /// Copy a block of data to the current block.
+  virtual void writeData(const void *Buf, int64_t Size) override;
+
+  /// Flush, and wait until everything has been written to disk.
+  void close();
+
+  /// Return true if the file could not be opened or written.
+  bool error() const { return Error; }
+
+private:
+  void run();
+
+  std::FILE *File;
+  std::atomic<bool> Error;
+  AsyncBlockQueue Queue;
+  int      Current;       // Block being filled, or -1.
+  int64_t  CurrentSize;
+  std::thread Thread;
+};
+
+
+/// Reader that reads a file on a background thread, ahead of the decoder,
+/// into up to NumBlocks blocks.
+class AsyncBytecodeFileReader : public ByteStreamReaderBase {
+public:
+  AsyncBytecodeFileReader(const std::string &FileName, MemRegionRef A,
+                          unsigned NumBlocks = 2);
+
+  virtual ~AsyncBytecodeFileReader();
+
+  /// Copy data from the blocks which have been read.
+  virtual int64_t readData(void *Buf, int64_t Sz) override;
+
+  virtual char* allocStringData(uint32_t Sz) override {
+    return Arena.allocateT<char>(Sz + 1);
+  }
+
+private:
+  void run();
+
+  std::FILE *File;
+  MemRegionRef Arena;
+  AsyncBlockQueue Queue;
+  int      Current;       // Block being read, or -1.
+  int64_t  CurrentSize;
+  int64_t  CurrentPos;
+  bool     Done;          // The last block has been consumed.
+  std::thread Thread;
+};
+
+
+/// Reader that maps a file into memory, and decodes directly from the
+/// mapping, without copying it through a buffer.  Strings in the resulting
+/// expressions point into the mapping, so the mapping is owned by the arena,
+/// and is released when the arena is destroyed, rather than with the reader.
+class MmapBytecodeReader : public ByteStreamReaderBase {
+public:
+  MmapBytecodeReader(const std::string &FileName, MemRegionRef A);
+
+  /// Map FileName into memory, and return a pointer to its contents.
+  /// The mapping is released when A is destroyed.  Sets *Size to the size
+  /// of the file, and returns nullptr if the file is empty or cannot be read.
+  static const uint8_t* mapFile(const std::string &FileName, MemRegionRef A,
+                                int64_t *Size);
+
+  /// Return true if the file was successfully mapped.
+  bool isOpen() { return Mapped; }
+
+  /// Return the size of the file, in bytes.
+  int64_t fileSize() { return FileSize; }
+
+  /// All of the data is available up front, so there is nothing to read.
+  virtual int64_t readData(void *Buf, int64_t Sz) override { return 0; }
+
+  virtual char* allocStringData(uint32_t Sz) override {
+    return Arena.allocateT<char>(Sz + 1);
+  }
+
+private:
+  bool    Mapped;
+  int64_t FileSize;
+  MemRegionRef Arena;
+};
+
+
 }  // end namespace til
 }  // end namespace ohmu
 
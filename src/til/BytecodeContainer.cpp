@@ -0,0 +1,446 @@
+//===- BytecodeContainer.cpp -----------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BytecodeContainer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace ohmu {
+namespace til  {
+
+
+/** BytecodeContainerWriter **/
+
+BytecodeContainerWriter::BytecodeContainerWriter(ByteStreamWriterBase *W)
+    : Writer(W), LazyBodies(false), Flags(0), ParentOffset(0),
+      ParentSize(0) {
+  Writer->writeBits32(Magic, 32);
+  Writer->writeBits32(Version, 32);
+  Writer->endAtom();
+}
+
+
+unsigned BytecodeContainerWriter::addString(StringRef S) {
+  auto It = StringMap.find(S.str());
+  if (It != StringMap.end())
+    return It->second;
+  unsigned Idx = Strings.size();
+  Strings.push_back(S.str());
+  StringMap.emplace(S.str(), Idx);
+  return Idx;
+}
+
+
+int64_t BytecodeContainerWriter::writeStream(SExpr *E) {
+  int64_t Start = Writer->position();
+  BytecodeWriter W(Writer);
+  W.setLazyBodies(LazyBodies);
+  W.setRelativeInstrRefs(true);
+  W.traverseAll(E);
+  return Writer->position() - Start;
+}
+
+
+void BytecodeContainerWriter::addScope(VarDecl *Vd) {
+  assert(Vd->varIndex() == Scope.size() + 1 && "Invalid variable index.");
+
+  ScopeEntry S;
+  S.Kind = Vd->kind();
+  S.Name = addString(Vd->varName());
+  S.TypeOffset = Writer->position();
+  S.TypeSize   = 0;
+  // The definition of a self-variable is the enclosing function.
+  if (Vd->kind() != VarDecl::VK_SFun && Vd->definition())
+    S.TypeSize = writeStream(Vd->definition());
+  Scope.push_back(S);
+}
+
+
+unsigned BytecodeContainerWriter::addDefinition(StringRef Name, SExpr *E) {
+  std::vector<BytecodeWriter::CFGLocation> Locs;
+
+  DefinitionEntry D;
+  D.Name   = addString(Name);
+  D.Offset = Writer->position();
+  {
+    BytecodeWriter W(Writer);
+    W.setCFGIndex(&Locs);
+    W.setLazyBodies(LazyBodies);
+    W.setRelativeInstrRefs(true);
+    W.traverseAll(E);
+  }
+  D.Size = Writer->position() - D.Offset;
+
+  for (auto &L : Locs) {
+    CFGEntry C;
+    C.Offset = L.Offset;
+    C.Size   = L.Size;
+    for (VarDecl *Vd : L.Scope)
+      C.Vars.push_back(std::make_pair(Vd->kind(), addString(Vd->varName())));
+    D.CFGs.push_back(std::move(C));
+  }
+
+  Definitions.push_back(std::move(D));
+  return Definitions.size() - 1;
+}
+
+
+void BytecodeContainerWriter::writeModule(SExpr *E) {
+  auto *F = dyn_cast_or_null<Function>(E);
+  auto *R = F ? dyn_cast_or_null<Record>(F->body()) : nullptr;
+  if (!R || F->variableDecl()->kind() != VarDecl::VK_SFun ||
+      F->variableDecl()->varIndex() != Scope.size() + 1) {
+    addDefinition("", E);
+    return;
+  }
+
+  beginModule(F->variableDecl(), R->parent());
+  for (auto &S : R->slots())
+    addSlot(S.get());
+}
+
+
+void BytecodeContainerWriter::beginModule(VarDecl *Self, SExpr *Parent) {
+  assert(Definitions.empty() && "Module must begin before its slots.");
+  Flags |= CF_Module;
+  addScope(Self);
+  if (Parent) {
+    ParentOffset = Writer->position();
+    ParentSize   = writeStream(Parent);
+  }
+}
+
+
+void BytecodeContainerWriter::finish() {
+  int64_t StringOffset = Writer->position();
+  Writer->writeUInt32(Strings.size());
+  for (auto &S : Strings) {
+    Writer->writeString(StringRef(S.data(), S.size()));
+    Writer->endAtom();
+  }
+
+  int64_t IndexOffset = Writer->position();
+  Writer->writeUInt32(Flags);
+  Writer->writeUInt64(ParentOffset);
+  Writer->writeUInt64(ParentSize);
+
+  Writer->writeUInt32(Scope.size());
+  for (auto &S : Scope) {
+    Writer->writeUInt8(S.Kind);
+    Writer->writeUInt32(S.Name);
+    Writer->writeUInt64(S.TypeOffset);
+    Writer->writeUInt64(S.TypeSize);
+    Writer->endAtom();
+  }
+
+  Writer->writeUInt32(Definitions.size());
+  for (auto &D : Definitions) {
+    Writer->writeUInt32(D.Name);
+    Writer->writeUInt64(D.Offset);
+    Writer->writeUInt64(D.Size);
+    Writer->writeUInt32(D.CFGs.size());
+    Writer->endAtom();
+    for (auto &C : D.CFGs) {
+      Writer->writeUInt64(C.Offset);
+      Writer->writeUInt64(C.Size);
+      Writer->writeUInt32(C.Vars.size());
+      Writer->endAtom();
+      for (auto &V : C.Vars) {
+        Writer->writeUInt8(V.first);
+        Writer->writeUInt32(V.second);
+        Writer->endAtom();
+      }
+    }
+  }
+
+  Writer->writeBits64(StringOffset, 64);
+  Writer->writeBits64(IndexOffset, 64);
+  Writer->writeBits32(Magic, 32);
+  Writer->flush();
+}
+
+
+
+/** BytecodeContainerReader **/
+
+BytecodeContainerReader::BytecodeContainerReader(const uint8_t *D,
+                                                 int64_t Size, MemRegionRef A)
+    : Data(D), DataSize(Size), Arena(A), LazyStats(nullptr), NumThreads(1),
+      Valid(false),
+      Flags(0), ParentOffset(0), ParentSize(0) {
+  readIndex();
+}
+
+
+BytecodeContainerReader::BytecodeContainerReader(const std::string &FileName,
+                                                 MemRegionRef A)
+    : Data(nullptr), DataSize(0), Arena(A), LazyStats(nullptr), NumThreads(1),
+      Valid(false),
+      Flags(0), ParentOffset(0), ParentSize(0) {
+  Data = MmapBytecodeReader::mapFile(FileName, A, &DataSize);
+  readIndex();
+}
+
+
+void BytecodeContainerReader::readIndex() {
+  if (Data && ByteStreamReaderBase::isCompressedStream(Data, DataSize)) {
+    // Decompress into the arena, so that strings can still point into Data.
+    int64_t Len = ByteStreamReaderBase::decompressedSize(Data, DataSize);
+    if (Len < 0)
+      return;
+    uint8_t *Buf = Arena.allocateT<uint8_t>(Len);
+    if (!ByteStreamReaderBase::decompressStream(Data, DataSize, Buf))
+      return;
+    Data = Buf;
+    DataSize = Len;
+  }
+
+  if (!Data || DataSize < 8 + TrailerSize)
+    return;
+
+  ByteArrayReader Header(Data, 8, Arena);
+  if (Header.readBits32(32) != Magic || Header.readBits32(32) != Version)
+    return;
+
+  int64_t EndOffset = DataSize - TrailerSize;
+  ByteArrayReader Trailer(Data + EndOffset, TrailerSize, Arena);
+  int64_t StringOffset = Trailer.readBits64(64);
+  int64_t IndexOffset  = Trailer.readBits64(64);
+  if (Trailer.readBits32(32) != Magic ||
+      StringOffset < 8 || StringOffset > IndexOffset ||
+      IndexOffset > EndOffset)
+    return;
+
+  ByteArrayReader StringReader(Data + StringOffset,
+                               IndexOffset - StringOffset, Arena);
+  std::vector<StringRef> Strings;
+  unsigned Ns = StringReader.readUInt32();
+  if (Ns > IndexOffset - StringOffset)   // Each string has a length.
+    return;
+  Strings.reserve(Ns);
+  for (unsigned i = 0; i < Ns && !StringReader.error(); ++i)
+    Strings.push_back(StringReader.readString());
+  if (StringReader.error() || Strings.size() != Ns)
+    return;
+
+  bool Ok = true;
+  auto getString = [&](unsigned i) -> StringRef {
+    if (i < Strings.size())
+      return Strings[i];
+    Ok = false;
+    return StringRef("", 0);
+  };
+
+  ByteArrayReader R(Data + IndexOffset, EndOffset - IndexOffset, Arena);
+  Flags        = R.readUInt32();
+  ParentOffset = R.readUInt64();
+  ParentSize   = R.readUInt64();
+
+  unsigned Nv = R.readUInt32();
+  for (unsigned i = 0; i < Nv && Ok; ++i) {
+    auto K = static_cast<VarDecl::VariableKind>(R.readUInt8());
+    StringRef Nm = getString(R.readUInt32());
+    int64_t Off  = R.readUInt64();
+    int64_t Sz   = R.readUInt64();
+    Scope.push_back(ScopeEntry{ K, Nm, Off, Sz });
+  }
+
+  // Each definition takes at least four bytes: name, offset, size, and the
+  // number of CFGs.  Reject counts which cannot fit in the index.
+  unsigned Nd = R.readUInt32();
+  if (Nd > (EndOffset - IndexOffset) / 4)
+    return;
+  Definitions.reserve(Nd);
+  for (unsigned i = 0; i < Nd && Ok; ++i) {
+    DefinitionEntry D;
+    D.Name   = getString(R.readUInt32());
+    D.Offset = R.readUInt64();
+    D.Size   = R.readUInt64();
+    unsigned Nc = R.readUInt32();
+    for (unsigned j = 0; j < Nc && Ok; ++j) {
+      CFGEntry C;
+      C.Offset = R.readUInt64();
+      C.Size   = R.readUInt64();
+      unsigned Ncv = R.readUInt32();
+      for (unsigned k = 0; k < Ncv && Ok; ++k) {
+        auto K = static_cast<VarDecl::VariableKind>(R.readUInt8());
+        C.Vars.push_back(std::make_pair(K, getString(R.readUInt32())));
+      }
+      D.CFGs.push_back(std::move(C));
+    }
+    DefinitionMap.emplace(D.Name.str(), i);
+    Definitions.push_back(std::move(D));
+  }
+
+  Valid = Ok && !R.error();
+}
+
+
+int BytecodeContainerReader::findDefinition(StringRef Name) {
+  auto It = DefinitionMap.find(Name.str());
+  if (It == DefinitionMap.end())
+    return -1;
+  return It->second;
+}
+
+
+SExpr* BytecodeContainerReader::readSlice(int64_t Offset, int64_t Size,
+                                          CFGBuilder &B,
+                                          const std::vector<VarDecl*> &Vars) {
+  if (!validSlice(Offset, Size) || Size == 0)
+    return nullptr;
+
+  ByteArrayReader ReadStream(Data + Offset, Size, B.arena());
+  BytecodeReader Reader(B, &ReadStream);
+  if (LazyStats)
+    Reader.setLazyBodies(LazyStats);
+  for (auto *Vd : Vars)
+    Reader.addScope(Vd);
+  SExpr *E = Reader.read();
+  if (!Reader.success())
+    return nullptr;
+  return E;
+}
+
+
+void BytecodeContainerReader::readScope(CFGBuilder &B,
+                                        std::vector<VarDecl*> &Vars) {
+  for (auto &S : Scope) {
+    SExpr *Ty = readSlice(S.TypeOffset, S.TypeSize, B, Vars);
+    auto *Vd = B.newVarDecl(S.Kind, S.Name, Ty);
+    Vd->setVarIndex(Vars.size() + 1);
+    Vars.push_back(Vd);
+  }
+}
+
+
+SExpr* BytecodeContainerReader::readDefinition(unsigned i, CFGBuilder &B,
+    const std::vector<VarDecl*> &Vars) {
+  if (!Valid || i >= Definitions.size())
+    return nullptr;
+  auto &D = Definitions[i];
+  return readSlice(D.Offset, D.Size, B, Vars);
+}
+
+
+SExpr* BytecodeContainerReader::readDefinition(unsigned i, CFGBuilder &B) {
+  std::vector<VarDecl*> Vars;
+  readScope(B, Vars);
+  return readDefinition(i, B, Vars);
+}
+
+
+SCFG* BytecodeContainerReader::readCFG(unsigned i, unsigned j,
+                                       CFGBuilder &B) {
+  if (!Valid || i >= Definitions.size() || j >= Definitions[i].CFGs.size())
+    return nullptr;
+
+  std::vector<VarDecl*> Vars;
+  readScope(B, Vars);
+
+  auto &C = Definitions[i].CFGs[j];
+  for (auto &V : C.Vars) {
+    auto *Vd = B.newVarDecl(V.first, V.second, nullptr);
+    Vd->setVarIndex(Vars.size() + 1);
+    Vars.push_back(Vd);
+  }
+  return dyn_cast_or_null<SCFG>(readSlice(C.Offset, C.Size, B, Vars));
+}
+
+
+SExpr* BytecodeContainerReader::readModule(CFGBuilder &B) {
+  if (!Valid)
+    return nullptr;
+  if (!isModule())
+    return Definitions.size() > 0 ? readDefinition(0, B) : nullptr;
+
+  std::vector<VarDecl*> Vars;
+  readScope(B, Vars);
+  if (Vars.size() != 1)
+    return nullptr;
+
+  SExpr *Parent = readSlice(ParentOffset, ParentSize, B, Vars);
+  std::vector<SExpr*> Defs;
+  readDefinitions(B, Vars, Defs);
+
+  // Slots refer to each other through self, which all definitions share,
+  // so linking them only requires building the record.
+  auto *R = B.newRecord(Definitions.size(), Parent);
+  for (auto *E : Defs) {
+    auto *S = dyn_cast_or_null<Slot>(E);
+    if (!S)
+      return nullptr;
+    R->addSlot(B.arena(), S);
+  }
+  return B.newFunction(Vars[0], R);
+}
+
+
+namespace {
+
+// Releases the arena of a worker thread.
+void deleteRegion(void *P) {
+  delete static_cast<MemRegion*>(P);
+}
+
+}  // end anonymous namespace
+
+
+void BytecodeContainerReader::readDefinitions(CFGBuilder &B,
+    const std::vector<VarDecl*> &Vars, std::vector<SExpr*> &Defs) {
+  unsigned N = Definitions.size();
+  Defs.assign(N, nullptr);
+
+  unsigned NumWorkers = NumThreads;
+  if (NumWorkers == 0)
+    NumWorkers = std::thread::hardware_concurrency();
+  NumWorkers = std::min(NumWorkers, N);
+
+  if (NumWorkers <= 1) {
+    for (unsigned i = 0; i < N; ++i)
+      Defs[i] = readDefinition(i, B, Vars);
+    return;
+  }
+
+  // The scope variables are shared, but are only read by the workers.
+  // Definitions are assigned to threads dynamically, so which arena holds a
+  // definition may vary, but the decoded expressions do not.
+  std::atomic<unsigned> Next(0);
+  auto Work = [&](MemRegion *Region) {
+    CFGBuilder Builder((MemRegionRef(Region)));
+    for (unsigned i = Next++; i < N; i = Next++)
+      Defs[i] = readDefinition(i, Builder, Vars);
+  };
+
+  std::vector<std::thread> Workers;
+  for (unsigned t = 0; t < NumWorkers; ++t) {
+    MemRegion *Region = new MemRegion();
+    B.arena().addCleanup(&deleteRegion, Region);
+    if (t + 1 < NumWorkers)
+      Workers.emplace_back(Work, Region);
+    else
+      Work(Region);
+  }
+  for (auto &T : Workers)
+    T.join();
+}
+
+
+}  // end namespace til
+}  // end namespace ohmu
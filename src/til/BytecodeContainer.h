@@ -0,0 +1,282 @@
+//===- BytecodeContainer.h -------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// A bytecode container holds a set of named top-level definitions, each of
+// which is serialized as an independent bytecode stream, along with an index
+// which allows any definition, or any SCFG within a definition, to be found
+// and decoded without decoding the rest of the container.
+//
+// The layout of a container is:
+//
+//   header:        magic, version
+//   body:          one bytecode stream per definition, and per type of a
+//                  scope variable
+//   string table:  names used by the index
+//   index:         flags, scope variables, definitions, and their SCFGs
+//   trailer:       offset of string table, offset of index, magic
+//
+// The trailer has a fixed size, so a reader finds the index by reading the
+// end of the container.  Definitions may refer to the scope variables,
+// which are declared by the container rather than by any definition.  A
+// module of the form (\self -> [ slots ]) is stored with self as a scope
+// variable, and one definition per slot.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_TIL_BYTECODECONTAINER_H
+#define OHMU_TIL_BYTECODECONTAINER_H
+
+#include "Bytecode.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace ohmu {
+namespace til  {
+
+
+/// Information common to container readers and writers.
+class BytecodeContainerBase {
+public:
+  static const uint32_t Magic   = 0x4342484f;   // "OHBC"
+  // Version 2 encodes instruction references relative to the current
+  // instruction.  See BytecodeWriter::setRelativeInstrRefs.  Version 3
+  // records the number of shared definitions in each lazy body.
+  static const uint32_t Version = 3;
+
+  /// Size of the trailer, in bytes.
+  static const int TrailerSize = 20;
+
+  enum ContainerFlags : uint32_t {
+    CF_Module = 0x01    ///< The container holds the slots of a module.
+  };
+};
+
+
+/// Writes a container to a byte stream.
+/// Each definition is written to the stream as soon as it is added, and only
+/// its entry in the index is kept until finish() is called.  A definition
+/// may thus be freed once it has been added, and when writing to a file,
+/// the memory used is bounded by the largest definition rather than by the
+/// size of the container.
+class BytecodeContainerWriter : public BytecodeContainerBase {
+public:
+  /// Write the container header to W.
+  BytecodeContainerWriter(ByteStreamWriterBase *W);
+
+  /// Declare a scope variable.  Definitions which are added later may refer
+  /// to Vd.  Scope variables must be declared in order of variable index.
+  void addScope(VarDecl *Vd);
+
+  /// Serialize E as a top-level definition.  Returns the definition index.
+  /// E is not referenced after this returns.
+  unsigned addDefinition(StringRef Name, SExpr *E);
+
+  /// Begin a module of the form (\self -> [ slots ]), where the record
+  /// inherits from Parent, if any.  The slots are then added one at a time
+  /// with addSlot, so that the module need not be built in memory.
+  void beginModule(VarDecl *Self, SExpr *Parent = nullptr);
+
+  /// Serialize a slot of the module.  Returns the definition index.
+  unsigned addSlot(Slot *S) { return addDefinition(S->slotName(), S); }
+
+  /// Serialize a module.  If E has the form (\self -> [ slots ]), then
+  /// self is declared as a scope variable, and each slot is a definition.
+  /// Otherwise, E is written as a single definition.
+  void writeModule(SExpr *E);
+
+  /// Write the string table, index, and trailer, and flush the stream.
+  void finish();
+
+  /// Write Code and Function bodies so that they can be read lazily.
+  /// See BytecodeWriter::setLazyBodies.
+  void setLazyBodies(bool B) { LazyBodies = B; }
+
+  unsigned numDefinitions() const { return Definitions.size(); }
+
+private:
+  struct ScopeEntry {
+    VarDecl::VariableKind Kind;
+    unsigned Name;
+    int64_t  TypeOffset;
+    int64_t  TypeSize;
+  };
+
+  struct CFGEntry {
+    int64_t Offset;
+    int64_t Size;
+    std::vector<std::pair<VarDecl::VariableKind, unsigned>> Vars;
+  };
+
+  struct DefinitionEntry {
+    unsigned Name;
+    int64_t  Offset;
+    int64_t  Size;
+    std::vector<CFGEntry> CFGs;
+  };
+
+  /// Return the index of S in the string table.
+  unsigned addString(StringRef S);
+
+  /// Serialize E into the body, and return its size.
+  int64_t writeStream(SExpr *E);
+
+  ByteStreamWriterBase *Writer;
+  bool     LazyBodies;
+  uint32_t Flags;
+  int64_t  ParentOffset;   // Parent of the module record, if any.
+  int64_t  ParentSize;
+
+  std::vector<ScopeEntry>      Scope;
+  std::vector<DefinitionEntry> Definitions;
+
+  std::vector<std::string> Strings;
+  std::unordered_map<std::string, unsigned> StringMap;
+};
+
+
+/// Reads definitions from a container on demand.
+/// The container must be entirely in memory (or mapped into memory).
+/// Strings in the decoded expressions point into the container, so the
+/// container data must outlive them.  A compressed container is
+/// decompressed into the arena when it is opened.
+class BytecodeContainerReader : public BytecodeContainerBase {
+public:
+  /// Read the index of the container stored in Data.
+  BytecodeContainerReader(const uint8_t *Data, int64_t Size, MemRegionRef A);
+
+  /// Map FileName into memory, and read its index.
+  /// The mapping is released when A is destroyed.
+  BytecodeContainerReader(const std::string &FileName, MemRegionRef A);
+
+  /// Return true if the container was read successfully.
+  bool valid() const { return Valid; }
+
+  /// Return true if the container holds the slots of a module.
+  bool isModule() const { return Flags & CF_Module; }
+
+  unsigned numDefinitions() const { return Definitions.size(); }
+
+  StringRef definitionName(unsigned i) const { return Definitions[i].Name; }
+
+  /// Return the bytecode stream of definition i, and its size in Size.
+  /// If the container has no scope variables, the stream can be decoded
+  /// by itself with a BytecodeReader.
+  const uint8_t* definitionData(unsigned i, int64_t *Size) const {
+    *Size = Definitions[i].Size;
+    return Data + Definitions[i].Offset;
+  }
+
+  /// Return the index of the definition with the given name, or -1.
+  int findDefinition(StringRef Name);
+
+  /// Decode definition i.
+  SExpr* readDefinition(unsigned i, CFGBuilder &B);
+
+  /// Number of SCFGs in definition i.
+  unsigned numCFGs(unsigned i) const { return Definitions[i].CFGs.size(); }
+
+  /// Decode the j-th SCFG of definition i, without decoding the rest of the
+  /// definition.  Variables which are bound within the definition, but
+  /// outside of the SCFG, are replaced with fresh declarations that have the
+  /// same name and kind, but no type.
+  SCFG* readCFG(unsigned i, unsigned j, CFGBuilder &B);
+
+  /// Decode all definitions.  If the container holds a module, this
+  /// reconstructs the module; otherwise it returns the first definition.
+  SExpr* readModule(CFGBuilder &B);
+
+  /// Decode the definitions of a module on up to N threads in readModule.
+  /// Each thread decodes into its own arena, which is owned by the arena of
+  /// the builder.  Literals are not shared through the builder's constant
+  /// pool.  0 means one thread per hardware thread.  The default is 1.
+  void setNumThreads(unsigned N) { NumThreads = N; }
+
+  /// Decode the scope variables.
+  void readScope(CFGBuilder &B, std::vector<VarDecl*> &Vars);
+
+  /// Decode Code and Function bodies on demand, if they were written lazily.
+  /// See BytecodeReader::setLazyBodies.
+  void setLazyBodies(bool B) {
+    LazyStats = B ? new (Arena) LazyBodyStats() : nullptr;
+  }
+
+  /// Return the lazy body counters, or null if bodies are read eagerly.
+  LazyBodyStats* lazyStats() { return LazyStats; }
+
+private:
+  struct ScopeEntry {
+    VarDecl::VariableKind Kind;
+    StringRef Name;
+    int64_t   TypeOffset;
+    int64_t   TypeSize;
+  };
+
+  struct CFGEntry {
+    int64_t Offset;
+    int64_t Size;
+    std::vector<std::pair<VarDecl::VariableKind, StringRef>> Vars;
+  };
+
+  struct DefinitionEntry {
+    DefinitionEntry() : Name("", 0), Offset(0), Size(0) { }
+
+    StringRef Name;
+    int64_t   Offset;
+    int64_t   Size;
+    std::vector<CFGEntry> CFGs;
+  };
+
+  void readIndex();
+
+  bool validSlice(int64_t Offset, int64_t Size) {
+    return Offset >= 0 && Size >= 0 && Offset + Size <= DataSize;
+  }
+
+  /// Decode the bytecode stream in the given slice of the container.
+  SExpr* readSlice(int64_t Offset, int64_t Size, CFGBuilder &B,
+                   const std::vector<VarDecl*> &Vars);
+
+  SExpr* readDefinition(unsigned i, CFGBuilder &B,
+                        const std::vector<VarDecl*> &Vars);
+
+  /// Decode every definition into Defs, on up to NumThreads threads.
+  void readDefinitions(CFGBuilder &B, const std::vector<VarDecl*> &Vars,
+                       std::vector<SExpr*> &Defs);
+
+  const uint8_t *Data;
+  int64_t   DataSize;
+  MemRegionRef Arena;
+  LazyBodyStats *LazyStats;
+  unsigned  NumThreads;
+  bool      Valid;
+  uint32_t  Flags;
+  int64_t   ParentOffset;
+  int64_t   ParentSize;
+
+  std::vector<ScopeEntry>      Scope;
+  std::vector<DefinitionEntry> Definitions;
+  std::unordered_map<std::string, unsigned> DefinitionMap;
+};
+
+
+}  // end namespace til
+}  // end namespace ohmu
+
+#endif  // OHMU_TIL_BYTECODECONTAINER_H
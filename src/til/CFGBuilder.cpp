@@ -97,10 +97,15 @@ void CFGBuilder::beginBlock(BasicBlock *B, bool Overwrite) {
   // We don't remove them yet, because a rewriter will need to traverse them.
   // They will be cleared from the block when endBlock() is called.
   if (Overwrite) {
-    for (auto& A : CurrentBB->arguments())
-      A->setBlock(nullptr);
-    for (auto& I : CurrentBB->instructions())
-      I->setBlock(nullptr);
+    // Instructions that were removed by an earlier pass may be null.
+    for (auto& A : CurrentBB->arguments()) {
+      if (A)
+        A->setBlock(nullptr);
+    }
+    for (auto& I : CurrentBB->instructions()) {
+      if (I)
+        I->setBlock(nullptr);
+    }
     if (CurrentBB->terminator())
       CurrentBB->terminator()->setBlock(nullptr);
     OverwriteCurrentBB = true;
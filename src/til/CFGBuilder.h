@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 
+#include "ConstantPool.h"
 #include "TIL.h"
 #include "TILTraverse.h"
 #include "TILPrettyPrint.h"
@@ -42,6 +43,31 @@ public:
   /// Return the memory pool used by this builder to create new instructions.
   MemRegionRef& arena() { return Arena; }
 
+  /// Return the pool used to share literals and scalar types, if any.
+  ConstantPool* constantPool() { return Constants; }
+
+  /// Share literals and scalar types using P, and return the old pool.
+  /// If P is null, then a new node is created for each constant.
+  ConstantPool* switchConstantPool(ConstantPool *P) {
+    auto *Temp = Constants;  Constants = P;  return Temp;
+  }
+
+  /// Return true if E is shared through the constant pool, so that it must
+  /// not be modified.
+  bool isSharedConstant(const SExpr *E) {
+    return Constants && Constants->contains(E);
+  }
+
+  /// Return E, or a private copy of E if it is a shared constant.  Use this
+  /// before annotating an expression which may be a constant.
+  SExpr* unshare(SExpr *E) {
+    if (!isSharedConstant(E))
+      return E;
+    if (auto *L = dyn_cast<Literal>(E))
+      return ConstantPool::copyLiteral(L, Arena);
+    return new (Arena) ScalarType(cast<ScalarType>(E)->baseType());
+  }
+
   /// Return the diagnostic emitter used by this builder.
   DiagnosticEmitter& diag()  { return Diag; }
 
@@ -138,6 +164,8 @@ public:
   }
 
   ScalarType* newScalarType(BaseType Bt) {
+    if (Constants)
+      return Constants->getScalarType(Bt);
     return new (Arena) ScalarType(Bt);
   }
   Literal* newLiteralVoid() {
@@ -145,6 +173,8 @@ public:
   }
   template<class T>
   LiteralT<T>* newLiteralT(T Val) {
+    if (Constants)
+      return Constants->getLiteralT<T>(Val);
     return new (Arena) LiteralT<T>(Val);
   }
   Variable* newVariable(VarDecl* Vd) {
@@ -258,17 +288,18 @@ public:
 
 
   CFGBuilder()
-    : CurrentCFG(nullptr), CurrentBB(nullptr), OverwriteCurrentBB(false),
-      OldCfgState(0, false)
+    : Constants(nullptr), CurrentCFG(nullptr), CurrentBB(nullptr),
+      OverwriteCurrentBB(false), OldCfgState(0, false)
   { }
   CFGBuilder(MemRegionRef A, bool Inplace = false)
-    : Arena(A), CurrentCFG(nullptr), CurrentBB(nullptr),
+    : Arena(A), Constants(nullptr), CurrentCFG(nullptr), CurrentBB(nullptr),
       OverwriteCurrentBB(false), OldCfgState(0, false)
   { }
   virtual ~CFGBuilder() { }
 
 protected:
   MemRegionRef               Arena;          ///< pool to create new instrs
+  ConstantPool*              Constants;      ///< shared constants, or null
   SCFG*                      CurrentCFG;     ///< current CFG
   BasicBlock*                CurrentBB;      ///< current basic block
   std::vector<Phi*>          CurrentArgs;    ///< arguments in CurrentBB.
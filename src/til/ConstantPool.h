@@ -0,0 +1,144 @@
+//===- ConstantPool.h ------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// A ConstantPool hash-conses literals and scalar types, so that there is only
+// one node for each distinct constant.  Equal constants from the same pool
+// can then be compared by pointer.
+//
+// Nodes in the pool are shared, and must be treated as immutable.  In
+// particular, they must not be annotated or added to a basic block.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_TIL_CONSTANTPOOL_H
+#define OHMU_TIL_CONSTANTPOOL_H
+
+#include "TIL.h"
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+
+namespace ohmu {
+namespace til  {
+
+
+class ConstantPool {
+public:
+  /// Return the literal of type T with value Val.
+  template<class T>
+  LiteralT<T>* getLiteralT(T Val) {
+    BaseType Bt = BaseType::getBaseType<T>();
+    Literal *&L = Literals[std::make_pair(Bt.asUInt16(), valueBits(Val))];
+    if (!L) {
+      L = new (Arena) LiteralT<T>(Val);
+      Shared.insert(L);
+    }
+    return L->as<T>();
+  }
+
+  /// Return the scalar type for Bt.
+  ScalarType* getScalarType(BaseType Bt) {
+    ScalarType *&Ty = ScalarTypes[Bt.asUInt16()];
+    if (!Ty) {
+      Ty = new (Arena) ScalarType(Bt);
+      Shared.insert(Ty);
+    }
+    return Ty;
+  }
+
+  /// Return true if E is a node in this pool.
+  bool contains(const SExpr *E) const { return Shared.count(E) > 0; }
+
+  /// Return a new, unshared copy of literal L, allocated in A.
+  static Literal* copyLiteral(const Literal *L, MemRegionRef A) {
+    Literal *C = BtBr<CopyLiteral>::branch(L->baseType(), L, A);
+    if (!C)
+      C = new (A) Literal(L->baseType());
+    return C;
+  }
+
+  /// Number of distinct literals in the pool.
+  unsigned numLiterals() const {
+    return Literals.size() + StringLiterals.size();
+  }
+
+  /// Number of distinct scalar types in the pool.
+  unsigned numScalarTypes() const { return ScalarTypes.size(); }
+
+  ConstantPool(MemRegionRef A) : Arena(A) { }
+
+private:
+  ConstantPool() = delete;
+  ConstantPool(const ConstantPool &P) = delete;
+
+  typedef std::pair<uint16_t, uint64_t> LiteralKey;
+
+  template<class T>
+  struct CopyLiteral {
+    typedef Literal* ReturnType;
+    static Literal* defaultAction(const Literal *L, MemRegionRef A) {
+      return nullptr;
+    }
+    static Literal* action(const Literal *L, MemRegionRef A) {
+      return new (A) LiteralT<T>(L->as<T>()->value());
+    }
+  };
+
+  struct LiteralKeyHash {
+    size_t operator()(const LiteralKey &K) const {
+      return std::hash<uint64_t>()(K.second) ^ (size_t(K.first) << 1);
+    }
+  };
+
+  // Literals are keyed on the bits of their value, so -0.0 and 0.0 are
+  // different constants.
+  template<class T>
+  static uint64_t valueBits(T Val) {
+    static_assert(sizeof(T) <= sizeof(uint64_t), "Literal is too large.");
+    uint64_t Bits = 0;
+    std::memcpy(&Bits, &Val, sizeof(T));
+    return Bits;
+  }
+
+  MemRegionRef Arena;
+  std::unordered_map<LiteralKey, Literal*, LiteralKeyHash> Literals;
+  std::unordered_map<std::string, Literal*>                StringLiterals;
+  std::unordered_map<uint16_t, ScalarType*>                ScalarTypes;
+  std::unordered_set<const SExpr*>                         Shared;
+};
+
+
+/// Strings are keyed on their contents.
+template<>
+inline LiteralT<StringRef>* ConstantPool::getLiteralT(StringRef Val) {
+  Literal *&L = StringLiterals[Val.str()];
+  if (!L) {
+    L = new (Arena) LiteralT<StringRef>(Val);
+    Shared.insert(L);
+  }
+  return L->as<StringRef>();
+}
+
+
+}  // end namespace til
+}  // end namespace ohmu
+
+#endif  // OHMU_TIL_CONSTANTPOOL_H
@@ -46,11 +46,17 @@ public:
 
   /// Enter a new CFG, mapping blocks from Orig to blocks in S.
   void enterCFG(SCFG *Orig, SCFG *S) {
+    enterCFG(Orig, S->entry(), S->exit());
+  }
+
+  /// Enter a new CFG, mapping the entry and exit of Orig to the given blocks.
+  /// (Used for inlining.)
+  void enterCFG(SCFG *Orig, BasicBlock *Entry, BasicBlock *Exit) {
     Super::enterCFG(Orig);
 
     BlockMap.resize(Orig->numBlocks(), nullptr);
-    insertBlockMap(Orig->entry(), S->entry());
-    insertBlockMap(Orig->exit(),  S->exit());
+    insertBlockMap(Orig->entry(), Entry);
+    insertBlockMap(Orig->exit(),  Exit);
   }
 
   void exitCFG() {
@@ -166,12 +172,28 @@ public:
     this->resultAttr() = this->scope()->instr(Idx);
   }
 
-  void reduceBBArgument(Phi *Ph) { }  // Arguments are handled in lookupBlock
+  // Arguments are created in lookupBlock(), so we just copy the type.
+  void reduceBBArgument(Phi *Ph) {
+    if (Ph->instrID() == 0)
+      return;
+    auto *Nph = dyn_cast_or_null<Phi>(this->scope()->instr(Ph->instrID()).Exp);
+    if (Nph)
+      copyBaseType(Nph, Ph);
+  }
 
   void reduceBBInstruction(Instruction *I) {
+    if (auto *Ni = dyn_cast_or_null<Instruction>(this->lastAttr().Exp))
+      copyBaseType(Ni, I);
     this->scope()->insertInstructionMap(I, std::move(this->lastAttr()));
   }
 
+  /// The reduce methods do not compute types.  When copying a CFG, copy the
+  /// type of Orig to I, unless I already has one.
+  void copyBaseType(Instruction *I, Instruction *Orig) {
+    if (I->baseType() == BaseType::getBaseType<void>())
+      I->setBaseType(Orig->baseType());
+  }
+
   void reduceVarDecl(VarDecl *Orig) {
     auto *E = this->attr(0).Exp;
     VarDecl *Nvd = Builder.newVarDecl(Orig->kind(), Orig->varName(), E);
@@ -252,7 +274,9 @@ public:
     unsigned Idx = Orig->variableDecl()->varIndex();
     if (this->scope()->isNull(Idx)) {
       // Null substitution: just copy the variable.
-      this->resultAttr() = Attr( Builder.newVariable(Orig->variableDecl()) );
+      auto *V = Builder.newVariable(Orig->variableDecl());
+      V->setBaseType(Orig->baseType());
+      this->resultAttr() = Attr(V);
     }
     else {
       // Substitute for variable.
@@ -325,7 +349,10 @@ public:
   }
 
   // Phi nodes are created in lookupBlock().
-  void reducePhi(Phi *Orig) { }
+  void reducePhi(Phi *Orig) {
+    if (Orig->instrID() > 0)
+      this->resultAttr() = this->scope()->instr(Orig->instrID());
+  }
 
   void reduceGoto(Goto *Orig) {
     BasicBlock *B = lookupBlock(Orig->targetBlock());
@@ -525,7 +552,10 @@ public:
     unsigned Af = self()->pushAttrFrame();
     self()->traverseAnnotationByKind(A);
     self()->restoreAttrFrame(Af);
-    self()->resultAttr().Exp->addAnnotation(self()->ResultAnn);
+    // Shared constants are immutable, so the annotation goes on a copy.
+    auto &Res = self()->resultAttr();
+    Res.Exp = self()->Builder.unshare(Res.Exp);
+    Res.Exp->addAnnotation(self()->ResultAnn);
   }
 
   /// Perform a lazy traversal.
@@ -18,6 +18,7 @@
 #ifndef OHMU_TIL_EVALUATOR_H
 #define OHMU_TIL_EVALUATOR_H
 
+#include "CFGBuilder.h"
 #include "TIL.h"
 
 namespace ohmu {
@@ -31,12 +32,12 @@ namespace til {
 template<class Ty1>                                                           \
 struct CName {                                                                \
   typedef Literal* ReturnType;                                                \
-  static Literal* defaultAction(MemRegionRef A, Literal*, Literal*) {         \
+  static Literal* defaultAction(CFGBuilder* B, Literal*, Literal*) {          \
     return nullptr;                                                           \
   }                                                                           \
-  static LiteralT<RTy>* action(MemRegionRef A, Literal* E0, Literal* E1) {    \
-    return new (A) LiteralT<RTy>(E0->as<Ty1>()->value()  OP                   \
-                                 E1->as<Ty1>()->value());                     \
+  static LiteralT<RTy>* action(CFGBuilder* B, Literal* E0, Literal* E1) {     \
+    return B->newLiteralT<RTy>(E0->as<Ty1>()->value()  OP                     \
+                               E1->as<Ty1>()->value());                       \
   }                                                                           \
 };
 
@@ -67,47 +68,91 @@ DEFINE_BINARY_OP_CLASS(LogicOr,  ||,  Ty1)
 #undef DEFINE_BINARY_OP_CLASS
 
 
-#define ARGS(OP) opclass::OP, Literal*, MemRegionRef, Literal*, Literal*
+#define DEFINE_UNARY_OP_CLASS(CName, OP)                                      \
+template<class Ty1>                                                           \
+struct CName {                                                                \
+  typedef Literal* ReturnType;                                                \
+  static Literal* defaultAction(CFGBuilder* B, Literal*) {                    \
+    return nullptr;                                                           \
+  }                                                                           \
+  static LiteralT<Ty1>* action(CFGBuilder* B, Literal* E0) {                  \
+    return B->newLiteralT<Ty1>(OP E0->as<Ty1>()->value());                    \
+  }                                                                           \
+};
+
+
+namespace opclass {
+
+DEFINE_UNARY_OP_CLASS(Negative,  -)
+DEFINE_UNARY_OP_CLASS(BitNot,    ~)
+DEFINE_UNARY_OP_CLASS(LogicNot,  !)
 
-Literal* evaluateBinaryOp(TIL_BinaryOpcode Op, BaseType Bt, MemRegionRef A,
-                          Literal* E0, Literal* E1) {
+}  // end namespace opclass
+
+#undef DEFINE_UNARY_OP_CLASS
+
+
+#define ARGS(OP) opclass::OP, Literal*, CFGBuilder*, Literal*, Literal*
+
+/// Evaluate a binary operation on literals.  The result is created by B,
+/// so it will be shared if B has a constant pool.
+inline Literal* evaluateBinaryOp(TIL_BinaryOpcode Op, BaseType Bt,
+                                 CFGBuilder* B, Literal* E0, Literal* E1) {
   switch (Op) {
     case BOP_Add:
-      return BtBr<opclass::Add>::branchOnNumeric(Bt, A, E0, E1);
+      return BtBr<opclass::Add>::branchOnNumeric(Bt, B, E0, E1);
     case BOP_Sub:
-      return BtBr<opclass::Sub>::branchOnNumeric(Bt, A, E0, E1);
+      return BtBr<opclass::Sub>::branchOnNumeric(Bt, B, E0, E1);
     case BOP_Mul:
-      return BtBr<opclass::Mul>::branchOnNumeric(Bt, A, E0, E1);
+      return BtBr<opclass::Mul>::branchOnNumeric(Bt, B, E0, E1);
     case BOP_Div:
-      return BtBr<opclass::Div>::branchOnNumeric(Bt, A, E0, E1);
+      return BtBr<opclass::Div>::branchOnNumeric(Bt, B, E0, E1);
     case BOP_Rem:
-      return BtBr<opclass::Rem>::branchOnIntegral(Bt, A, E0, E1);
+      return BtBr<opclass::Rem>::branchOnIntegral(Bt, B, E0, E1);
     case BOP_Shl:
-      return BtBr<opclass::Shl>::branchOnIntegral(Bt, A, E0, E1);
+      return BtBr<opclass::Shl>::branchOnIntegral(Bt, B, E0, E1);
     case BOP_Shr:
-      return BtBr<opclass::Shr>::branchOnIntegral(Bt, A, E0, E1);
+      return BtBr<opclass::Shr>::branchOnIntegral(Bt, B, E0, E1);
     case BOP_BitAnd:
-      return BtBr<opclass::BitAnd>::branchOnIntegral(Bt, A, E0, E1);
+      return BtBr<opclass::BitAnd>::branchOnIntegral(Bt, B, E0, E1);
     case BOP_BitXor:
-      return BtBr<opclass::BitXor>::branchOnIntegral(Bt, A, E0, E1);
+      return BtBr<opclass::BitXor>::branchOnIntegral(Bt, B, E0, E1);
     case BOP_BitOr:
-      return BtBr<opclass::BitOr>::branchOnIntegral(Bt, A, E0, E1);
+      return BtBr<opclass::BitOr>::branchOnIntegral(Bt, B, E0, E1);
     case BOP_Eq:
-      return BtBr<opclass::Eq>::branch(Bt, A, E0, E1);
+      return BtBr<opclass::Eq>::branch(Bt, B, E0, E1);
     case BOP_Neq:
-      return BtBr<opclass::Neq>::branch(Bt, A, E0, E1);
+      return BtBr<opclass::Neq>::branch(Bt, B, E0, E1);
     case BOP_Lt:
-      return BtBr<opclass::Lt>::branchOnNumeric(Bt, A, E0, E1);
+      return BtBr<opclass::Lt>::branchOnNumeric(Bt, B, E0, E1);
     case BOP_Leq:
-      return BtBr<opclass::Leq>::branchOnNumeric(Bt, A, E0, E1);
+      return BtBr<opclass::Leq>::branchOnNumeric(Bt, B, E0, E1);
     case BOP_Gt:
-      return BtBr<opclass::Lt>::branchOnNumeric(Bt, A, E1, E0);
+      return BtBr<opclass::Lt>::branchOnNumeric(Bt, B, E1, E0);
     case BOP_Geq:
-      return BtBr<opclass::Leq>::branchOnNumeric(Bt, A, E1, E0);
+      return BtBr<opclass::Leq>::branchOnNumeric(Bt, B, E1, E0);
     case BOP_LogicAnd:
-      return opclass::LogicAnd<bool>::action(A, E0, E1);
+      return opclass::LogicAnd<bool>::action(B, E0, E1);
     case BOP_LogicOr:
-      return opclass::LogicOr<bool>::action(A, E0, E1);
+      return opclass::LogicOr<bool>::action(B, E0, E1);
+  }
+  return nullptr;
+}
+
+
+/// Evaluate a unary operation on a literal.  The result is created by B,
+/// so it will be shared if B has a constant pool.
+inline Literal* evaluateUnaryOp(TIL_UnaryOpcode Op, BaseType Bt,
+                                CFGBuilder* B, Literal* E0) {
+  switch (Op) {
+    case UOP_Negative:
+      return BtBr<opclass::Negative>::branchOnNumeric(Bt, B, E0);
+    case UOP_BitNot:
+      return BtBr<opclass::BitNot>::branchOnIntegral(Bt, B, E0);
+    case UOP_LogicNot:
+      if (Bt.Base != BaseType::BT_Bool)
+        return nullptr;
+      return opclass::LogicNot<bool>::action(B, E0);
   }
   return nullptr;
 }
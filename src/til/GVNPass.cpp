@@ -0,0 +1,265 @@
+//===- GVNPass.cpp ---------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GVNPass.h"
+#include "TILCompare.h"
+
+namespace ohmu {
+namespace til  {
+
+
+/// ValueComparator checks whether two instructions compute the same value.
+/// Operands which are instructions in the CFG are compared by identity, since
+/// they have already been replaced by their value numbers; other operands
+/// are compared structurally.  Annotations are ignored.
+class ValueComparator : public DefaultComparator<ValueComparator, bool> {
+public:
+  void compareBaseTypes(BaseType b, BaseType c)       { if (b != c) fail(); }
+
+  template <class Lit>
+  void compareScalarValues (Lit i, Lit j)             { if (i != j) fail(); }
+
+  void compareOpcodes  (TIL_Opcode O, TIL_Opcode P)   { if (O != P) fail(); }
+
+  void compareWeakRefs(const VarDecl* V1, const VarDecl* V2) {
+    if (V1 != V2) fail();
+  }
+
+  void compareSExpr(const SExpr *E1, const SExpr *E2) {
+    if (E1 != E2 && E1 && E2 &&
+        (E1->asCFGInstruction() || E2->asCFGInstruction())) {
+      fail();
+      return;
+    }
+    DefaultComparator::compareSExpr(E1, E2);
+  }
+
+  template <class Ann>
+  bool ignoreAnnotation(const Ann *A) { return true; }
+
+  static bool compareValues(const Instruction *I1, const Instruction *I2) {
+    if (I1->opcode() != I2->opcode() || I1->baseType() != I2->baseType())
+      return false;
+    ValueComparator Vc;
+    Vc.compareByCase(I1, I2);
+    return Vc.SuccessState;
+  }
+
+public:
+  bool SuccessState;
+
+  void fail() { SuccessState = false; }
+
+  bool success() { return SuccessState; }
+
+  ValueComparator() : SuccessState(true) { }
+};
+
+
+
+static inline size_t hashCombine(size_t H, size_t V) {
+  return H ^ (V + 0x9e3779b9 + (H << 6) + (H >> 2));
+}
+
+// Hash an operand.  Instructions are hashed by ID; other expressions are only
+// distinguished by opcode, and are compared with ValueComparator.
+static size_t hashOperand(const SExpr *E) {
+  if (!E)
+    return 0;
+  if (const Instruction *I = E->asCFGInstruction())
+    return hashCombine(1, I->instrID());
+  if (auto *V = dyn_cast<Variable>(E))
+    return hashCombine(2, reinterpret_cast<size_t>(V->variableDecl()));
+  return hashCombine(3, E->opcode());
+}
+
+
+
+void GVNPass::traverseSCFG(SCFG *Cfg) {
+  enterCFG(Cfg);
+
+  // Build the dominator tree; blocks without a dominator are roots.
+  unsigned Nb = Cfg->numBlocks();
+  std::vector<std::vector<BasicBlock*>> Children(Nb);
+  std::vector<BasicBlock*> Stack;
+  for (auto &B : Cfg->blocks()) {
+    if (BasicBlock *P = B->parent())
+      Children[P->blockID()].push_back(B.get());
+  }
+  for (auto &B : Cfg->blocks().reverse()) {
+    if (!B->parent())
+      Stack.push_back(B.get());
+  }
+
+  // Visit the tree in preorder.  Children are pushed in reverse, so that
+  // siblings are visited in block order.
+  while (!Stack.empty()) {
+    BasicBlock *B = Stack.back();
+    Stack.pop_back();
+    traverse(B, TRV_Decl);
+    auto &Cs = Children[B->blockID()];
+    Stack.insert(Stack.end(), Cs.rbegin(), Cs.rend());
+  }
+
+  reduceSCFG(Cfg);
+  exitCFG(Cfg);
+}
+
+
+void GVNPass::exitCFG(SCFG *Cfg) {
+  Table.clear();
+  ScopeStack.clear();
+  UndoLog.clear();
+  AvailableLoads.clear();
+  Super::exitCFG(Cfg);
+}
+
+
+void GVNPass::enterBlock(BasicBlock *B) {
+  // Pop blocks that do not dominate B, and remove their values.
+  while (!ScopeStack.empty() && !ScopeStack.back().first->dominates(*B)) {
+    size_t Sz = ScopeStack.back().second;
+    while (UndoLog.size() > Sz) {
+      auto Range = Table.equal_range(UndoLog.back().first);
+      for (auto It = Range.first; It != Range.second; ++It) {
+        if (It->second == UndoLog.back().second) {
+          Table.erase(It);
+          break;
+        }
+      }
+      UndoLog.pop_back();
+    }
+    ScopeStack.pop_back();
+  }
+  ScopeStack.push_back(std::make_pair(B, UndoLog.size()));
+
+  AvailableLoads.clear();
+
+  Super::enterBlock(B);
+}
+
+
+void GVNPass::reduceBBInstruction(Instruction *I) {
+  // Only instructions which have been rewritten in place are candidates.
+  if (lastAttr().Exp == I) {
+    if (Instruction *V = lookupValue(I)) {
+      lastAttr().Exp = V;
+      ++NumInstrsRemoved;
+    }
+  }
+  Super::reduceBBInstruction(I);
+}
+
+
+void GVNPass::reduceVariable(Variable *Orig) {
+  // Variables are never substituted.
+  resultAttr().Exp = Orig;
+}
+
+
+void GVNPass::reduceCall(Call *Orig) {
+  Super::reduceCall(Orig);
+  AvailableLoads.clear();
+}
+
+
+void GVNPass::reduceStore(Store *Orig) {
+  Super::reduceStore(Orig);
+  AvailableLoads.clear();
+}
+
+
+Instruction* GVNPass::lookupValue(Instruction *I) {
+  if (auto *L = dyn_cast<Load>(I)) {
+    for (auto *L2 : AvailableLoads) {
+      if (ValueComparator::compareValues(L, L2))
+        return L2;
+    }
+    AvailableLoads.push_back(L);
+    return nullptr;
+  }
+
+  size_t H;
+  if (!hashValue(I, &H))
+    return nullptr;
+
+  auto Range = Table.equal_range(H);
+  for (auto It = Range.first; It != Range.second; ++It) {
+    if (ValueComparator::compareValues(I, It->second))
+      return It->second;
+  }
+  Table.insert(std::make_pair(H, I));
+  UndoLog.push_back(std::make_pair(H, I));
+  return nullptr;
+}
+
+
+bool GVNPass::hashValue(Instruction *I, size_t *H) {
+  size_t Hv = hashCombine(I->opcode(), I->baseType().asUInt16());
+
+  switch (I->opcode()) {
+  case COP_Project: {
+    auto *P = cast<Project>(I);
+    StringRef Nm = P->slotName();
+    for (unsigned i = 0, n = Nm.size(); i < n; ++i)
+      Hv = hashCombine(Hv, Nm.data()[i]);
+    Hv = hashCombine(Hv, hashOperand(P->record()));
+    break;
+  }
+  case COP_ArrayIndex: {
+    auto *Ai = cast<ArrayIndex>(I);
+    Hv = hashCombine(Hv, hashOperand(Ai->array()));
+    Hv = hashCombine(Hv, hashOperand(Ai->index()));
+    break;
+  }
+  case COP_ArrayAdd: {
+    auto *Aa = cast<ArrayAdd>(I);
+    Hv = hashCombine(Hv, hashOperand(Aa->array()));
+    Hv = hashCombine(Hv, hashOperand(Aa->index()));
+    break;
+  }
+  case COP_UnaryOp: {
+    auto *Uo = cast<UnaryOp>(I);
+    Hv = hashCombine(Hv, Uo->unaryOpcode());
+    Hv = hashCombine(Hv, hashOperand(Uo->expr()));
+    break;
+  }
+  case COP_BinaryOp: {
+    auto *Bo = cast<BinaryOp>(I);
+    Hv = hashCombine(Hv, Bo->binaryOpcode());
+    Hv = hashCombine(Hv, hashOperand(Bo->expr0()));
+    Hv = hashCombine(Hv, hashOperand(Bo->expr1()));
+    break;
+  }
+  case COP_Cast: {
+    auto *Ca = cast<Cast>(I);
+    Hv = hashCombine(Hv, Ca->castOpcode());
+    Hv = hashCombine(Hv, hashOperand(Ca->expr()));
+    break;
+  }
+  default:
+    // Other instructions have side effects, or are not worth numbering.
+    return false;
+  }
+
+  *H = Hv;
+  return true;
+}
+
+
+}  // end namespace til
+}  // end namespace ohmu
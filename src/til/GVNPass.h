@@ -0,0 +1,96 @@
+//===- GVNPass.h -----------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Implements global value numbering on CFGs in SSA form.
+//
+// Blocks are visited in a depth-first preorder of the dominator tree, so the
+// values of a block remain available in every block that it dominates.  Each
+// pure instruction is hashed on its opcode, sub-opcode, type, and operands,
+// where operands that are instructions are identified by instrID.  If an
+// equivalent instruction is found in a dominating block, then all uses of
+// the instruction are replaced with the earlier one, and the instruction is
+// removed from the CFG.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_TIL_GVNPASS_H
+#define OHMU_TIL_GVNPASS_H
+
+#include "InplaceReducer.h"
+
+#include <unordered_map>
+#include <vector>
+
+
+namespace ohmu {
+namespace til  {
+
+
+class GVNPass : public InplaceReducer<CopyAttr>,
+                public AGTraversal<GVNPass> {
+public:
+  void traverseSCFG(SCFG *Cfg);
+  void exitCFG(SCFG *Cfg);
+  void enterBlock(BasicBlock *B);
+
+  void reduceBBInstruction(Instruction *I);
+  void reduceVariable(Variable *Orig);
+  void reduceCall(Call *Orig);
+  void reduceStore(Store *Orig);
+
+  /// Number of redundant instructions that were removed.
+  unsigned numInstrsRemoved() const { return NumInstrsRemoved; }
+
+public:
+  GVNPass(MemRegionRef A)
+      : InplaceReducer(A), NumInstrsRemoved(0) { }
+
+private:
+  typedef InplaceReducer<CopyAttr> Super;
+  typedef std::unordered_multimap<size_t, Instruction*> ValueTable;
+
+  GVNPass() = delete;
+
+  // Return an equivalent instruction that dominates I, or add I to the table
+  // and return nullptr if there is none.
+  Instruction* lookupValue(Instruction *I);
+
+  // Return false if I cannot be value numbered.
+  bool hashValue(Instruction *I, size_t *H);
+
+  ValueTable Table;
+
+  // Table entries are removed when leaving the dominator subtree of the
+  // block which added them.  ScopeStack holds the chain of dominators of the
+  // current block, with the size of UndoLog when each one was entered.
+  // UndoLog holds the entries themselves, since inserting into the table
+  // may invalidate iterators.
+  std::vector<std::pair<BasicBlock*, size_t>> ScopeStack;
+  std::vector<std::pair<size_t, Instruction*>> UndoLog;
+
+  // Loads are only equivalent if there is no intervening store or call.
+  // We don't track memory across blocks, so this is cleared on each block.
+  std::vector<Load*> AvailableLoads;
+
+  unsigned NumInstrsRemoved;
+};
+
+
+}  // end namespace til
+}  // end namespace ohmu
+
+#endif  // OHMU_TIL_GVNPASS_H
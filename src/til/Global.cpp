@@ -24,7 +24,7 @@ namespace til  {
 
 template<class T>
 inline Slot* scalarTypeSlot(Global &G, StringRef Name) {
-  auto* Ty = new (G.LangArena) ScalarType(BaseType::getBaseType<T>());
+  auto* Ty = G.Constants.getScalarType(BaseType::getBaseType<T>());
   auto* Slt = new (G.ParseArena) Slot(Name, Ty);
   Slt->setModifier(Slot::SLT_Final);
   return Slt;
@@ -74,8 +74,10 @@ void Global::addDefinitions(std::vector<SExpr*>& Defs) {
 }
 
 
-void Global::lower() {
+void Global::lower(bool SpecializeCalls) {
   TypedEvaluator eval(DefArena);
+  eval.setSpecializeCalls(SpecializeCalls);
+  eval.setConstantPool(&Constants);
   SExpr* E = eval.traverseAll(GlobalSFun);
 
   // Replace the global definitions with lowered versions.
@@ -18,6 +18,7 @@
 #ifndef OHMU_TIL_GLOBAL_H
 #define OHMU_TIL_GLOBAL_H
 
+#include "ConstantPool.h"
 #include "TIL.h"
 
 #include <ostream>
@@ -31,7 +32,7 @@ public:
   Global()
       : GlobalRec(nullptr), GlobalSFun(nullptr),
         LangArena(&LangRegion), StringArena(&StringRegion),
-        ParseArena(&ParseRegion), DefArena(&DefRegion)
+        ParseArena(&ParseRegion), DefArena(&DefRegion), Constants(LangArena)
   { }
 
   inline SExpr* global() { return GlobalSFun; }
@@ -42,7 +43,9 @@ public:
   void addDefinitions(std::vector<SExpr*> &Defs);
 
   // Lower the parsed definitions.
-  void lower();
+  // If SpecializeCalls is true, then calls with literal arguments will be
+  // redirected to specialized versions of the called code.
+  void lower(bool SpecializeCalls = false);
 
   // Dump outputs to the given stream
   void print(std::ostream &SS);
@@ -62,6 +65,9 @@ public:
   MemRegionRef StringArena;
   MemRegionRef ParseArena;
   MemRegionRef DefArena;
+
+  // Literals and scalar types are shared by all definitions.
+  ConstantPool Constants;
 };
 
 
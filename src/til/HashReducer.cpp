@@ -0,0 +1,218 @@
+//===- HashReducer.cpp -----------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "HashReducer.h"
+#include "TILCompare.h"
+
+#include <cstring>
+
+
+namespace ohmu {
+namespace til  {
+
+
+uint64_t HashReducer::hash(const SExpr *E) {
+  if (!E)
+    return 0;
+  // The traversal does not modify E.
+  SExpr *Ex = const_cast<SExpr*>(E);
+  if (Instruction *I = Ex->asCFGInstruction())
+    traverse(I, TRV_Decl);
+  else
+    traverse(Ex, TRV_Decl);
+  uint64_t H = lastAttr().Hash;
+  popAttr();
+  return H;
+}
+
+
+bool HashReducer::equals(const SExpr *E1, const SExpr *E2) {
+  if (E1 == E2)
+    return true;
+  if (hash(E1) != hash(E2))
+    return false;
+  return EqualsComparator::compareExprs(E1, E2);
+}
+
+
+uint64_t HashReducer::hashString(StringRef S) {
+  // FNV-1a
+  uint64_t H = 0xcbf29ce484222325ULL;
+  for (unsigned i = 0, n = S.size(); i < n; ++i) {
+    H ^= static_cast<unsigned char>(S.data()[i]);
+    H *= 0x100000001b3ULL;
+  }
+  return H;
+}
+
+
+uint64_t HashReducer::hashValue(double V) {
+  if (V == 0)
+    V = 0;   // -0.0 == 0.0
+  uint64_t H;
+  std::memcpy(&H, &V, sizeof(H));
+  return H;
+}
+
+
+void HashReducer::reduceChildren(SExpr *E, uint64_t V) {
+  uint64_t H = combine(E->opcode(), V);
+  for (unsigned i = 0, n = numAttrs(); i < n; ++i)
+    H = combine(H, attr(i).Hash);
+  resultAttr().Hash = H;
+}
+
+
+void HashReducer::traverseFuture(Future *E) {
+  if (SExpr *Res = E->getResult()) {
+    traverseArg(Res, TRV_Decl);
+    reduceFuture(E);
+  }
+  else {
+    resultAttr().Hash = combine(COP_Future, reinterpret_cast<uintptr_t>(E));
+    ++NumUnforced;
+  }
+}
+
+
+void HashReducer::reduceWeak(Instruction *Orig) {
+  // The comparator compares instructions structurally, but we don't want to
+  // hash the whole instruction again.
+  resultAttr().Hash = combine(COP_Variable + 0x100, Orig->opcode());
+}
+
+
+void HashReducer::reduceVarDecl(VarDecl *Orig) {
+  reduceChildren(Orig, Orig->kind());
+}
+
+
+void HashReducer::reduceSlot(Slot *Orig) {
+  reduceChildren(Orig, hashString(Orig->slotName()));
+}
+
+
+void HashReducer::reduceScalarType(ScalarType *Orig) {
+  reduceChildren(Orig, Orig->baseType().asUInt16());
+}
+
+
+void HashReducer::reduceSCFG(SCFG *Orig) {
+  reduceChildren(Orig, combine(Orig->numBlocks(), Orig->numInstructions()));
+}
+
+
+void HashReducer::reduceBasicBlock(BasicBlock *Orig) {
+  uint64_t V = combine(Orig->numArguments(), Orig->numInstructions());
+  V = combine(V, Orig->numPredecessors());
+  V = combine(V, Orig->numSuccessors());
+  reduceChildren(Orig, V);
+}
+
+
+void HashReducer::reduceLiteral(Literal *Orig) {
+  reduceChildren(Orig, Orig->baseType().asUInt16());
+}
+
+
+void HashReducer::reduceVariable(Variable *Orig) {
+  VarDecl *Vd = Orig->variableDecl();
+  if (Vd->kind() != VarDecl::VK_Let) {
+    // Parameters are equal to any parameter in the same position, and free
+    // parameters are compared by type, so we only hash the kind.
+    reduceChildren(Orig, Vd->kind());
+    return;
+  }
+  // A let-variable is equal to its definition.
+  traverseArg(Vd->definition(), TRV_Decl);
+  uint64_t H = lastAttr().Hash;
+  popAttr();
+  resultAttr().Hash = H;
+}
+
+
+void HashReducer::reduceProject(Project *Orig) {
+  reduceChildren(Orig, hashString(Orig->slotName()));
+}
+
+
+void HashReducer::reduceAlloc(Alloc *Orig) {
+  reduceChildren(Orig, Orig->allocKind());
+}
+
+
+void HashReducer::reduceUnaryOp(UnaryOp *Orig) {
+  reduceChildren(Orig, Orig->unaryOpcode());
+}
+
+
+void HashReducer::reduceBinaryOp(BinaryOp *Orig) {
+  reduceChildren(Orig, Orig->binaryOpcode());
+}
+
+
+void HashReducer::reduceCast(Cast *Orig) {
+  reduceChildren(Orig, Orig->castOpcode());
+}
+
+
+void HashReducer::reducePhi(Phi *Orig) {
+  reduceChildren(Orig, combine(Orig->values().size(), Orig->status()));
+}
+
+
+void HashReducer::reduceGoto(Goto *Orig) {
+  reduceChildren(Orig, Orig->phiIndex());
+}
+
+
+void HashReducer::reduceIdentifier(Identifier *Orig) {
+  reduceChildren(Orig, hashString(Orig->idString()));
+}
+
+
+void HashReducer::reduceLet(Let *Orig) {
+  // let x = e; body is equal to body.
+  resultAttr().Hash = attr(1).Hash;
+}
+
+
+
+SExpr* ExprTable::insert(SExpr *E) {
+  uint64_t H = Hasher.hash(E);
+  auto Range = Table.equal_range(H);
+  for (auto It = Range.first; It != Range.second; ++It) {
+    if (EqualsComparator::compareExprs(E, It->second))
+      return It->second;
+  }
+  Table.insert(std::make_pair(H, E));
+  return E;
+}
+
+
+SExpr* ExprTable::lookup(const SExpr *E) {
+  auto Range = Table.equal_range(Hasher.hash(E));
+  for (auto It = Range.first; It != Range.second; ++It) {
+    if (EqualsComparator::compareExprs(E, It->second))
+      return It->second;
+  }
+  return nullptr;
+}
+
+
+}  // end namespace til
+}  // end namespace ohmu
@@ -0,0 +1,225 @@
+//===- HashReducer.h -------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Implements structural hashing of SExprs.
+//
+// The hash is consistent with EqualsComparator: if two expressions are equal
+// up to alpha-renaming and let-bindings, then they have the same hash.  Thus
+// comparisons can be skipped when hashes differ.  To ensure this, the hash
+// ignores anything that the comparator may treat as equal:
+//  - variable names, and the identity of function parameters,
+//  - let-expressions, which hash as their body,
+//  - let-variables, which hash as their definition,
+//  - weak references to CFG instructions, which hash as their opcode,
+//  - annotations.
+//
+// The hash of an expression does not depend on its context, so hashes are
+// cached for each node that has been traversed.  An unforced future hashes
+// by identity, and its hash changes when it is forced, so nodes which
+// contain an unforced future are not cached.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_TIL_HASHREDUCER_H
+#define OHMU_TIL_HASHREDUCER_H
+
+#include "AttributeGrammar.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+
+namespace ohmu {
+namespace til  {
+
+
+/// The synthesized attribute for HashReducer.
+class HashAttr {
+public:
+  HashAttr() : Hash(0) { }
+  HashAttr(uint64_t H) : Hash(H) { }
+
+  uint64_t Hash;
+};
+
+
+/// HashReducer computes a 64-bit structural hash for SExprs.
+class HashReducer : public AttributeGrammar<HashAttr, ScopeFrame<HashAttr>>,
+                    public AGTraversal<HashReducer> {
+public:
+  typedef AGTraversal<HashReducer> SuperTv;
+
+  /// Return the hash of E.
+  uint64_t hash(const SExpr *E);
+
+  /// Return true if E1 and E2 are equal according to EqualsComparator.
+  /// The full comparison is skipped if E1 and E2 have different hashes.
+  bool equals(const SExpr *E1, const SExpr *E2);
+
+  /// Hash E, using a fresh cache.
+  static uint64_t hashExpr(const SExpr *E) {
+    HashReducer Hr;
+    return Hr.hash(E);
+  }
+
+  /// Forget all cached hashes.
+  void clear() { Cache.clear(); }
+
+  /// Look up the hash of E in the cache, or traverse E.
+  template <class T>
+  void traverse(T *E, TraversalKind K) {
+    auto It = Cache.find(E);
+    if (It != Cache.end()) {
+      pushAttr()->Hash = It->second;
+      return;
+    }
+    unsigned N = NumUnforced;
+    SuperTv::traverse(E, K);
+    if (NumUnforced == N)
+      Cache[E] = lastAttr().Hash;
+  }
+
+  /// Don't force futures; an unevaluated future hashes by identity.
+  void traverseFuture(Future *E);
+
+  /// Annotations are ignored.
+  void traverseAllAnnotations(Annotation *A) { }
+
+  /// The hash does not depend on lexical scope.
+  void enterScope(VarDecl *Vd)   { }
+  void exitScope (VarDecl *Vd)   { }
+  void enterCFG  (SCFG *Cfg)     { }
+  void exitCFG   (SCFG *Cfg)     { }
+  void enterBlock(BasicBlock *B) { }
+  void exitBlock (BasicBlock *B) { }
+
+  void reduceNull()                      { resultAttr().Hash = 0; }
+  void reduceWeak(Instruction *Orig);
+  void reduceBBArgument(Phi *Orig)       { }
+  void reduceBBInstruction(Instruction *Orig) { }
+
+  void reduceVarDecl(VarDecl *Orig);
+  void reduceFunction(Function *Orig)    { reduceChildren(Orig); }
+  void reduceCode(Code *Orig)            { reduceChildren(Orig); }
+  void reduceField(Field *Orig)          { reduceChildren(Orig); }
+  void reduceSlot(Slot *Orig);
+  void reduceRecord(Record *Orig)        { reduceChildren(Orig); }
+  void reduceArray(Array *Orig)          { reduceChildren(Orig); }
+  void reduceScalarType(ScalarType *Orig);
+
+  void reduceSCFG(SCFG *Orig);
+  void reduceBasicBlock(BasicBlock *Orig);
+
+  void reduceLiteral(Literal *Orig);
+  template<class T>
+  void reduceLiteralT(LiteralT<T> *Orig);
+
+  void reduceVariable(Variable *Orig);
+  void reduceApply(Apply *Orig)          { reduceChildren(Orig); }
+  void reduceProject(Project *Orig);
+  void reduceCall(Call *Orig)            { reduceChildren(Orig); }
+  void reduceAlloc(Alloc *Orig);
+  void reduceLoad(Load *Orig)            { reduceChildren(Orig); }
+  void reduceStore(Store *Orig)          { reduceChildren(Orig); }
+  void reduceArrayIndex(ArrayIndex *Orig) { reduceChildren(Orig); }
+  void reduceArrayAdd(ArrayAdd *Orig)    { reduceChildren(Orig); }
+  void reduceUnaryOp(UnaryOp *Orig);
+  void reduceBinaryOp(BinaryOp *Orig);
+  void reduceCast(Cast *Orig);
+
+  void reducePhi(Phi *Orig);
+  void reduceGoto(Goto *Orig);
+  void reduceBranch(Branch *Orig)        { reduceChildren(Orig); }
+  void reduceSwitch(Switch *Orig)        { reduceChildren(Orig); }
+  void reduceReturn(Return *Orig)        { reduceChildren(Orig); }
+
+  void reduceFuture(Future *Orig)        { reduceChildren(Orig); }
+  void reduceUndefined(Undefined *Orig)  { reduceChildren(Orig); }
+  void reduceWildcard(Wildcard *Orig)    { reduceChildren(Orig); }
+  void reduceIdentifier(Identifier *Orig);
+  void reduceLet(Let *Orig);
+  void reduceIfThenElse(IfThenElse *Orig) { reduceChildren(Orig); }
+
+  template <class T>
+  void reduceAnnotationT(T *A) { }
+
+  HashReducer()
+    : AttributeGrammar(new ScopeFrame<HashAttr>()), NumUnforced(0) { }
+
+private:
+  static uint64_t combine(uint64_t H, uint64_t V) {
+    return H ^ (V + 0x9e3779b97f4a7c15ULL + (H << 6) + (H >> 2));
+  }
+
+  static uint64_t hashString(StringRef S);
+
+  // Hash the value of a literal.  Values that compare equal must have equal
+  // hashes, so both zeros hash the same.
+  template<class T>
+  static uint64_t hashValue(T V) { return static_cast<uint64_t>(V); }
+  static uint64_t hashValue(float V)     { return hashValue(double(V)); }
+  static uint64_t hashValue(double V);
+  static uint64_t hashValue(StringRef V) { return hashString(V); }
+  static uint64_t hashValue(void *V) {
+    return reinterpret_cast<uintptr_t>(V);
+  }
+
+  // Combine the opcode of E, the scalar value V, and the hashes of the
+  // subexpressions of E.
+  void reduceChildren(SExpr *E, uint64_t V = 0);
+
+  std::unordered_map<const SExpr*, uint64_t> Cache;
+  unsigned NumUnforced;   // Number of unforced futures hashed so far.
+};
+
+
+template<class T>
+void HashReducer::reduceLiteralT(LiteralT<T> *Orig) {
+  reduceChildren(Orig, combine(Orig->baseType().asUInt16(),
+                               hashValue(Orig->value())));
+}
+
+
+/// ExprTable hash-conses expressions; each expression that is inserted is
+/// mapped to the first expression that is equal to it.
+class ExprTable {
+public:
+  /// Return an expression that was previously inserted, and is equal to E
+  /// according to EqualsComparator.  If there is none, insert E and return it.
+  SExpr* insert(SExpr *E);
+
+  /// Return an expression equal to E, or nullptr if there is none.
+  SExpr* lookup(const SExpr *E);
+
+  /// Return the number of distinct expressions in the table.
+  size_t size() const { return Table.size(); }
+
+  void clear() {
+    Table.clear();
+    Hasher.clear();
+  }
+
+private:
+  HashReducer Hasher;
+  std::unordered_multimap<uint64_t, SExpr*> Table;
+};
+
+
+}  // end namespace til
+}  // end namespace ohmu
+
+#endif  // OHMU_TIL_HASHREDUCER_H
@@ -0,0 +1,244 @@
+//===- Inliner.cpp ---------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Inliner.h"
+
+#include <algorithm>
+
+
+namespace ohmu {
+namespace til  {
+
+
+void InlineCopier::copyCFG(SCFG *Callee, SCFG *Cfg, BasicBlock *Entry,
+                           BasicBlock *Exit) {
+  Builder.beginCFG(Cfg);
+  scope()->enterCFG(Callee, Entry, Exit);
+
+  for (auto &B : Callee->blocks()) {
+    // Blocks are in topological order, so reachable blocks have already been
+    // created by a jump.  The exit block is replaced by Exit.
+    if (B.get() == Callee->exit() || !scope()->lookupBlock(B.get()))
+      continue;
+    traverse(B.get(), TRV_Decl);
+    popAttr();
+  }
+  scope()->exitCFG();
+
+  // Force any SExprs that were rewritten lazily.
+  while (!FutureQueue.empty()) {
+    auto *F = FutureQueue.front();
+    FutureQueue.pop();
+    F->force();
+  }
+  clearAttrFrames();
+}
+
+
+
+void Inliner::exitCFG(SCFG *Cfg) {
+  auto* Ncfg = Builder.currentCFG();
+  Super::exitCFG(Cfg);
+
+  // Recompute block order, dominators, and loop depths.
+  if (Ncfg)
+    Ncfg->computeNormalForm();
+}
+
+
+void Inliner::reduceCall(Call *Orig) {
+  std::vector<SExpr*> Args;
+  unsigned FirstParam = 0;
+  Code *C = resolveCallee(attr(0).Exp, Args, &FirstParam);
+  if (!C || !shouldInline(Orig, C)) {
+    Super::reduceCall(Orig);
+    return;
+  }
+  resultAttr().Exp = inlineCall(Orig, cast<SCFG>(C->body()), FirstParam, Args);
+  ++NumCallsInlined;
+}
+
+
+Code* Inliner::resolveCallee(SExpr *Target, std::vector<SExpr*> &Args,
+                             unsigned *FirstParam) {
+  SExpr *E = Target;
+  while (auto *Ap = dyn_cast_or_null<Apply>(E)) {
+    if (Ap->applyKind() != Apply::FAK_Apply)
+      return nullptr;
+    Args.push_back(Ap->arg());
+    E = Ap->fun();
+  }
+  std::reverse(Args.begin(), Args.end());
+
+  // The target must be a slot in the record of a self-function.
+  auto *P  = dyn_cast_or_null<Project>(E);
+  auto *Sa = P ? dyn_cast_or_null<Apply>(P->record()) : nullptr;
+  if (!Sa || !Sa->isSelfApplication() || Sa->isDelegation())
+    return nullptr;
+  auto *Sv = dyn_cast_or_null<Variable>(Sa->fun());
+  if (!Sv || Sv->variableDecl()->kind() != VarDecl::VK_SFun)
+    return nullptr;
+  auto *Sfun = dyn_cast_or_null<Function>(Sv->variableDecl()->definition());
+  auto *Rec  = Sfun ? dyn_cast_or_null<Record>(Sfun->body()) : nullptr;
+  Slot *Slt  = Rec ? Rec->findSlot(P->slotName()) : nullptr;
+  if (!Slt)
+    return nullptr;
+
+  // Strip off one function for each argument.
+  unsigned Fp = Sv->variableDecl()->varIndex() + 1;
+  SExpr *D = Slt->definition();
+  for (unsigned i = 0, n = Args.size(); i < n; ++i) {
+    auto *Fn = dyn_cast_or_null<Function>(D);
+    if (!Fn || Fn->variableDecl()->kind() != VarDecl::VK_Fun)
+      return nullptr;
+    if (i == 0)
+      Fp = Fn->variableDecl()->varIndex();
+    D = Fn->body();
+  }
+
+  auto *C = dyn_cast_or_null<Code>(D);
+  if (!C || !C->body() || !isa<SCFG>(C->body()))
+    return nullptr;
+  *FirstParam = Fp;
+  return C;
+}
+
+
+bool Inliner::shouldInline(Call *Orig, Code *C) {
+  // Don't inline recursive calls.
+  if (C == CurrentCode)
+    return false;
+
+  // Calls nested within loops are assumed to execute 8 times per iteration.
+  unsigned Depth = Orig->block() ? Orig->block()->loopDepth() : 0;
+  unsigned Freq  = 1u << (3 * std::min(Depth, 4u));
+
+  // The cost of inlining is the size of the callee, multiplied by the number
+  // of places it is called from, since each call site will get a copy.
+  unsigned Size  = codeSize(cast<SCFG>(C->body()));
+  unsigned Sites = std::max(CallerCount[C], 1u);
+
+  return Size <= Threshold * 8 && Size * Sites <= Threshold * Freq;
+}
+
+
+SExpr* Inliner::inlineCall(Call *Orig, SCFG *Callee, unsigned FirstParam,
+                           std::vector<SExpr*> &Args) {
+  // Substitute the arguments for the parameters of the callee.
+  // Variables with lower indices (e.g. self) are shared with the caller.
+  Substitution<CopyAttr> Subst(FirstParam);
+  for (auto *A : Args)
+    Subst.push_back(CopyAttr(A));
+
+  // Jump to a copy of the callee; the exit block of the callee is replaced
+  // by a continuation block, whose argument is the result of the call.
+  unsigned Npreds = Callee->exit()->numPredecessors();
+  BasicBlock *Entry = Builder.newBlock(0, 1);
+  BasicBlock *Cont  = Builder.newBlock(1, Npreds);
+  Builder.newGoto(Entry);
+
+  InlineCopier Copier(arena(), std::move(Subst));
+  Copier.copyCFG(Callee, Builder.currentCFG(), Entry, Cont);
+
+  Builder.beginBlock(Cont);
+  Phi *Res = Cont->arguments()[0];
+  if (Res->baseType() == BaseType::getBaseType<void>())
+    Res->setBaseType(Orig->baseType());
+  return Res;
+}
+
+
+void Inliner::inlineCalls(SExpr *G) {
+  auto *Sfun = dyn_cast_or_null<Function>(G);
+  auto *Rec  = Sfun ? dyn_cast_or_null<Record>(Sfun->body()) : nullptr;
+  if (!Rec)
+    return;
+
+  // Find all code blocks with a CFG, along with the deBruin index of their
+  // bodies.
+  std::vector<std::pair<Code*, unsigned>> Codes;
+  for (auto &Sr : Rec->slots()) {
+    SExpr *D = Sr->definition();
+    unsigned Db = Sfun->variableDecl()->varIndex() + 1;
+    while (auto *Fn = dyn_cast_or_null<Function>(D)) {
+      Db = Fn->variableDecl()->varIndex() + 1;
+      D  = Fn->body();
+    }
+    auto *C = dyn_cast_or_null<Code>(D);
+    if (C && C->body() && isa<SCFG>(C->body()))
+      Codes.push_back(std::make_pair(C, Db));
+  }
+
+  // Count the number of call sites for each callee.
+  for (auto &Cp : Codes) {
+    auto *Cfg = cast<SCFG>(Cp.first->body());
+    SizeBefore += codeSize(Cfg);
+    for (auto &B : Cfg->blocks()) {
+      for (auto *I : B->instructions()) {
+        auto *Ca = dyn_cast_or_null<Call>(I);
+        if (!Ca)
+          continue;
+        std::vector<SExpr*> Args;
+        unsigned Fp;
+        if (Code *C = resolveCallee(Ca->target(), Args, &Fp)) {
+          ++CallerCount[C];
+          ++NumCallSites;
+        }
+      }
+    }
+  }
+
+  for (auto &Cp : Codes) {
+    CurrentCode = Cp.first;
+    delete switchScope(new DefaultCopyScope(Substitution<CopyAttr>(Cp.second)));
+    Builder.switchState(CFGBuilder::BuilderState(Cp.second, false));
+
+    auto *Ncfg = cast<SCFG>(traverseAll(CurrentCode->body()));
+    CurrentCode->rewrite(CurrentCode->returnType(), Ncfg);
+    SizeAfter += codeSize(Ncfg);
+  }
+  CurrentCode = nullptr;
+}
+
+
+void Inliner::printStatistics(std::ostream &SS) {
+  SS << "Inlined " << NumCallsInlined << " of " << NumCallSites << " calls.\n";
+  SS << "Code size: " << SizeBefore << " -> " << SizeAfter << " (";
+  if (SizeAfter >= SizeBefore)
+    SS << "+" << (SizeAfter - SizeBefore);
+  else
+    SS << "-" << (SizeBefore - SizeAfter);
+  SS << ")\n";
+}
+
+
+unsigned Inliner::codeSize(SCFG *Cfg) {
+  unsigned Sz = 0;
+  for (auto &B : Cfg->blocks()) {
+    // Instructions that were removed by rewriting passes are null.
+    for (auto *A : B->arguments())
+      Sz += (A != nullptr);
+    for (auto *I : B->instructions())
+      Sz += (I != nullptr);
+    Sz += 1;
+  }
+  return Sz;
+}
+
+
+}  // end namespace til
+}  // end namespace ohmu
@@ -0,0 +1,130 @@
+//===- Inliner.h -----------------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Implements inlining of calls to code blocks in lowered CFGs.
+//
+// Each CFG is copied, and calls to statically known code blocks are replaced
+// by a copy of the callee's CFG.  The entry of the callee becomes the target
+// of a goto, and the return becomes a goto to a continuation block, whose
+// phi node holds the result of the call.
+//
+// Whether a call is inlined is decided by a simple cost model, which weighs
+// the size of the callee and the number of places it is called from against
+// the estimated frequency of the call, which is derived from loop depth.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_TIL_INLINER_H
+#define OHMU_TIL_INLINER_H
+
+#include "CopyReducer.h"
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+
+namespace ohmu {
+namespace til  {
+
+
+/// InlineCopier copies the body of a callee into the CFG of a caller.
+class InlineCopier
+    : public CopyReducer<CopyAttr, DefaultCopyScope>,
+      public LazyCopyTraversal<InlineCopier, DefaultCopyScope> {
+public:
+  typedef CopyReducer<CopyAttr, DefaultCopyScope> Super;
+  typedef LazyCopyTraversal<InlineCopier, DefaultCopyScope> SuperTv;
+
+  /// Copy the blocks of Callee into Cfg.  The entry of Callee is mapped to
+  /// Entry, and the exit of Callee is mapped to Exit; the exit block itself
+  /// is not copied, so returns turn into gotos to Exit.
+  void copyCFG(SCFG *Callee, SCFG *Cfg, BasicBlock *Entry, BasicBlock *Exit);
+
+  /// Subst maps the parameters of the callee to the arguments of the call.
+  InlineCopier(MemRegionRef A, Substitution<CopyAttr> &&Subst)
+    : Super(A) {
+    delete switchScope(new DefaultCopyScope(std::move(Subst)));
+  }
+};
+
+
+
+/// Inliner copies lowered CFGs, and inlines calls according to a cost model.
+class Inliner : public CopyReducer<CopyAttr, DefaultCopyScope>,
+                public LazyCopyTraversal<Inliner, DefaultCopyScope> {
+public:
+  typedef CopyReducer<CopyAttr, DefaultCopyScope> Super;
+  typedef LazyCopyTraversal<Inliner, DefaultCopyScope> SuperTv;
+
+  void exitCFG(SCFG *Cfg);
+
+  void reduceCall(Call *Orig);
+
+  /// Inline calls within all code blocks that are defined in the record of
+  /// the global self-function G.
+  void inlineCalls(SExpr *G);
+
+  /// Print the number of calls that were inlined, and the growth in size.
+  void printStatistics(std::ostream &SS);
+
+  /// Set the maximum size of a callee that is called once outside of a loop.
+  void setThreshold(unsigned T) { Threshold = T; }
+
+  /// Number of static call sites with a known callee.
+  unsigned numCallSites()   const { return NumCallSites; }
+
+  /// Number of calls that were replaced by the body of the callee.
+  unsigned numCallsInlined() const { return NumCallsInlined; }
+
+  /// Return the size of a CFG, which is the number of arguments,
+  /// instructions, and terminators in its blocks.
+  static unsigned codeSize(SCFG *Cfg);
+
+  Inliner(MemRegionRef A)
+    : Super(A), CurrentCode(nullptr), Threshold(64), NumCallSites(0),
+      NumCallsInlined(0), SizeBefore(0), SizeAfter(0)
+  { }
+
+private:
+  /// Find the code block called by Target, which must have the form
+  /// self@().name(args)...  On success, Args holds the arguments and
+  /// FirstParam the deBruin index of the first parameter.
+  Code* resolveCallee(SExpr *Target, std::vector<SExpr*> &Args,
+                      unsigned *FirstParam);
+
+  bool shouldInline(Call *Orig, Code *C);
+
+  SExpr* inlineCall(Call *Orig, SCFG *Callee, unsigned FirstParam,
+                    std::vector<SExpr*> &Args);
+
+  Code*    CurrentCode;   // The code block that is being copied.
+  unsigned Threshold;     // Size limit for inlining.
+
+  std::unordered_map<Code*, unsigned> CallerCount;  // call sites per callee
+
+  unsigned NumCallSites;
+  unsigned NumCallsInlined;
+  unsigned SizeBefore;
+  unsigned SizeAfter;
+};
+
+
+}  // end namespace til
+}  // end namespace ohmu
+
+#endif  // OHMU_TIL_INLINER_H
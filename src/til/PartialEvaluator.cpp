@@ -0,0 +1,242 @@
+//===- PartialEvaluator.cpp ------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Evaluator.h"
+#include "PartialEvaluator.h"
+
+#include <cstring>
+
+
+namespace ohmu {
+namespace til  {
+
+
+void PartialEvaluator::exitCFG(SCFG *Cfg) {
+  auto* Ncfg = Builder.currentCFG();
+  Super::exitCFG(Cfg);
+
+  // Recompute block order and dominators, since branches may have been
+  // folded.
+  if (Ncfg)
+    Ncfg->computeNormalForm();
+}
+
+
+void PartialEvaluator::traverseBasicBlock(BasicBlock *Orig) {
+  // Blocks are traversed in topological order, so any block that is still
+  // reachable after folding branches has already been created by a jump.
+  // Skip the rest.
+  if (!scope()->lookupBlock(Orig))
+    return;
+  SuperTv::traverseBasicBlock(Orig);
+}
+
+
+void PartialEvaluator::reduceBinaryOp(BinaryOp *Orig) {
+  auto* L0 = dyn_cast_or_null<Literal>(attr(0).Exp);
+  auto* L1 = dyn_cast_or_null<Literal>(attr(1).Exp);
+  if (L0 && L1 && L0->baseType() == L1->baseType()) {
+    auto* Res = evaluateBinaryOp(Orig->binaryOpcode(), L0->baseType(),
+                                 &Builder, L0, L1);
+    if (Res) {
+      resultAttr().Exp = Res;
+      return;
+    }
+  }
+  Super::reduceBinaryOp(Orig);
+}
+
+
+void PartialEvaluator::reduceUnaryOp(UnaryOp *Orig) {
+  if (auto* L0 = dyn_cast_or_null<Literal>(attr(0).Exp)) {
+    auto* Res = evaluateUnaryOp(Orig->unaryOpcode(), L0->baseType(),
+                                &Builder, L0);
+    if (Res) {
+      resultAttr().Exp = Res;
+      return;
+    }
+  }
+  Super::reduceUnaryOp(Orig);
+}
+
+
+void PartialEvaluator::reduceBranch(Branch *Orig) {
+  // Eliminate branches on static conditions.
+  auto* Lc = dyn_cast_or_null<Literal>(attr(0).Exp);
+  if (Lc && Lc->baseType().Base == BaseType::BT_Bool) {
+    BasicBlock* B = Lc->as<bool>()->value() ? Orig->thenBlock()
+                                            : Orig->elseBlock();
+    resultAttr().Exp = Builder.newGoto(lookupBlock(B));
+    return;
+  }
+  Super::reduceBranch(Orig);
+}
+
+
+SExpr* PartialEvaluator::specialize(SExpr *E, DefaultCopyScope *S,
+                                    unsigned DeBruin, MemRegionRef A) {
+  PartialEvaluator Pe(A);
+  delete Pe.switchScope(S);
+  Pe.Builder.switchState(CFGBuilder::BuilderState(DeBruin, false));
+  return Pe.traverseAll(E);
+}
+
+
+
+SExpr* SpecializedCodeFuture::evaluate() {
+  SExpr* B = OrigCode->body();
+  if (auto* F = dyn_cast_or_null<Future>(B))
+    B = F->force();
+
+  SExpr* Res = PartialEvaluator::specialize(B, ScopePtr, DeBruin, Arena);
+  ScopePtr = nullptr;
+  return Res;
+}
+
+
+
+/// Append the value of a literal to a signature string.
+template<class T>
+class LiteralSignatureFun {
+public:
+  typedef bool ReturnType;
+
+  static bool defaultAction(Literal *L, std::string *Sig) {
+    return false;
+  }
+
+  static bool action(Literal *L, std::string *Sig) {
+    appendValue(Sig, L->as<T>()->value());
+    return true;
+  }
+
+private:
+  template<class V>
+  static void appendValue(std::string *Sig, V Val) {
+    Sig->append(reinterpret_cast<const char*>(&Val), sizeof(V));
+  }
+
+  static void appendValue(std::string *Sig, StringRef Val) {
+    appendValue(Sig, Val.size());
+    Sig->append(Val.data(), Val.size());
+  }
+};
+
+
+Slot* CallSpecializer::findSlotForCode(Record *Rec, Code *C,
+                                       unsigned Nparams) {
+  for (auto &Sr : Rec->slots()) {
+    Slot* Slt = Sr.get();
+    SExpr* D = Slt->definition();
+    unsigned Np = 0;
+    while (auto* Fn = dyn_cast_or_null<Function>(D)) {
+      if (Fn->variableDecl()->kind() != VarDecl::VK_Fun)
+        break;
+      D = Fn->body();
+      ++Np;
+    }
+    if (D == C)
+      return (Np == Nparams) ? Slt : nullptr;
+  }
+  return nullptr;
+}
+
+
+SExpr* CallSpecializer::specializeCall(CFGBuilder &Builder, Code *C,
+                                       unsigned NumNull,
+                                       ArrayRef<SExpr*> Args) {
+  if (!C->body() || Args.size() < 2)
+    return nullptr;
+
+  // The first argument must be the self-parameter of the enclosing record,
+  // and the remaining arguments must be literals.
+  auto* Sv = dyn_cast_or_null<Variable>(Args[0]);
+  if (!Sv || Sv->variableDecl()->kind() != VarDecl::VK_SFun)
+    return nullptr;
+
+  std::string Sig;
+  for (unsigned i = 1, n = Args.size(); i < n; ++i) {
+    auto* L = dyn_cast_or_null<Literal>(Args[i]);
+    if (!L)
+      return nullptr;
+    Sig.push_back(static_cast<char>(L->baseType().asUInt8()));
+    if (!BtBr<LiteralSignatureFun>::branch(L->baseType(), L, &Sig))
+      return nullptr;
+  }
+
+  auto* Sfun = dyn_cast_or_null<Function>(Sv->variableDecl()->definition());
+  auto* Rec  = Sfun ? dyn_cast<Record>(Sfun->body()) : nullptr;
+  if (!Rec)
+    return nullptr;
+
+  KeyType Key(C, Sig);
+  auto It = Cache.find(Key);
+  Slot* Slt = nullptr;
+  if (It != Cache.end()) {
+    Slt = It->second;
+    ++NumCacheHits;
+  }
+  else {
+    // Make sure that C really is the code for one of the slots in Rec.
+    Slot* OrigSlt = findSlotForCode(Rec, C, Args.size() - 1);
+    if (!OrigSlt)
+      return nullptr;
+
+    // Substitute the static arguments for the parameters of C.
+    Substitution<CopyAttr> Subst(NumNull);
+    for (auto* A : Args)
+      Subst.push_back(CopyAttr(A));
+    auto* S = new DefaultCopyScope(std::move(Subst));
+
+    unsigned Db = Sv->variableDecl()->varIndex() + 1;
+    MemRegionRef A = Builder.arena();
+    auto* Body = new (A) SpecializedCodeFuture(C, S, Db, A);
+    PendingBodies.push_back(Body);
+
+    auto* Nc = Builder.newCode(C->returnType(), Body);
+    Nc->setCallingConvention(C->callingConvention());
+
+    // Name the new slot after the original one.  The '$' ensures that it
+    // cannot clash with a name from the source.
+    std::string Nm = OrigSlt->slotName().str() + "$" +
+                     std::to_string(Cache.size() + 1);
+    char* Buf = A.allocateT<char>(Nm.size() + 1);
+    std::memcpy(Buf, Nm.c_str(), Nm.size() + 1);
+
+    Slt = Builder.newSlot(StringRef(Buf, Nm.size()), Nc);
+    Slt->setModifier(Slot::SLT_Final);
+    Rec->addSlot(A, Slt);
+    Cache.insert(std::make_pair(Key, Slt));
+  }
+
+  auto* Eapp = Builder.newApply(Sv, nullptr, Apply::FAK_SApply);
+  Eapp->setBaseType(BaseType::getBaseType<void*>());
+  auto* Eproj = Builder.newProject(Eapp, Slt->slotName());
+  Eproj->setBaseType(BaseType::getBaseType<void*>());
+  return Eproj;
+}
+
+
+void CallSpecializer::finish() {
+  for (auto* F : PendingBodies)
+    F->force();
+  PendingBodies.clear();
+}
+
+
+}  // end namespace til
+}  // end namespace ohmu
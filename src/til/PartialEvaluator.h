@@ -0,0 +1,130 @@
+//===- PartialEvaluator.h --------------------------------------*- C++ --*-===//
+// Copyright 2014  Google
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+//
+// Implements specialization of code blocks that are called with statically
+// known arguments.
+//
+// When a code block is called with literal arguments, e.g. foo(1, 2)(), the
+// body of foo is copied with the literals substituted for the parameters.
+// Operations on literals are folded during the copy, and branches on literal
+// conditions are replaced by gotos.  The result is a residual CFG, which is
+// added to the enclosing record as a new slot, and the call is redirected to
+// the new slot.  Specializations are cached, so calls with the same static
+// arguments share a single residual CFG.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OHMU_TIL_PARTIALEVALUATOR_H
+#define OHMU_TIL_PARTIALEVALUATOR_H
+
+#include "CopyReducer.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace ohmu {
+namespace til  {
+
+
+/// PartialEvaluator makes a copy of a lowered term, substituting static
+/// values for variables, and folding instructions with literal operands.
+class PartialEvaluator
+    : public CopyReducer<CopyAttr, DefaultCopyScope>,
+      public LazyCopyTraversal<PartialEvaluator, DefaultCopyScope> {
+public:
+  typedef CopyReducer<CopyAttr, DefaultCopyScope> Super;
+  typedef LazyCopyTraversal<PartialEvaluator, DefaultCopyScope> SuperTv;
+
+  void exitCFG(SCFG *Cfg);
+
+  void traverseBasicBlock(BasicBlock *Orig);
+
+  void reduceUnaryOp(UnaryOp *Orig);
+  void reduceBinaryOp(BinaryOp *Orig);
+  void reduceBranch(Branch *Orig);
+
+  /// Copy E within scope S, which holds the substitution for free variables.
+  /// Takes ownership of S.
+  static SExpr* specialize(SExpr *E, DefaultCopyScope *S, unsigned DeBruin,
+                           MemRegionRef A);
+
+  PartialEvaluator(MemRegionRef A) : Super(A) { }
+};
+
+
+
+/// The body of a specialized code block.  It is computed on demand, because
+/// the body of the original code block may not have been lowered yet.
+class SpecializedCodeFuture : public Future {
+public:
+  SpecializedCodeFuture(Code *C, DefaultCopyScope *S, unsigned Db,
+                        MemRegionRef A)
+    : OrigCode(C), ScopePtr(S), DeBruin(Db), Arena(A)
+  { }
+  virtual ~SpecializedCodeFuture() { }
+
+  virtual SExpr* evaluate() override;
+
+private:
+  Code*             OrigCode;   // The code block that is being specialized.
+  DefaultCopyScope* ScopePtr;   // Substitution of static args for params.
+  unsigned          DeBruin;    // DeBruin index of the specialized body.
+  MemRegionRef      Arena;
+};
+
+
+
+/// CallSpecializer creates specialized versions of code blocks that are
+/// called with statically known arguments.  Specializations are cached, keyed
+/// by the callee and the signature of its static arguments.
+class CallSpecializer {
+public:
+  /// Attempt to specialize a call to C.  Args holds the residuals that are
+  /// substituted for the variables of C, starting at deBruin index NumNull.
+  /// Returns a new call target on success, or nullptr if C cannot be
+  /// specialized for Args.
+  SExpr* specializeCall(CFGBuilder &Builder, Code *C, unsigned NumNull,
+                        ArrayRef<SExpr*> Args);
+
+  /// Force all specialized code blocks that have not been forced yet.
+  void finish();
+
+  /// Number of distinct specializations that were created.
+  unsigned numSpecializations() const { return Cache.size(); }
+
+  /// Number of calls that reused an existing specialization.
+  unsigned numCacheHits() const { return NumCacheHits; }
+
+  CallSpecializer() : NumCacheHits(0) { }
+
+private:
+  Slot* findSlotForCode(Record *Rec, Code *C, unsigned Nparams);
+
+  typedef std::pair<Code*, std::string> KeyType;
+
+  std::map<KeyType, Slot*> Cache;
+  std::vector<Future*>     PendingBodies;
+  unsigned                 NumCacheHits;
+};
+
+
+}  // end namespace til
+}  // end namespace ohmu
+
+#endif  // OHMU_TIL_PARTIALEVALUATOR_H
@@ -283,8 +283,9 @@ void Future::setResult(SExpr *Res) {
 
   Status = FS_done;
 
-  Positions.clear();
-  Positions.shrink_to_fit();
+  // Release the position list.  (shrink_to_fit is only a hint, and is a
+  // no-op in some library configurations.)
+  std::vector<SExpr**>().swap(Positions);
   assert(Positions.capacity() == 0 && "Memory Leak.");
 }
 
@@ -641,6 +642,46 @@ void SCFG::computeNormalForm() {
   for (auto &B : Blocks) {
     computeNodeID(B.get(), &BasicBlock::DominatorNode);
   }
+
+  computeLoopDepths();
+}
+
+
+void SCFG::computeLoopDepths() {
+  for (auto &B : Blocks)
+    B->setLoopDepth(0);
+
+  // A back edge is an edge P -> H where H dominates P.  The natural loop of
+  // H consists of H, and all blocks that can reach P without passing
+  // through H.  Every block is nested once within each loop that contains it.
+  std::vector<unsigned> Visited(Blocks.size(), 0);
+  std::vector<BasicBlock*> Worklist;
+  unsigned LoopId = 0;
+  for (auto &H : Blocks) {
+    bool IsHeader = false;
+    for (auto &Pr : H->predecessors()) {
+      BasicBlock *P = Pr.get();
+      if (!P || !H->dominates(*P))
+        continue;
+      if (!IsHeader) {
+        IsHeader = true;
+        ++LoopId;
+        Visited[H->blockID()] = LoopId;
+        H->setLoopDepth(H->loopDepth() + 1);
+      }
+      Worklist.push_back(P);
+    }
+    while (!Worklist.empty()) {
+      BasicBlock *B = Worklist.back();
+      Worklist.pop_back();
+      if (Visited[B->blockID()] == LoopId)
+        continue;
+      Visited[B->blockID()] = LoopId;
+      B->setLoopDepth(B->loopDepth() + 1);
+      for (auto &Pr : B->predecessors())
+        Worklist.push_back(Pr.get());
+    }
+  }
 }
 
 }  // end namespace til
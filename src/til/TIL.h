@@ -1571,6 +1571,7 @@ public:
 
   void renumber();         // assign unique ids to all instructions and blocks
   void computeNormalForm();
+  void computeLoopDepths();  // requires dominators; see computeNormalForm()
 
   SCFG(MemRegionRef A, unsigned Nblocks)
       : SExpr(COP_SCFG), Arena(A), Blocks(A, Nblocks),
@@ -616,6 +616,12 @@ public:
 
   void compareOpcodes  (TIL_Opcode O, TIL_Opcode P)   { if (O != P) fail(); }
 
+  /// An Apply without an argument is only equal to another such Apply.
+  void compareApply(const Apply *E1, const Apply *E2) {
+    compare(E1->fun(), E2->fun());
+    compare(E1->arg(), E2->arg());
+  }
+
   static bool compareExprs(const SExpr *E1, const SExpr* E2) {
     EqualsComparator Eq;
     Eq.compare(E1, E2);
@@ -634,7 +640,7 @@ public:
 };
 
 
-class MatchComparator : public AlphaLetComparator<EqualsComparator, bool> {
+class MatchComparator : public AlphaLetComparator<MatchComparator, bool> {
 public:
   void compareBaseTypes(BaseType b, BaseType c)       { if (b != c) fail(); }
 
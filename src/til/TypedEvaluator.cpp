@@ -353,6 +353,11 @@ void TypedEvaluator::reduceCall(Call *Orig) {
   if (reduceNestedCall(Orig, C))
     return;
 
+  // If the arguments are statically known, call a specialized version of C.
+  // This must be done before the substitution is moved into Res.
+  if (Ce && SpecializeCalls && Builder.emitInstrs())
+    Ce = specializeCall(C, Ca);
+
   // Set the result type.
   Res.TypeExpr = C->returnType();
   Res.Rel      = TypedCopyAttr::BT_Type;
@@ -447,6 +452,23 @@ void TypedEvaluator::reduceUnaryOp(UnaryOp *Orig) {
     }
   }
 
+  if (Literal* L0 = dyn_cast<Literal>(I0)) {
+    // Annotations on Orig will be copied to the result, so it can't be a
+    // shared constant.
+    ConstantPool *P = Builder.constantPool();
+    if (Orig->annotations())
+      Builder.switchConstantPool(nullptr);
+    Literal *L = evaluateUnaryOp(Orig->unaryOpcode(), L0->baseType(),
+                                 &Builder, L0);
+    Builder.switchConstantPool(P);
+    if (L) {
+      Res.Exp = L;
+      Res.Rel = TypedCopyAttr::BT_Type;
+      Res.TypeExpr = nullptr;
+      return;
+    }
+  }
+
   auto *Re = Builder.newUnaryOp(Orig->unaryOpcode(), I0);
   Re->setBaseType(I0->baseType());
 
@@ -502,8 +524,14 @@ void TypedEvaluator::reduceBinaryOp(BinaryOp *Orig) {
 
   if (Literal* L0 = dyn_cast<Literal>(I0)) {
     if (Literal* L1 = dyn_cast<Literal>(I1)) {
-      Res.Exp = evaluateBinaryOp(Orig->binaryOpcode(), L0->baseType(), arena(),
-                                 L0, L1);
+      // Annotations on Orig will be copied to the result, so it can't be a
+      // shared constant.
+      ConstantPool *P = Builder.constantPool();
+      if (Orig->annotations())
+        Builder.switchConstantPool(nullptr);
+      Res.Exp = evaluateBinaryOp(Orig->binaryOpcode(), L0->baseType(),
+                                 &Builder, L0, L1);
+      Builder.switchConstantPool(P);
       Res.Rel = TypedCopyAttr::BT_Type;
       Res.TypeExpr = nullptr;
       return;
@@ -732,6 +760,11 @@ void TypedEvaluator::traverseLet(Let *Orig) {
   traverse(Orig->variableDecl()->definition(), TRV_Decl);
   auto* E = lastAttr().Exp;
   if (auto* I = dyn_cast_or_null<Instruction>(E)) {
+    // Shared constants are immutable, so a named constant gets a copy.
+    if (Builder.isSharedConstant(I)) {
+      I = cast<Instruction>(Builder.unshare(I));
+      lastAttr().Exp = I;
+    }
     I->setInstrName(Builder, Orig->variableDecl()->varName());
   }
 
@@ -913,6 +946,18 @@ bool TypedEvaluator::reduceNestedCall(Call* Orig, Code* C) {
 
 
 
+SExpr* TypedEvaluator::specializeCall(Code* C, TypedCopyAttr &Ca) {
+  std::vector<SExpr*> Args;
+  for (auto& At : Ca.Subst.varAttrs())
+    Args.push_back(At.Exp);
+
+  SExpr* E = Specializer.specializeCall(Builder, C, Ca.Subst.numNullVars(),
+      ArrayRef<SExpr*>(Args.data(), Args.size()));
+  return E ? E : Ca.Exp;
+}
+
+
+
 void TypedEvaluator::processPendingBlocks() {
   while (!PendingBlockQueue.empty()) {
     auto* Pb = PendingBlockQueue.front();
@@ -22,6 +22,7 @@
 #include "TILTraverse.h"
 #include "AttributeGrammar.h"
 #include "CopyReducer.h"
+#include "PartialEvaluator.h"
 
 #include <queue>
 
@@ -233,6 +234,22 @@ public:
 
   void traverseFuture(Future *Orig);
 
+  /// Lower E, and then finish any specialized code blocks.
+  SExpr* traverseAll(SExpr *E) {
+    SExpr* Res = SuperTv::traverseAll(E);
+    Specializer.finish();
+    return Res;
+  }
+
+  /// Enable or disable the specialization of calls with static arguments.
+  void setSpecializeCalls(bool B) { SpecializeCalls = B; }
+
+  /// Share literals and scalar types that are created during lowering.
+  void setConstantPool(ConstantPool *P) { Builder.switchConstantPool(P); }
+
+  /// Return the specializer, which holds statistics about specialization.
+  const CallSpecializer& specializer() const { return Specializer; }
+
 private:
   friend class CFGFuture;
 
@@ -244,6 +261,7 @@ private:
 
   void traverseNestedCode(Code* Orig);
   bool reduceNestedCall(Call* Orig, Code* C);
+  SExpr* specializeCall(Code* C, TypedCopyAttr &Ca);
   void processPendingBlocks();
 
   enum EvaluationMode {
@@ -259,7 +277,7 @@ private:
 
 public:
   TypedEvaluator(MemRegionRef A)
-    : Super(A), EvalMode(TEval_Copy)
+    : Super(A), EvalMode(TEval_Copy), SpecializeCalls(false)
   { }
 
 protected:
@@ -267,6 +285,8 @@ protected:
   std::vector<std::unique_ptr<PendingBlock>> PendingBlks;
   std::queue<PendingBlock*>                  PendingBlockQueue;
   DenseMap<Code*, PendingBlock*>             CodeMap;
+  bool                                       SpecializeCalls;
+  CallSpecializer                            Specializer;
 };
 
 
@@ -277,9 +297,12 @@ typedef LazyCopyFuture<TypedEvaluator, ScopeCPS> TypedEvalFuture;
 template<class T>
 void TypedEvaluator::reduceLiteralT(LiteralT<T> *Orig) {
   // Don't copy literals unless deep copy has been requested.
+  // Annotated literals get a private copy, since shared ones are immutable.
   LiteralT<T>* Re;
   if (EvalMode == TEval_WeakHead)
     Re = Orig;
+  else if (Orig->annotations())
+    Re = new (arena()) LiteralT<T>(Orig->value());
   else
     Re = Builder.newLiteralT<T>(Orig->value());
 